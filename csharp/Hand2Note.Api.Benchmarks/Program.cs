@@ -0,0 +1,17 @@
+﻿using BenchmarkDotNet.Running;
+
+namespace Hand2Note.Api.Benchmarks
+{
+    /// <remarks>
+    /// dotnet run -c Release -- --filter *
+    ///
+    /// h2napi.dll is taken from the H2NAPI_DLL environment variable, or the default x86/x64 subdirectory.
+    /// </remarks>
+    public static class Program
+    {
+        public static void Main(string[] args)
+        {
+            BenchmarkSwitcher.FromAssembly(typeof(Program).Assembly).Run(args);
+        }
+    }
+}
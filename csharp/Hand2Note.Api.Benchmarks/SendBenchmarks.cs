@@ -0,0 +1,207 @@
+﻿using BenchmarkDotNet.Attributes;
+using System;
+using System.Runtime.InteropServices;
+using System.Text;
+
+namespace Hand2Note.Api.Benchmarks
+{
+    /// <summary>
+    /// Hand start and action sends through the function pointer binding of <see cref="Hand2Note"/>
+    /// against the previous delegate binding with a by value seats array.
+    /// </summary>
+    /// <remarks>
+    /// The baseline sends strings encoded once in the setup, so its time is the marshaling alone.
+    /// </remarks>
+    [MemoryDiagnoser]
+    public class SendBenchmarks
+    {
+        private HandStartMessage _start;
+        private HandActionMessage _action;
+        private LegacyBinding _legacy;
+
+        [GlobalSetup]
+        public void Setup()
+        {
+            var dll = Environment.GetEnvironmentVariable("H2NAPI_DLL");
+            if (!string.IsNullOrEmpty(dll))
+                Hand2Note.DLLPath = dll;
+
+            _start = new HandStartMessage
+            {
+                Room = Rooms.PokerMaster,
+                GameNumber = 2416948123,
+                TableName = "PMSTR1234567",
+                TableWindowHwnd = 0x10000,
+                TableSize = 6,
+                SmallBlind = 0.25,
+                BigBlind = 0.5,
+            };
+            for (var i = 0; i < 6; ++i)
+                _start.Seats.Add(new PlayerSeatInfo($"天天大水上{i}", (1000 + i).ToString(), i, 100, i == 0));
+            _start.Seats[0].PoketCards = "AhKd";
+            _action = new HandActionMessage { GameNumber = _start.GameNumber, SeatIndex = 2, ActionType = Actions.Raise, Amount = 1.5 };
+
+            // loads the library
+            Hand2Note.IsHand2NoteRunning();
+            _legacy = new LegacyBinding(Hand2Note.DLLPath, _start);
+        }
+
+        [GlobalCleanup]
+        public void Cleanup()
+        {
+            _legacy.Dispose();
+        }
+
+        [Benchmark(Baseline = true)]
+        public void HandStartDelegate() => _legacy.SendHandStart();
+
+        [Benchmark]
+        public void HandStart() => Hand2Note.Send(_start);
+
+        [Benchmark]
+        public void ActionDelegate() => _legacy.SendAction(_action);
+
+        [Benchmark]
+        public void Action() => Hand2Note.Send(_action);
+    }
+
+    /// <summary>
+    /// The delegate binding Hand2Note used before function pointers.
+    /// </summary>
+    internal sealed class LegacyBinding : IDisposable
+    {
+        [DllImport("kernel32.dll", CharSet = CharSet.Unicode, EntryPoint = "LoadLibraryW")]
+        private static extern IntPtr LoadLibraryW(string dllToLoad);
+        [DllImport("kernel32.dll")]
+        private static extern IntPtr GetProcAddress(IntPtr hModule, string procedureName);
+        [DllImport("kernel32.dll")]
+        private static extern bool FreeLibrary(IntPtr hModule);
+
+        private readonly IntPtr _dll;
+        private readonly h2n_send_hand_start _sendHandStart;
+        private readonly h2n_send_action _sendAction;
+        private h2n_start_hand_message_struct _start;
+        private GCHandle _strings;
+
+        public LegacyBinding(string path, HandStartMessage message)
+        {
+            _dll = LoadLibraryW(System.IO.Path.GetFullPath(path));
+            if (_dll == IntPtr.Zero)
+                throw new InvalidOperationException($"Failed to load library \"{path}\"");
+            _sendHandStart = Marshal.GetDelegateForFunctionPointer<h2n_send_hand_start>(GetProcAddress(_dll, "h2n_send_hand_start"));
+            _sendAction = Marshal.GetDelegateForFunctionPointer<h2n_send_action>(GetProcAddress(_dll, "h2n_send_action"));
+
+            var bytes = new byte[4096];
+            _strings = GCHandle.Alloc(bytes, GCHandleType.Pinned);
+            var offset = 0;
+            IntPtr Write(string s)
+            {
+                var ptr = _strings.AddrOfPinnedObject() + offset;
+                offset += Encoding.UTF8.GetBytes(s ?? "", 0, (s ?? "").Length, bytes, offset);
+                bytes[offset++] = 0;
+                return ptr;
+            }
+
+            _start.room = (int)message.Room;
+            _start.gameid = message.GameNumber;
+            _start.table_name = Write(message.TableName);
+            _start.table_hwnd = message.TableWindowHwnd;
+            _start.max_players = message.TableSize;
+            _start.is_straightbeatstrips = 1;
+            _start.currency = (int)message.Currency;
+            _start.sb = message.SmallBlind;
+            _start.bb = message.BigBlind;
+            _start.seats = new h2n_seat_info_struct[10];
+            foreach (var s in message.Seats)
+            {
+                _start.seats[_start.seats_num++] = new h2n_seat_info_struct
+                {
+                    seat_idx = s.SeatIndex,
+                    nickname = Write(s.Nickname),
+                    player_id = Write(s.PlayerShowId),
+                    stack = s.InitialStackSize,
+                    pocket_cards = Write(s.PoketCards),
+                    is_hero = s.IsHero ? 1 : 0,
+                };
+            }
+        }
+
+        public void SendHandStart() => _sendHandStart(ref _start);
+
+        public void SendAction(HandActionMessage message)
+        {
+            var msg = new h2n_action_message_struct();
+            msg.amount = message.Amount;
+            msg.gameid = message.GameNumber;
+            msg.seat_idx = message.SeatIndex;
+            msg.type = (int)message.ActionType;
+            _sendAction(ref msg);
+        }
+
+        public void Dispose()
+        {
+            if (_strings.IsAllocated)
+                _strings.Free();
+            FreeLibrary(_dll);
+        }
+
+        private struct h2n_seat_info_struct
+        {
+            public int seat_idx;
+            public IntPtr nickname;
+            public IntPtr player_id;
+            public double stack;
+            public IntPtr pocket_cards;
+            public int is_dealer;
+            public int is_posted_sb;
+            public int is_posted_bb;
+            public int is_posted_sb_outofqueue;
+            public int is_posted_bb_outofqueue;
+            public int is_posted_straddle;
+            public int is_hero;
+            public int is_sitting_out;
+        }
+
+        private struct h2n_start_hand_message_struct
+        {
+            public int room;
+            public double gameid;
+            public IntPtr table_name;
+            public int table_hwnd;
+            public int max_players;
+            public int is_tourney;
+            public int is_omaha;
+            public int is_limit;
+            public int is_zoom;
+            public int is_cap;
+            public int is_potlimit;
+            public int is_shortdeck;
+            public int is_omahafive;
+            public int is_straightbeatstrips;
+            public int currency;
+            public double sb;
+            public double bb;
+            public double ante;
+            public double straddle;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = 10)]
+            public h2n_seat_info_struct[] seats;
+            public int seats_num;
+        }
+
+        private struct h2n_action_message_struct
+        {
+            public double gameid;
+            public int seat_idx;
+            public int type;
+            public double amount;
+            public int is_allin;
+            public double pot;
+        }
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate int h2n_send_hand_start([In] ref h2n_start_hand_message_struct msg);
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate int h2n_send_action([In] ref h2n_action_message_struct msg);
+    }
+}
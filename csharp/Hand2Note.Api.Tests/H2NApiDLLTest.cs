@@ -6,6 +6,7 @@ using System.Runtime.InteropServices;
 using System.Text;
 using System.Text.RegularExpressions;
 using System.Threading;
+using System.Threading.Tasks;
 
 namespace Hand2Note.Api.Tests
 {
@@ -75,6 +76,9 @@ namespace Hand2Note.Api.Tests
         {
             // IsHand2NoteRunning static method
             Assert.AreEqual(WinApiHelper.FindWindow(null, "Hand2Note 2") != 0, ActivityMonitor.IsHand2NoteRunning);
+            // without Hand2Note nobody consumes the messages
+            if (!ActivityMonitor.IsHand2NoteRunning)
+                Assert.IsFalse(Hand2Note.IsConsumerAttached());
         }
 
         private ManualResetEvent _waitH2NStart = new ManualResetEvent(false);
@@ -119,6 +123,27 @@ namespace Hand2Note.Api.Tests
             monitor.Dispose();
             monitor.Dispose();
         }
+
+        [TestMethod]
+        public void SharedMonitorsTest()
+        {
+            // monitors share one polling thread, each one gets its own immediate start event
+            var started = new CountdownEvent(4);
+            var monitors = new ActivityMonitor[4];
+            for (int i = 0; i < monitors.Length; ++i)
+            {
+                monitors[i] = new ActivityMonitor();
+                monitors[i].Hand2NoteStarted += () => started.Signal();
+            }
+            Assert.AreEqual(ActivityMonitor.IsHand2NoteRunning, started.Wait(500));
+
+            // a handler can dispose its own monitor
+            var self = new ActivityMonitor();
+            self.Hand2NoteStarted += () => self.Dispose();
+            foreach (var m in monitors)
+                m.Dispose();
+            self.Dispose();
+        }
     }
 
     [TestClass]
@@ -143,6 +168,12 @@ namespace Hand2Note.Api.Tests
             var s2 = Hand2Note.GetRoomDefiningTableName(Rooms.FishPokers, "some table name");
             // same original table name - same output
             Assert.IsTrue(s1 == s2);
+            // repeated conversions come from the cache without allocating
+            Assert.IsTrue(ReferenceEquals(s1, s2));
+            var allocated = GC.GetAllocatedBytesForCurrentThread();
+            for (int i = 0; i < 100; ++i)
+                Hand2Note.GetRoomDefiningTableName(Rooms.FishPokers, "some table name");
+            Assert.AreEqual(allocated, GC.GetAllocatedBytesForCurrentThread());
 
             var s3 = Hand2Note.GetRoomDefiningTableName(Rooms.FishPokers, "table name");
             Assert.IsFalse(s1 == s3);
@@ -642,6 +673,141 @@ Seat 8: 德州小丑王 (small blind) folded on the Turn
         }
     }
 
+    [TestClass]
+    public class H2NApiSendConcurrent
+    {
+        public H2NApiSendConcurrent()
+        {
+            Hand2Note.DLLPath = FileSysHelpers.Hand2NoteApiDLLPath;
+            // free dll before test cases
+            Hand2Note.FreeLibrary();
+        }
+
+        [TestMethod]
+        public void TestTablesSendConcurrently()
+        {
+            // every table sends from its own thread, there is no global lock in the send path
+            var tableName = Hand2Note.GetRoomDefiningTableName(Rooms.FishPokers, @"大安上王33");
+            var largeHandHistory = "PokerStars Hand #2416948123: " + new string('x', 8000);
+            Parallel.For(0, 8, table =>
+            {
+                for (int hand = 0; hand < 200; ++hand)
+                {
+                    var gameNumber = (table + 1) * 1000000L + hand;
+                    var start = new HandStartMessage(Rooms.FishPokers, gameNumber);
+                    start.TableName = tableName;
+                    start.TableWindowHwnd = 0x10000 + table;
+                    start.Seats.Add(new PlayerSeatInfo(@"无能为力", "1", 0, 109.54) { IsPostedBigBlind = true });
+                    start.Seats.Add(new PlayerSeatInfo(@"德州小丑王", null, 7, 53.82, true) { IsPostedSmallBlind = true, PoketCards = "Ah9c" });
+                    Hand2Note.Send(start);
+                    Hand2Note.Send(new HandActionMessage { GameNumber = gameNumber, SeatIndex = 7, ActionType = Actions.Call, Amount = 0.25 });
+                    Hand2Note.Send(new HandDealMessage(gameNumber, Streets.Flop, "5h8s7s", 1));
+                    // large strings are encoded in a pooled buffer instead of the stack
+                    Hand2Note.Send(new HandHistoryMessage(Rooms.FishPokers, gameNumber, HandHistoryFormats.Stars, largeHandHistory));
+                }
+            });
+
+            // strings are encoded on the stack, a street message allocates nothing
+            var deal = new HandDealMessage(1, Streets.Flop, "5h8s7s", 1);
+            Hand2Note.Send(deal);
+            var allocated = GC.GetAllocatedBytesForCurrentThread();
+            for (int i = 0; i < 100; ++i)
+                Hand2Note.Send(deal);
+            Assert.AreEqual(allocated, GC.GetAllocatedBytesForCurrentThread());
+        }
+    }
+
+    [TestClass]
+    public class H2NApiSendQueued
+    {
+        public H2NApiSendQueued()
+        {
+            Hand2Note.DLLPath = FileSysHelpers.Hand2NoteApiDLLPath;
+            // free dll before test cases
+            Hand2Note.FreeLibrary();
+        }
+
+        static IHand2NoteMessage[] Hand(long gameNumber)
+        {
+            var start = new HandStartMessage(Rooms.FishPokers, gameNumber);
+            start.TableName = Hand2Note.GetRoomDefiningTableName(Rooms.FishPokers, @"大安上王33");
+            start.Seats.Add(new PlayerSeatInfo(@"无能为力", "1", 0, 109.54) { IsPostedBigBlind = true });
+            start.Seats.Add(new PlayerSeatInfo(@"德州小丑王", null, 7, 53.82, true) { IsPostedSmallBlind = true, PoketCards = "Ah9c" });
+            return new IHand2NoteMessage[]
+            {
+                start,
+                new HandActionMessage(gameNumber, 7, Actions.Call, 0.25),
+                new HandActionMessage(gameNumber, 0, Actions.Check),
+                new HandDealMessage(gameNumber, Streets.Flop, "5h8s7s", 1),
+            };
+        }
+
+        [TestMethod]
+        public void TestSendBatch()
+        {
+            Hand2Note.SendBatch(Hand(2416948123));
+            Assert.AreEqual(0, Hand2Note.SendBatch(ReadOnlySpan<IHand2NoteMessage>.Empty, out var status));
+            Assert.AreEqual(SendStatus.Ok, status);
+            Assert.ThrowsException<ArgumentNullException>(() => Hand2Note.Send((IHand2NoteMessage)null));
+        }
+
+        [TestMethod]
+        public void TestSender()
+        {
+            var sender = new Hand2NoteSender(capacity: 64);
+            Parallel.For(0, 8, table =>
+            {
+                for (int hand = 0; hand < 100; ++hand)
+                {
+                    foreach (var message in Hand((table + 1) * 1000000L + hand))
+                    {
+                        // waits for the writer when the queue is full
+                        sender.EnqueueAsync(message).AsTask().Wait();
+                    }
+                }
+            });
+            // sends the rest of the queue
+            sender.Dispose();
+            Assert.IsTrue(sender.Completion.IsCompleted);
+            Assert.AreEqual(8 * 100 * 4, sender.Sent);
+            Assert.AreEqual(0, sender.Failed);
+            Assert.IsFalse(sender.TryEnqueue(new HandActionMessage()));
+        }
+
+        [TestMethod]
+        public void TestSendTooManySeats()
+        {
+            // h2n_start_hand_message has room for 10 seats, more are rejected without calling h2napi
+            var start = (HandStartMessage)Hand(2416948123)[0];
+            while (start.Seats.Count <= 10)
+                start.Seats.Add(new PlayerSeatInfo("player" + start.Seats.Count, null, start.Seats.Count, 10));
+            Assert.AreEqual(SendStatus.InvalidMessage, Hand2Note.Send(start));
+
+            var rejected = SendStatus.Ok;
+            var sender = new Hand2NoteSender();
+            sender.SendRejected += (message, status) => rejected = status;
+            Assert.IsTrue(sender.TryEnqueue(start));
+            sender.Dispose();
+            Assert.AreEqual(1, sender.Failed);
+            Assert.AreEqual(SendStatus.InvalidMessage, rejected);
+        }
+
+        [TestMethod]
+        public void TestSenderFailed()
+        {
+            // the library fails to load on the background task, the enqueueing thread doesn't see it
+            Hand2Note.DLLPath = "h2napi.dll";
+            Exception error = null;
+            var sender = new Hand2NoteSender();
+            sender.SendFailed += (message, e) => error = e;
+            Assert.IsTrue(sender.TryEnqueue(new HandActionMessage()));
+            sender.Dispose();
+            Assert.AreEqual(1, sender.Failed);
+            Assert.IsInstanceOfType(error, typeof(InvalidOperationException));
+            Hand2Note.DLLPath = FileSysHelpers.Hand2NoteApiDLLPath;
+        }
+    }
+
     public class MurmurHash
     {
         public UInt32 Hash(string str)
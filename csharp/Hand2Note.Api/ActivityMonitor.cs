@@ -2,13 +2,16 @@
 using System.Collections.Generic;
 using System.Text;
 using System.Threading;
-using System.Threading.Tasks;
 
 namespace Hand2Note.Api
 {
     /// <summary>
     /// Hand2Note activity monitor. Contains methods for checking if Hand2Note is running, events for Hand2Note start and/or close.
     /// </summary>
+    /// <remarks>
+    /// All monitors share one background thread. A Hand2Note close is detected when its process exits, without waiting for a poll.
+    /// Events are fired on that thread.
+    /// </remarks>
     public class ActivityMonitor : IDisposable
     {
         /// <summary>
@@ -17,14 +20,15 @@ namespace Hand2Note.Api
         public static bool IsHand2NoteRunning => Hand2Note.IsHand2NoteRunning();
 
         /// <summary>
-        /// Time interval between IsHand2NoteRunning calls, used to fire <c>OnHand2NoteStart</c> and <c>OnHand2NoteClose</c> events
+        /// Time interval between IsHand2NoteRunning calls, used to fire <c>OnHand2NoteStart</c>.
+        /// Monitors share the polling, the smallest interval of all monitors is used.
         /// </summary>
         public int PollDelayMs { get; set; } = 300;
 
-        private Task _pollTask = null;
-        private CancellationTokenSource _cancellationTokenSource;
-        private bool _immediateOnStart = true;
-        private bool _isRunning;
+        private readonly bool _immediateOnStart = true;
+        // null until the first check, touched by the monitoring thread only
+        private bool? _isRunning;
+        private int _disposed;
 
 
         /// <summary>
@@ -47,43 +51,37 @@ namespace Hand2Note.Api
         public ActivityMonitor(bool immediateOnStart = true)
         {
             _immediateOnStart = immediateOnStart;
-            _cancellationTokenSource = new CancellationTokenSource();
-            _pollTask = Task.Run(() => Loop(_cancellationTokenSource.Token));
+            LivenessSource.Subscribe(this);
         }
 
         /// <summary>
-        /// ActivityMonitor implements IDisposable
+        /// ActivityMonitor implements IDisposable. No events are fired after Dispose returns.
         /// </summary>
         public void Dispose()
         {
-            if (_pollTask != null)
-            {
-                _cancellationTokenSource.Cancel();
-                _pollTask.Wait();
-                _pollTask = null;
-            }
+            if (Interlocked.Exchange(ref _disposed, 1) == 0)
+                LivenessSource.Unsubscribe(this);
         }
 
-        void Loop(CancellationToken cancellationToken)
+        internal void Update(bool running)
         {
-            _isRunning = IsHand2NoteRunning;
-            if (_immediateOnStart && _isRunning)
+            if (_isRunning == running)
+                return;
+            var first = _isRunning == null;
+            _isRunning = running;
+            if (first && !(_immediateOnStart && running))
+                return;
+            try
             {
-                Hand2NoteStarted?.Invoke();
-            }
-
-            var WaitHandles = new[] { cancellationToken.WaitHandle };
-            while (WaitHandle.WaitAny(WaitHandles, PollDelayMs) == WaitHandle.WaitTimeout)
-            {
-                var currState = IsHand2NoteRunning;
-                if (currState == _isRunning)
-                    continue;
-                _isRunning = currState;
-                if (_isRunning)
+                if (running)
                     Hand2NoteStarted?.Invoke();
                 else
                     Hand2NoteClosed?.Invoke();
             }
+            catch (Exception)
+            {
+                // a throwing handler must not stop the other monitors
+            }
         }
 
     }
@@ -8,7 +8,7 @@ namespace Hand2Note.Api
     /// <summary>
     /// Send dynamic poker action message to Hand2Note, used with <see cref="HandDealMessage"/> to maintain dynamic deal state after <see cref="HandStartMessage"/>
     /// </summary>
-    public class HandActionMessage
+    public class HandActionMessage : IHand2NoteMessage
     {
         /// <summary>
         /// Hand game number
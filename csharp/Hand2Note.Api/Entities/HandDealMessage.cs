@@ -7,7 +7,7 @@ namespace Hand2Note.Api
     /// <summary>
     /// Send dynamic poker street message to Hand2Note, used with <see cref="HandActionMessage"/> to maintain dynamic deal state after <see cref="HandStartMessage"/>
     /// </summary>
-    public class HandDealMessage
+    public class HandDealMessage : IHand2NoteMessage
     {
         /// <summary>
         /// Game/Hand number
@@ -7,7 +7,7 @@ namespace Hand2Note.Api
     /// <summary>
     /// Send message with completed (static) hand history text to Hand2Note. 
     /// </summary>
-    public class HandHistoryMessage
+    public class HandHistoryMessage : IHand2NoteMessage
     {
         /// <summary>
         /// Target room
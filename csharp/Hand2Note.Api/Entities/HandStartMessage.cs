@@ -9,7 +9,7 @@ namespace Hand2Note.Api
     /// </summary>
     /// <seealso cref="HandActionMessage"/>
     /// <seealso cref="HandDealMessage"/>
-    public class HandStartMessage
+    public class HandStartMessage : IHand2NoteMessage
     {
         /// <summary>
         /// Target room
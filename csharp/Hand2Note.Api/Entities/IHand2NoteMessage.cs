@@ -0,0 +1,13 @@
+﻿namespace Hand2Note.Api
+{
+    /// <summary>
+    /// Message sent by <see cref="Hand2Note.Send(IHand2NoteMessage)"/>, <see cref="Hand2Note.SendBatch(System.ReadOnlySpan{IHand2NoteMessage})"/> and <see cref="Hand2NoteSender"/>
+    /// </summary>
+    /// <seealso cref="HandHistoryMessage"/>
+    /// <seealso cref="HandStartMessage"/>
+    /// <seealso cref="HandActionMessage"/>
+    /// <seealso cref="HandDealMessage"/>
+    public interface IHand2NoteMessage
+    {
+    }
+}
@@ -0,0 +1,36 @@
+﻿namespace Hand2Note.Api
+{
+    /// <summary>
+    /// Results of the Hand2Note.Send methods, h2n_status of h2napi.h
+    /// </summary>
+    /// <remarks>
+    /// Nothing is sent unless the result is <see cref="Ok"/>. h2napi.dll may return other nonzero codes of its own.
+    /// </remarks>
+    public enum SendStatus
+    {
+        /// <summary>
+        /// The message was handed to Hand2Note
+        /// </summary>
+        Ok = 0,
+
+        /// <summary>
+        /// The transport has no room now, the message may be sent again later
+        /// </summary>
+        QueueFull = 1,
+
+        /// <summary>
+        /// Hand2Note is not listening, see <see cref="Hand2Note.IsConsumerAttached"/>
+        /// </summary>
+        ConsumerAbsent = 2,
+
+        /// <summary>
+        /// The message has values the transport can't take
+        /// </summary>
+        InvalidMessage = 3,
+
+        /// <summary>
+        /// The message is larger than the transport takes at once
+        /// </summary>
+        Truncated = 4,
+    }
+}
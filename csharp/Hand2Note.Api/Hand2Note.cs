@@ -1,4 +1,6 @@
 ﻿using System;
+using System.Buffers;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.IO;
 using System.Runtime.InteropServices;
@@ -7,7 +9,12 @@ using System.Text;
 namespace Hand2Note.Api
 {
 
-    public static class Hand2Note
+    /// <remarks>
+    /// Send methods don't take a lock, tables on different threads send concurrently.
+    /// <see cref="Hand2NoteSender"/> queues messages and sends them from a background task instead of the caller's thread.
+    /// The strings of a message are encoded into one UTF-8 buffer on the stack, or in a pooled array when they are large.
+    /// </remarks>
+    public static unsafe class Hand2Note
     {
         /// <summary>
         /// Default path to dll readonly constant. Corresponding h2napi.dll are in the current x86/x64 subdirectory
@@ -22,126 +29,234 @@ namespace Hand2Note.Api
 
         public static bool IsHand2NoteRunning()
         {
-            lock (_lockObject)
-            {
-                LazyInitLibrary();
-                return _h2nIsRunning() != 0;
-            }
+            LazyInitLibrary();
+            return _h2nIsRunning() != 0;
         }
 
-        public static void Send(HandHistoryMessage message)
+        /// <summary>
+        /// true if Hand2Note listens to the messages, Send methods return <see cref="SendStatus.ConsumerAbsent"/> otherwise
+        /// </summary>
+        /// <remarks>
+        /// One read of the transport's shared header, cheap enough to check before composing a message.
+        /// h2napi.dll builds without h2n_consumer_attached answer <see cref="IsHand2NoteRunning"/> instead.
+        /// </remarks>
+        public static bool IsConsumerAttached()
         {
-            lock (_lockObject)
+            LazyInitLibrary();
+            return _h2nConsumerAttached != null ? _h2nConsumerAttached() != 0 : _h2nIsRunning() != 0;
+        }
+
+        /// <summary>
+        /// Waits until a message with <paramref name="stringBytes"/> bytes of UTF-8 strings fits the queue to Hand2Note
+        /// </summary>
+        /// <remarks>
+        /// 0 ms only checks, a negative timeout waits without a limit. Returns <see cref="SendStatus.QueueFull"/> on timeout.
+        /// h2napi.dll builds without h2n_wait_writable return <see cref="SendStatus.Ok"/> at once.
+        /// </remarks>
+        public static SendStatus WaitWritable(int stringBytes, int timeoutMs)
+        {
+            LazyInitLibrary();
+            return _h2nWaitWritable != null ? (SendStatus)_h2nWaitWritable((uint)Math.Max(stringBytes, 0), timeoutMs) : SendStatus.Ok;
+        }
+
+        public static SendStatus Send(HandHistoryMessage message)
+        {
+            LazyInitLibrary();
+
+            var size = Utf8Writer.Size(message.HandHistory) + Utf8Writer.Size(message.OriginalHandHistory);
+            var rented = size > Utf8Writer.StackallocLimit ? ArrayPool<byte>.Shared.Rent(size) : null;
+            Span<byte> buffer = stackalloc byte[rented == null ? size : 0];
+            if (rented != null)
+                buffer = rented;
+            try
+            {
+                fixed (byte* p = buffer)
+                {
+                    var strings = new Utf8Writer(p, buffer.Length);
+                    var msg = new h2n_hh_message_struct();
+                    msg.format = (int)message.Format;
+                    msg.gameid = (double)message.GameNumber;
+                    msg.is_zoom = message.IsZoom ? 1 : 0;
+                    msg.room = (int)message.Room;
+                    msg.hh_formatted = strings.Write(message.HandHistory);
+                    msg.hh_original = strings.Write(message.OriginalHandHistory);
+                    return (SendStatus)_h2nSendHandHistory(&msg);
+                }
+            }
+            finally
             {
-                LazyInitLibrary();
-
-                var msg = new h2n_hh_message_struct();
-                msg.format = (int)message.Format;
-                msg.gameid = (double)message.GameNumber;
-                msg.is_zoom = message.IsZoom ? 1 : 0;
-                msg.room = (int)message.Room;
-                msg.hh_formatted = WinApiHelper.StringToUTF8Pointer(message.HandHistory);
-                msg.hh_original = WinApiHelper.StringToUTF8Pointer(message.OriginalHandHistory);
-                //todo: handle error codes
-                _h2nSendHandHistory(ref msg);
-                Marshal.FreeHGlobal(msg.hh_formatted);
-                Marshal.FreeHGlobal(msg.hh_original);
+                if (rented != null)
+                    ArrayPool<byte>.Shared.Return(rented);
             }
         }
 
-        public static void Send(HandStartMessage message)
+        public static SendStatus Send(HandStartMessage message)
         {
-            lock (_lockObject)
+            LazyInitLibrary();
+
+            var seats = message.Seats;
+            if (seats.Count > MaxSeats)
+                return SendStatus.InvalidMessage;
+            var size = Utf8Writer.Size(message.TableName);
+            foreach (var s in seats)
+                size += Utf8Writer.Size(s.Nickname) + Utf8Writer.Size(s.PlayerShowId) + Utf8Writer.Size(s.PoketCards);
+            var rented = size > Utf8Writer.StackallocLimit ? ArrayPool<byte>.Shared.Rent(size) : null;
+            Span<byte> buffer = stackalloc byte[rented == null ? size : 0];
+            if (rented != null)
+                buffer = rented;
+            try
             {
-                LazyInitLibrary();
-
-                var msg = new h2n_start_hand_message_struct();
-                msg.ante = message.Ante;
-                msg.bb = message.BigBlind;
-                msg.currency = (int)message.Currency;
-                msg.gameid = (double)message.GameNumber;
-                msg.is_cap = message.IsCap ? 1 : 0;
-                msg.is_limit = message.IsLimit ? 1 : 0;
-                msg.is_omaha = message.IsOmaha ? 1 : 0;
-                msg.is_potlimit = message.IsPotLimit ? 1 : 0;
-                msg.is_shortdeck = message.IsShortDeck ? 1 : 0;
-                msg.is_omahafive = message.IsOmahaFive ? 1 : 0;
-                msg.is_straightbeatstrips = message.IsStraightBeatsTrips ? 1 : 0;
-                msg.is_tourney = message.IsTourney ? 1 : 0;
-                msg.is_zoom = message.IsZoom ? 1 : 0;
-                msg.max_players = message.TableSize;
-                msg.room = (int)message.Room;
-                msg.sb = message.SmallBlind;
-                msg.straddle = message.Straddle;
-                msg.table_hwnd = message.TableWindowHwnd;
-                msg.table_name = WinApiHelper.StringToUTF8Pointer(message.TableName);
-
-                var freeList = new List<IntPtr>();
-                freeList.Add(msg.table_name);
-
-                msg.seats = new h2n_seat_info_struct[10];
-                foreach (var s in message.Seats)
+                fixed (byte* p = buffer)
                 {
-                    var seat = new h2n_seat_info_struct();
-                    seat.is_dealer = s.IsDealer ? 1 : 0;
-                    seat.is_hero = s.IsHero ? 1 : 0;
-                    seat.is_posted_bb = s.IsPostedBigBlind ? 1 : 0;
-                    seat.is_posted_bb_outofqueue = s.IsPostedBigBlindOutOfQueue ? 1 : 0;
-                    seat.is_posted_sb = s.IsPostedSmallBlind ? 1 : 0;
-                    seat.is_posted_sb_outofqueue = s.IsPostedSmallBlindOutOfQueue ? 1 : 0;
-                    seat.is_posted_straddle = s.IsPostedStraddle ? 1 : 0;
-                    seat.is_sitting_out = s.IsSittingOut ? 1 : 0;
-                    seat.nickname = WinApiHelper.StringToUTF8Pointer(s.Nickname);
-                    freeList.Add(seat.nickname);
-                    seat.player_id = WinApiHelper.StringToUTF8Pointer(s.PlayerShowId);
-                    freeList.Add(seat.player_id);
-                    seat.pocket_cards = WinApiHelper.StringToUTF8Pointer(s.PoketCards);
-                    freeList.Add(seat.pocket_cards);
-                    seat.seat_idx = s.SeatIndex;
-                    seat.stack = s.InitialStackSize;
-
-                    msg.seats[msg.seats_num++] = seat;
+                    var strings = new Utf8Writer(p, buffer.Length);
+                    var msg = new h2n_start_hand_message_struct();
+                    msg.ante = message.Ante;
+                    msg.bb = message.BigBlind;
+                    msg.currency = (int)message.Currency;
+                    msg.gameid = (double)message.GameNumber;
+                    msg.is_cap = message.IsCap ? 1 : 0;
+                    msg.is_limit = message.IsLimit ? 1 : 0;
+                    msg.is_omaha = message.IsOmaha ? 1 : 0;
+                    msg.is_potlimit = message.IsPotLimit ? 1 : 0;
+                    msg.is_shortdeck = message.IsShortDeck ? 1 : 0;
+                    msg.is_omahafive = message.IsOmahaFive ? 1 : 0;
+                    msg.is_straightbeatstrips = message.IsStraightBeatsTrips ? 1 : 0;
+                    msg.is_tourney = message.IsTourney ? 1 : 0;
+                    msg.is_zoom = message.IsZoom ? 1 : 0;
+                    msg.max_players = message.TableSize;
+                    msg.room = (int)message.Room;
+                    msg.sb = message.SmallBlind;
+                    msg.straddle = message.Straddle;
+                    msg.table_hwnd = message.TableWindowHwnd;
+                    msg.table_name = strings.Write(message.TableName);
+
+                    // seat0..seat9 are laid out as the C array
+                    var msgSeats = &msg.seat0;
+                    foreach (var s in seats)
+                    {
+                        var seat = new h2n_seat_info_struct();
+                        seat.is_dealer = s.IsDealer ? 1 : 0;
+                        seat.is_hero = s.IsHero ? 1 : 0;
+                        seat.is_posted_bb = s.IsPostedBigBlind ? 1 : 0;
+                        seat.is_posted_bb_outofqueue = s.IsPostedBigBlindOutOfQueue ? 1 : 0;
+                        seat.is_posted_sb = s.IsPostedSmallBlind ? 1 : 0;
+                        seat.is_posted_sb_outofqueue = s.IsPostedSmallBlindOutOfQueue ? 1 : 0;
+                        seat.is_posted_straddle = s.IsPostedStraddle ? 1 : 0;
+                        seat.is_sitting_out = s.IsSittingOut ? 1 : 0;
+                        seat.nickname = strings.Write(s.Nickname);
+                        seat.player_id = strings.Write(s.PlayerShowId);
+                        seat.pocket_cards = strings.Write(s.PoketCards);
+                        seat.seat_idx = s.SeatIndex;
+                        seat.stack = s.InitialStackSize;
+
+                        msgSeats[msg.seats_num++] = seat;
+                    }
+
+                    return (SendStatus)_h2nSendHandStart(&msg);
                 }
-
-                _h2nSendHandStart(ref msg);
-                foreach (var p in freeList)
-                    Marshal.FreeHGlobal(p);
+            }
+            finally
+            {
+                if (rented != null)
+                    ArrayPool<byte>.Shared.Return(rented);
             }
         }
 
 
-        public static void Send(HandActionMessage message)
+        public static SendStatus Send(HandActionMessage message)
         {
-            lock (_lockObject)
+            LazyInitLibrary();
+
+            var msg = new h2n_action_message_struct();
+            msg.amount = message.Amount;
+            msg.gameid = (double)message.GameNumber;
+            msg.is_allin = 0;
+            msg.pot = 0;
+            msg.seat_idx = message.SeatIndex;
+            msg.type = (int)message.ActionType;
+            return (SendStatus)_h2nSendHandAction(&msg);
+        }
+
+
+        public static SendStatus Send(HandDealMessage message)
+        {
+            LazyInitLibrary();
+
+            // a board is at most 10 characters
+            var size = Utf8Writer.Size(message.Board);
+            var rented = size > Utf8Writer.StackallocLimit ? ArrayPool<byte>.Shared.Rent(size) : null;
+            Span<byte> buffer = stackalloc byte[rented == null ? size : 0];
+            if (rented != null)
+                buffer = rented;
+            try
             {
-                LazyInitLibrary();
-
-                var msg = new h2n_action_message_struct();
-                msg.amount = message.Amount;
-                msg.gameid = (double)message.GameNumber;
-                msg.is_allin = 0;
-                msg.pot = 0;
-                msg.seat_idx = message.SeatIndex;
-                msg.type = (int)message.ActionType;
-                _h2nSendHandAction(ref msg);
+                fixed (byte* p = buffer)
+                {
+                    var strings = new Utf8Writer(p, buffer.Length);
+                    var msg = new h2n_street_message_struct();
+                    msg.board = strings.Write(message.Board);
+                    msg.gameid = (double)message.GameNumber;
+                    msg.pot = message.Pot;
+                    msg.type = (int)message.Street;
+                    return (SendStatus)_h2nSendHandStreet(&msg);
+                }
+            }
+            finally
+            {
+                if (rented != null)
+                    ArrayPool<byte>.Shared.Return(rented);
             }
         }
 
+        /// <summary>
+        /// Sends any of the message types
+        /// </summary>
+        public static SendStatus Send(IHand2NoteMessage message)
+        {
+            switch (message)
+            {
+                case HandStartMessage start:
+                    return Send(start);
+                case HandActionMessage action:
+                    return Send(action);
+                case HandDealMessage deal:
+                    return Send(deal);
+                case HandHistoryMessage history:
+                    return Send(history);
+                case null:
+                    throw new ArgumentNullException(nameof(message));
+                default:
+                    throw new ArgumentException($"Unknown message type {message.GetType()}", nameof(message));
+            }
+        }
 
-        public static void Send(HandDealMessage message)
+        /// <summary>
+        /// Sends the messages in order, stops at the first one that isn't sent
+        /// </summary>
+        /// <returns>Number of messages sent, the first <paramref name="failure"/> is <see cref="SendStatus.Ok"/> when all were sent</returns>
+        /// <remarks>
+        /// h2napi.dll has no batch entry point, the library is loaded once and every message is a native call.
+        /// </remarks>
+        public static int SendBatch(ReadOnlySpan<IHand2NoteMessage> messages, out SendStatus failure)
         {
-            lock (_lockObject)
+            LazyInitLibrary();
+            for (var i = 0; i < messages.Length; i++)
             {
-                LazyInitLibrary();
-
-                var msg = new h2n_street_message_struct();
-                msg.board = WinApiHelper.StringToUTF8Pointer(message.Board);
-                msg.gameid = (double)message.GameNumber;
-                msg.pot = message.Pot;
-                msg.type = (int)message.Street;
-                _h2nSendHandStreet(ref msg);
-                Marshal.FreeHGlobal(msg.board);
+                failure = Send(messages[i]);
+                if (failure != SendStatus.Ok)
+                    return i;
             }
+            failure = SendStatus.Ok;
+            return messages.Length;
+        }
+
+        /// <summary>
+        /// Sends the messages in order, stops at the first one that isn't sent
+        /// </summary>
+        /// <returns>Number of messages sent</returns>
+        public static int SendBatch(ReadOnlySpan<IHand2NoteMessage> messages)
+        {
+            return SendBatch(messages, out _);
         }
 
         /// <summary>
@@ -155,13 +270,10 @@ namespace Hand2Note.Api
         /// You don't need to send this message when the table's window was actually closed
         /// because Hand2Note is able to detect the closed window and shut down the HUD itself.
         /// </remarks>
-        public static void SendCloseHud(int tableHWnd)
+        public static SendStatus SendCloseHud(int tableHWnd)
         {
-            lock (_lockObject)
-            {
-                LazyInitLibrary();
-                _h2nSendCommand(tableHWnd, 0, (int)Commands.CloseHud);
-            }
+            LazyInitLibrary();
+            return (SendStatus)_h2nSendCommand(tableHWnd, 0, (int)Commands.CloseHud);
         }
        
 
@@ -172,13 +284,10 @@ namespace Hand2Note.Api
         /// <param name="room">Poker client room</param>
         /// <param name="command">Command</param>
         /// <seealso cref="Commands"/>
-        public static void Send(int tableHwnd, Rooms room, Commands command)
+        public static SendStatus Send(int tableHwnd, Rooms room, Commands command)
         {
-            lock (_lockObject)
-            {
-                LazyInitLibrary();
-                _h2nSendCommand(tableHwnd, (int)room, (int)command);
-            }
+            LazyInitLibrary();
+            return (SendStatus)_h2nSendCommand(tableHwnd, (int)room, (int)command);
         }
 
         /// <summary>
@@ -193,17 +302,50 @@ namespace Hand2Note.Api
         /// <param name="room">Original poker room</param>
         /// <param name="originalTableName">Original table name</param>
         /// <returns>Table name supported by Hand2Note</returns>
+        /// <remarks>
+        /// Results are cached per room and name, a repeated conversion is a dictionary lookup without a native call.
+        /// </remarks>
         public static string GetRoomDefiningTableName(Rooms room, string originalTableName)
         {
-            lock (_lockObject)
+            if (originalTableName != null && _tableNames.TryGetValue((room, originalTableName), out var cached))
+                return cached;
+            var ret = MakeTableName(room, originalTableName);
+            if (originalTableName != null)
             {
-                LazyInitLibrary();
-                var lpcOriginalTableName = WinApiHelper.StringToUTF8Pointer(originalTableName);
-                var lpcTableName = _h2nMakeTableName((int)room, lpcOriginalTableName);
-                Marshal.FreeHGlobal(lpcOriginalTableName);
-                var ret = WinApiHelper.StringFromUTF8Pointer(lpcTableName);
-                _h2nFreeCString(lpcTableName);
-                return ret;
+                // a client sees a bounded number of tables, the limit only guards against unique names per hand
+                if (_tableNames.Count >= MaxCachedTableNames)
+                    _tableNames.Clear();
+                _tableNames.TryAdd((room, originalTableName), ret);
+            }
+            return ret;
+        }
+
+        private const int MaxCachedTableNames = 4096;
+        private static readonly ConcurrentDictionary<(Rooms, string), string> _tableNames = new ConcurrentDictionary<(Rooms, string), string>();
+
+        private static string MakeTableName(Rooms room, string originalTableName)
+        {
+            LazyInitLibrary();
+            var size = Utf8Writer.Size(originalTableName);
+            var rented = size > Utf8Writer.StackallocLimit ? ArrayPool<byte>.Shared.Rent(size) : null;
+            Span<byte> buffer = stackalloc byte[rented == null ? size : 0];
+            if (rented != null)
+                buffer = rented;
+            try
+            {
+                fixed (byte* p = buffer)
+                {
+                    var strings = new Utf8Writer(p, buffer.Length);
+                    var lpcTableName = _h2nMakeTableName((int)room, strings.Write(originalTableName));
+                    var ret = WinApiHelper.StringFromUTF8Pointer(lpcTableName);
+                    _h2nFreeCString(lpcTableName);
+                    return ret;
+                }
+            }
+            finally
+            {
+                if (rented != null)
+                    ArrayPool<byte>.Shared.Return(rented);
             }
         }
 
@@ -212,7 +354,8 @@ namespace Hand2Note.Api
         /// Call WinApi FreeLibrary for h2napi.dll
         /// </summary>
         /// <remarks>
-        /// Is never called, used in test cases, can be used for autoupdate to unlock h2napi.dll file for write
+        /// Is never called, used in test cases, can be used for autoupdate to unlock h2napi.dll file for write.
+        /// Must not be called while other threads are sending.
         /// </remarks>
         /// <returns>
         /// true if h2napi.dll was successfully freed
@@ -231,6 +374,15 @@ namespace Hand2Note.Api
         {
             if (_dllAddress != IntPtr.Zero)
                 return;
+            lock (_lockObject)
+            {
+                if (_dllAddress == IntPtr.Zero)
+                    InitLibrary();
+            }
+        }
+
+        private static void InitLibrary()
+        {
             // need absolute path for LoadLibraryW
             var path = Path.GetFullPath(DLLPath);
             if (!File.Exists(DLLPath))
@@ -239,47 +391,50 @@ namespace Hand2Note.Api
             if (addr == IntPtr.Zero)
                 throw new InvalidOperationException($"Failed to load library \"{path}\": {WinApiHelper.GetLastError()}");
 
-            _h2nIsRunning = (h2n_is_running)LoadDelegate<h2n_is_running>(addr, "h2n_is_running");
-            _h2nMakeTableName = (h2n_make_table_name)LoadDelegate<h2n_make_table_name>(addr, "h2n_make_table_name");
-            _h2nFreeCString = (h2n_free_cstring)LoadDelegate<h2n_free_cstring>(addr, "h2n_free_cstring");
-            _h2nSendHandHistory = (h2n_send_handhistory)LoadDelegate<h2n_send_handhistory>(addr, "h2n_send_handhistory");
-            _h2nSendHandStart = (h2n_send_hand_start)LoadDelegate<h2n_send_hand_start>(addr, "h2n_send_hand_start");
-            _h2nSendHandAction = (h2n_send_action)LoadDelegate<h2n_send_action>(addr, "h2n_send_action");
-            _h2nSendHandStreet = (h2n_send_street)LoadDelegate<h2n_send_street>(addr, "h2n_send_street");
-            _h2nSendCommand = (h2n_send_command)LoadDelegate<h2n_send_command>(addr, "h2n_send_command");
-
+            _h2nIsRunning = (delegate* unmanaged[Cdecl]<int>)LoadExport(addr, "h2n_is_running");
+            _h2nMakeTableName = (delegate* unmanaged[Cdecl]<int, IntPtr, IntPtr>)LoadExport(addr, "h2n_make_table_name");
+            _h2nFreeCString = (delegate* unmanaged[Cdecl]<IntPtr, void>)LoadExport(addr, "h2n_free_cstring");
+            _h2nSendHandHistory = (delegate* unmanaged[Cdecl]<h2n_hh_message_struct*, int>)LoadExport(addr, "h2n_send_handhistory");
+            _h2nSendHandStart = (delegate* unmanaged[Cdecl]<h2n_start_hand_message_struct*, int>)LoadExport(addr, "h2n_send_hand_start");
+            _h2nSendHandAction = (delegate* unmanaged[Cdecl]<h2n_action_message_struct*, int>)LoadExport(addr, "h2n_send_action");
+            _h2nSendHandStreet = (delegate* unmanaged[Cdecl]<h2n_street_message_struct*, int>)LoadExport(addr, "h2n_send_street");
+            _h2nSendCommand = (delegate* unmanaged[Cdecl]<int, int, int, int>)LoadExport(addr, "h2n_send_command");
+            // newer builds only
+            _h2nConsumerAttached = (delegate* unmanaged[Cdecl]<int>)WinApiHelper.GetProcAddress(addr, "h2n_consumer_attached");
+            _h2nWaitWritable = (delegate* unmanaged[Cdecl]<uint, int, int>)WinApiHelper.GetProcAddress(addr, "h2n_wait_writable");
+
+            // published after the function pointers, senders outside the lock only check the address
             _dllAddress = addr;
         }
 
-        private static Delegate LoadDelegate<T>(IntPtr dllAddress, string functionName)
+        private static IntPtr LoadExport(IntPtr dllAddress, string functionName)
         {
             var address = WinApiHelper.GetProcAddress(dllAddress, functionName);
             if (address == IntPtr.Zero)
             {
-                throw new InvalidOperationException($"Failed to get delegate address for {functionName}");
+                throw new InvalidOperationException($"Failed to get function address for {functionName}");
             }
-            return Marshal.GetDelegateForFunctionPointer(address, typeof(T));
+            return address;
         }
 
-        private static IntPtr _dllAddress = IntPtr.Zero;
+        private static volatile IntPtr _dllAddress = IntPtr.Zero;
+        // guards loading and freeing the library only
         static object _lockObject = new object();
 
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate int h2n_is_running();
-        private static h2n_is_running _h2nIsRunning = null;
-
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate IntPtr h2n_make_table_name(int room, IntPtr UTF8TableName);
-        private static h2n_make_table_name _h2nMakeTableName = null;
-
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate int h2n_send_command(int table_hwnd, int room_id, int cmd);
-        private static h2n_send_command _h2nSendCommand = null;
-
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate IntPtr h2n_free_cstring(IntPtr UTF8TableName);
-        private static h2n_free_cstring _h2nFreeCString = null;
-
+        // Exports are called through unmanaged function pointers with blittable structs:
+        // no delegate marshaling stubs, the struct is passed by address as is.
+        private static delegate* unmanaged[Cdecl]<int> _h2nIsRunning;
+        private static delegate* unmanaged[Cdecl]<int> _h2nConsumerAttached;
+        private static delegate* unmanaged[Cdecl]<uint, int, int> _h2nWaitWritable;
+        private static delegate* unmanaged[Cdecl]<int, IntPtr, IntPtr> _h2nMakeTableName;
+        private static delegate* unmanaged[Cdecl]<int, int, int, int> _h2nSendCommand;
+        private static delegate* unmanaged[Cdecl]<IntPtr, void> _h2nFreeCString;
+        private static delegate* unmanaged[Cdecl]<h2n_hh_message_struct*, int> _h2nSendHandHistory;
+        private static delegate* unmanaged[Cdecl]<h2n_start_hand_message_struct*, int> _h2nSendHandStart;
+        private static delegate* unmanaged[Cdecl]<h2n_action_message_struct*, int> _h2nSendHandAction;
+        private static delegate* unmanaged[Cdecl]<h2n_street_message_struct*, int> _h2nSendHandStreet;
+
+        [StructLayout(LayoutKind.Sequential)]
         private struct h2n_hh_message_struct
         {
             public int room;
@@ -289,10 +444,8 @@ namespace Hand2Note.Api
             public IntPtr hh_formatted;
             public IntPtr hh_original;
         }
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate int h2n_send_handhistory([In] ref h2n_hh_message_struct msg);
-        private static h2n_send_handhistory _h2nSendHandHistory = null;
 
+        [StructLayout(LayoutKind.Sequential)]
         private struct h2n_seat_info_struct
         {
             public int seat_idx;
@@ -310,6 +463,7 @@ namespace Hand2Note.Api
             public int is_sitting_out;
         }
 
+        [StructLayout(LayoutKind.Sequential)]
         private struct h2n_start_hand_message_struct
         {
             public int room;
@@ -331,15 +485,14 @@ namespace Hand2Note.Api
             public double bb;
             public double ante;
             public double straddle;
-            [MarshalAs(UnmanagedType.ByValArray, SizeConst = 10)]
-            public h2n_seat_info_struct[] seats;
+            // h2n_seat_info seats[H2N_MAX_SEATS], fixed buffers can't hold structs
+            public h2n_seat_info_struct seat0, seat1, seat2, seat3, seat4, seat5, seat6, seat7, seat8, seat9;
             public int seats_num;
         }
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate int h2n_send_hand_start([In] ref h2n_start_hand_message_struct msg);
-        private static h2n_send_hand_start _h2nSendHandStart = null;
 
+        private const int MaxSeats = 10;
 
+        [StructLayout(LayoutKind.Sequential)]
         private struct h2n_action_message_struct
         {
             public double gameid;
@@ -349,11 +502,8 @@ namespace Hand2Note.Api
             public int is_allin;
             public double pot;
         }
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate int h2n_send_action([In] ref h2n_action_message_struct msg);
-        private static h2n_send_action _h2nSendHandAction = null;
-
 
+        [StructLayout(LayoutKind.Sequential)]
         private struct h2n_street_message_struct
         {
             public double gameid;
@@ -361,9 +511,6 @@ namespace Hand2Note.Api
             public IntPtr board;
             public double pot;
         }
-        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-        private delegate int h2n_send_street([In] ref h2n_street_message_struct msg);
-        private static h2n_send_street _h2nSendHandStreet = null;
 
     }
 }
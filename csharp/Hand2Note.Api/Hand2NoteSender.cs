@@ -0,0 +1,133 @@
+﻿using System;
+using System.Threading;
+using System.Threading.Channels;
+using System.Threading.Tasks;
+
+namespace Hand2Note.Api
+{
+    /// <summary>
+    /// Queues messages for Hand2Note and sends them from a single background task, so the enqueueing threads never call h2napi.dll.
+    /// </summary>
+    /// <remarks>
+    /// Messages are sent in the order they were enqueued. A message must not be changed after it was enqueued.
+    ///
+    /// When the queue is full <see cref="BoundedChannelFullMode.Wait"/> makes <see cref="TryEnqueue"/> return false and
+    /// <see cref="EnqueueAsync"/> wait for space, the drop modes discard messages instead.
+    /// </remarks>
+    public class Hand2NoteSender : IDisposable
+    {
+        private readonly Channel<IHand2NoteMessage> _channel;
+        private readonly Task _writeTask;
+        private long _sent;
+        private long _failed;
+
+        /// <summary>
+        /// Fired on the background task when a message failed to send, e.g. h2napi.dll failed to load
+        /// </summary>
+        public event Action<IHand2NoteMessage, Exception> SendFailed;
+
+        /// <summary>
+        /// Fired on the background task when h2napi didn't take a message, e.g. Hand2Note isn't listening or its queue is full
+        /// </summary>
+        public event Action<IHand2NoteMessage, SendStatus> SendRejected;
+
+        /// <summary>
+        /// Messages sent
+        /// </summary>
+        public long Sent => Interlocked.Read(ref _sent);
+
+        /// <summary>
+        /// Messages failed to send or rejected
+        /// </summary>
+        public long Failed => Interlocked.Read(ref _failed);
+
+        /// <summary>
+        /// Completed when the sender was completed and all queued messages are sent
+        /// </summary>
+        public Task Completion => _writeTask;
+
+        /// <summary>
+        /// Constructor
+        /// </summary>
+        /// <param name="capacity">Messages queued at most</param>
+        /// <param name="fullMode">What to do when the queue is full</param>
+        public Hand2NoteSender(int capacity = 4096, BoundedChannelFullMode fullMode = BoundedChannelFullMode.Wait)
+        {
+            _channel = Channel.CreateBounded<IHand2NoteMessage>(new BoundedChannelOptions(capacity)
+            {
+                FullMode = fullMode,
+                SingleReader = true,
+                SingleWriter = false,
+                AllowSynchronousContinuations = false,
+            });
+            _writeTask = Task.Run(WriteLoop);
+        }
+
+        /// <summary>
+        /// Queues the message without waiting
+        /// </summary>
+        /// <returns>false if the queue is full in <see cref="BoundedChannelFullMode.Wait"/> mode or the sender is completed</returns>
+        public bool TryEnqueue(IHand2NoteMessage message)
+        {
+            if (message == null)
+                throw new ArgumentNullException(nameof(message));
+            return _channel.Writer.TryWrite(message);
+        }
+
+        /// <summary>
+        /// Queues the message, waits for space in <see cref="BoundedChannelFullMode.Wait"/> mode
+        /// </summary>
+        public ValueTask EnqueueAsync(IHand2NoteMessage message, CancellationToken cancellationToken = default)
+        {
+            if (message == null)
+                throw new ArgumentNullException(nameof(message));
+            return _channel.Writer.WriteAsync(message, cancellationToken);
+        }
+
+        /// <summary>
+        /// Stops accepting messages, the queued ones are still sent
+        /// </summary>
+        public void Complete()
+        {
+            _channel.Writer.TryComplete();
+        }
+
+        /// <summary>
+        /// Completes the sender and waits until the queued messages are sent
+        /// </summary>
+        public void Dispose()
+        {
+            Complete();
+            _writeTask.Wait();
+        }
+
+        private async Task WriteLoop()
+        {
+            var reader = _channel.Reader;
+            while (await reader.WaitToReadAsync().ConfigureAwait(false))
+            {
+                while (reader.TryRead(out var message))
+                {
+                    try
+                    {
+                        var status = Hand2Note.Send(message);
+                        if (status == SendStatus.Ok)
+                        {
+                            Interlocked.Increment(ref _sent);
+                        }
+                        else
+                        {
+                            Interlocked.Increment(ref _failed);
+                            SendRejected?.Invoke(message, status);
+                        }
+                    }
+                    catch (Exception e)
+                    {
+                        Interlocked.Increment(ref _failed);
+                        SendFailed?.Invoke(message, e);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,145 @@
+﻿using System;
+using System.Threading;
+using Microsoft.Win32.SafeHandles;
+
+namespace Hand2Note.Api
+{
+    /// <summary>
+    /// One thread watching Hand2Note for all <see cref="ActivityMonitor"/> instances.
+    /// </summary>
+    /// <remarks>
+    /// While Hand2Note is running the thread waits on its process handle, so a close is seen as soon as the process exits.
+    /// A start has nothing to wait on and is polled every <see cref="ActivityMonitor.PollDelayMs"/> (the smallest of the subscribers).
+    /// The thread runs while there are subscribers, it doesn't take the library lock.
+    /// </remarks>
+    internal static class LivenessSource
+    {
+        private const string Hand2NoteWindow = "Hand2Note 2";
+        private const uint Synchronize = 0x00100000;
+
+        private static readonly object _subscribersLock = new object();
+        // held while events are delivered, Unsubscribe takes it so no event reaches a removed subscriber after it returns
+        private static readonly object _deliverLock = new object();
+        private static readonly AutoResetEvent _wake = new AutoResetEvent(false);
+        private static ActivityMonitor[] _subscribers = new ActivityMonitor[0];
+        private static Thread _thread;
+
+        public static void Subscribe(ActivityMonitor monitor)
+        {
+            lock (_subscribersLock)
+            {
+                var subscribers = new ActivityMonitor[_subscribers.Length + 1];
+                Array.Copy(_subscribers, subscribers, _subscribers.Length);
+                subscribers[_subscribers.Length] = monitor;
+                _subscribers = subscribers;
+                if (_thread == null)
+                {
+                    _thread = new Thread(Loop) { IsBackground = true, Name = "Hand2Note ActivityMonitor" };
+                    _thread.Start();
+                }
+            }
+            // the new subscriber gets its first state now rather than after the poll delay
+            _wake.Set();
+        }
+
+        public static void Unsubscribe(ActivityMonitor monitor)
+        {
+            Thread stopped = null;
+            lock (_subscribersLock)
+            {
+                var idx = Array.IndexOf(_subscribers, monitor);
+                if (idx < 0)
+                    return;
+                var subscribers = new ActivityMonitor[_subscribers.Length - 1];
+                Array.Copy(_subscribers, 0, subscribers, 0, idx);
+                Array.Copy(_subscribers, idx + 1, subscribers, idx, subscribers.Length - idx);
+                _subscribers = subscribers;
+                if (subscribers.Length == 0)
+                {
+                    stopped = _thread;
+                    _thread = null;
+                }
+            }
+            if (stopped != null)
+                _wake.Set();
+            // reentrant when a handler disposes its own monitor
+            lock (_deliverLock) { }
+            if (stopped != null && stopped != Thread.CurrentThread)
+                stopped.Join();
+        }
+
+        private static void Loop()
+        {
+            WaitHandle process = null;
+            var wakeOnly = new WaitHandle[] { _wake };
+            WaitHandle[] wakeOrExit = null;
+            for (;;)
+            {
+                ActivityMonitor[] subscribers;
+                lock (_subscribersLock)
+                {
+                    if (_thread != Thread.CurrentThread)
+                        break;
+                    subscribers = _subscribers;
+                }
+
+                bool running;
+                try
+                {
+                    running = Hand2Note.IsHand2NoteRunning();
+                }
+                catch (InvalidOperationException)
+                {
+                    // h2napi.dll failed to load
+                    running = false;
+                }
+
+                lock (_deliverLock)
+                {
+                    foreach (var s in subscribers)
+                        s.Update(running);
+                }
+
+                if (running && process == null)
+                {
+                    process = OpenHand2NoteProcess();
+                    if (process != null)
+                        wakeOrExit = new[] { _wake, process };
+                }
+                else if (!running && process != null)
+                {
+                    process.Dispose();
+                    process = null;
+                }
+
+                var delay = int.MaxValue;
+                foreach (var s in subscribers)
+                    delay = Math.Min(delay, s.PollDelayMs);
+                if (subscribers.Length == 0)
+                    delay = 0;
+                // the process handle is signaled on exit, polling still catches a closed window of a live process
+                if (process != null && WaitHandle.WaitAny(wakeOrExit, delay) == 1)
+                {
+                    process.Dispose();
+                    process = null;
+                }
+                else if (process == null)
+                {
+                    WaitHandle.WaitAny(wakeOnly, delay);
+                }
+            }
+            process?.Dispose();
+        }
+
+        private static WaitHandle OpenHand2NoteProcess()
+        {
+            var hwnd = WinApiHelper.FindWindowW(null, Hand2NoteWindow);
+            if (hwnd == IntPtr.Zero || WinApiHelper.GetWindowThreadProcessId(hwnd, out var pid) == 0)
+                return null;
+            var handle = WinApiHelper.OpenProcess(Synchronize, false, pid);
+            if (handle == IntPtr.Zero)
+                return null;
+            return new ManualResetEvent(false) { SafeWaitHandle = new SafeWaitHandle(handle, true) };
+        }
+    }
+}
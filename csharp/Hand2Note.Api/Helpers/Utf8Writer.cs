@@ -0,0 +1,49 @@
+﻿using System;
+using System.Text;
+
+namespace Hand2Note.Api
+{
+    /// <summary>
+    /// Writes NUL terminated UTF-8 strings one after another into a pinned buffer, so all the strings
+    /// of a message share one stackalloc or pooled buffer instead of an AllocHGlobal each
+    /// </summary>
+    internal unsafe struct Utf8Writer
+    {
+        /// <summary>
+        /// Messages with strings up to this size are encoded on the stack, larger ones in a pooled array
+        /// </summary>
+        public const int StackallocLimit = 1024;
+
+        private byte* _next;
+        private readonly byte* _end;
+
+        public Utf8Writer(byte* buffer, int size)
+        {
+            _next = buffer;
+            _end = buffer + size;
+        }
+
+        /// <summary>
+        /// Bytes taken by the string and its terminator, null is written as an empty string
+        /// </summary>
+        public static int Size(string managedString)
+        {
+            return (string.IsNullOrEmpty(managedString) ? 0 : Encoding.UTF8.GetByteCount(managedString)) + 1;
+        }
+
+        /// <summary>
+        /// Appends the string, returns the pointer to it, valid while the buffer is pinned
+        /// </summary>
+        public IntPtr Write(string managedString)
+        {
+            var start = _next;
+            if (!string.IsNullOrEmpty(managedString))
+            {
+                fixed (char* chars = managedString)
+                    _next += Encoding.UTF8.GetBytes(chars, managedString.Length, _next, (int)(_end - _next) - 1);
+            }
+            *_next++ = 0;
+            return (IntPtr)start;
+        }
+    }
+}
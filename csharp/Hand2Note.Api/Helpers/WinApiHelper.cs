@@ -14,24 +14,19 @@ namespace Hand2Note.Api
         public static int GetLastError() { return Marshal.GetLastWin32Error(); }
         [DllImport("kernel32.dll")]
         public static extern bool FreeLibrary(IntPtr hModule);
+        [DllImport("user32.dll", CharSet = CharSet.Unicode)]
+        public static extern IntPtr FindWindowW(string className, string windowName);
+        [DllImport("user32.dll")]
+        public static extern uint GetWindowThreadProcessId(IntPtr hwnd, out uint processId);
+        [DllImport("kernel32.dll")]
+        public static extern IntPtr OpenProcess(uint desiredAccess, bool inheritHandle, uint processId);
 
-        public static string StringFromUTF8Pointer(IntPtr nativeUtf8)
-        {
-            int len = 0;
-            while (Marshal.ReadByte(nativeUtf8, len) != 0) ++len;
-            byte[] buffer = new byte[len];
-            Marshal.Copy(nativeUtf8, buffer, 0, buffer.Length);
-            return Encoding.UTF8.GetString(buffer);
-        }
-
-        public static IntPtr StringToUTF8Pointer(string managedString)
+        public static unsafe string StringFromUTF8Pointer(IntPtr nativeUtf8)
         {
-            int len = Encoding.UTF8.GetByteCount(managedString);
-            byte[] buffer = new byte[len + 1];
-            Encoding.UTF8.GetBytes(managedString, 0, managedString.Length, buffer, 0);
-            IntPtr nativeUtf8 = Marshal.AllocHGlobal(buffer.Length);
-            Marshal.Copy(buffer, 0, nativeUtf8, buffer.Length);
-            return nativeUtf8;
+            // vectorized search for the terminator, decoded straight from native memory
+            var bytes = (byte*)nativeUtf8;
+            var len = new ReadOnlySpan<byte>(bytes, int.MaxValue).IndexOf((byte)0);
+            return Encoding.UTF8.GetString(bytes, len);
         }
 
     }
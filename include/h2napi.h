@@ -1,7 +1,12 @@
 #ifndef _H2NAPIDLL__
 #define _H2NAPIDLL__
 
-#ifdef h2napidll_EXPORTS
+#if defined(H2NAPI_HEADER_ONLY) && defined(__cplusplus)
+	// defined by h2napi_local.hpp, included at the end of h2napi.hpp
+	#define H2N_API inline
+#elif !defined(_WIN32)
+	#define H2N_API __attribute__((visibility("default")))
+#elif defined(h2napidll_EXPORTS)
 	#define H2N_API __declspec(dllexport)
 #else
 	#ifdef H2NAPI_SRC_UNIT_TESTS
@@ -120,6 +125,16 @@ extern "C" {
 #define H2N_COMMAND_REOPENTABLE 3
 #define H2N_COMMAND_RESTARTEMULATOR 4
 
+/* Results of the h2n_send_* functions. Nothing is sent unless the result is H2N_STATUS_OK.
+   The prebuilt h2napi.dll returns 0 on success, its other codes are not part of this list. */
+typedef enum {
+	H2N_STATUS_OK = 0,
+	H2N_STATUS_QUEUE_FULL = 1,        /* the transport has no room now, the message may be sent again later */
+	H2N_STATUS_CONSUMER_ABSENT = 2,   /* Hand2Note is not listening, see h2n_consumer_attached */
+	H2N_STATUS_INVALID_MESSAGE = 3,   /* null message or string argument, seats_num out of 0..H2N_MAX_SEATS */
+	H2N_STATUS_TRUNCATED = 4          /* the message is larger than the transport takes at once */
+} h2n_status;
+
 
 #define H2N_MAX_SEATS 10
 
@@ -196,9 +211,26 @@ typedef struct {
 
 H2N_API int h2n_is_running();
 
+/* 1 if a consumer is attached to the transport, one load from its shared header; whether the consumer
+   process is still alive is checked at most every 100 ms. Cheap enough to check before formatting
+   a message. Not exported by the prebuilt h2napi.dll. */
+H2N_API int h2n_consumer_attached();
+
+/* Bytes queued for Hand2Note and the size of the queue. Returns an h2n_status,
+   H2N_STATUS_CONSUMER_ABSENT when there is no queue. Not exported by the prebuilt h2napi.dll. */
+H2N_API int h2n_queue_usage(unsigned int* used, unsigned int* capacity);
+
+/* Waits until a message with bytes of strings (its other fields are accounted for) fits the queue, for
+   producers that would rather slow down than get H2N_STATUS_QUEUE_FULL. timeout_ms 0 only
+   checks, a negative timeout waits without a limit. Returns H2N_STATUS_OK, H2N_STATUS_QUEUE_FULL
+   on timeout, H2N_STATUS_CONSUMER_ABSENT, or H2N_STATUS_TRUNCATED if it never fits.
+   Not exported by the prebuilt h2napi.dll. */
+H2N_API int h2n_wait_writable(unsigned int bytes, int timeout_ms);
+
 H2N_API char* h2n_make_table_name(int room, const char* original_name);
 H2N_API void h2n_free_cstring(char* str);
 
+/* return h2n_status values */
 H2N_API int h2n_send_handhistory(h2n_hh_message* msg);
 H2N_API int h2n_send_hand_start(h2n_start_hand_message* msg);
 H2N_API int h2n_send_action(h2n_action_message* msg);
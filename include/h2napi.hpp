@@ -6,8 +6,57 @@
 #include <atomic>
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <new>
+
+#if !defined(H2NAPI_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define H2NAPI_SSE2 1
+	#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
 namespace Hand2Note {
 
+	namespace detail {
+		inline unsigned CountTrailingZeros(uint32_t v) {
+#ifdef _MSC_VER
+			unsigned long idx;
+			_BitScanForward(&idx, v);
+			return (unsigned)idx;
+#else
+			return (unsigned)__builtin_ctz(v);
+#endif
+		}
+
+		inline unsigned PopCount(uint32_t v) {
+			v = v - ((v >> 1) & 0x55555555);
+			v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+			return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+		}
+
+		// Amounts with at most two decimals (stacks, pots, blinds) are exactly value == cents / 100.
+		inline bool ToCents(double v, int64_t& cents) {
+			if (!(std::fabs(v) < 1e12))
+				return false;
+			// any rounding to the nearest integer will do, the result is checked
+			const double c = v * 100;
+			cents = (int64_t)(c < 0 ? c - 0.5 : c + 0.5);
+			return (double)cents / 100 == v;
+		}
+	}
+
 	class ClientStatusChecker {
 	public:
 		virtual ~ClientStatusChecker() {}
@@ -59,6 +108,102 @@ namespace Hand2Note {
 
 	};
 
+	// Paces a producer by the fill level of the queue to Hand2Note. on_high is called when the
+	// queue fills above high, on_low when it drained below low again, both from a thread polling
+	// the level. An importer pausing in between leaves the rest of the queue to live HUD messages
+	// and doesn't get H2N_STATUS_QUEUE_FULL.
+	//
+	//	Hand2Note::FlowControl flow;
+	//	for (auto& hand : hands) {
+	//		flow.WaitUntilLow(std::chrono::seconds(5));
+	//		Hand2Note::Protocol::SendHandHistory(hand);
+	//	}
+	//
+	// The level comes from h2n_queue_usage, not exported by the prebuilt h2napi.dll.
+	class FlowControl {
+	public:
+		// high and low are fractions of the queue size, 0 <= low < high <= 1
+		FlowControl(std::function<void()> on_high = nullptr, std::function<void()> on_low = nullptr,
+			double high = 0.75, double low = 0.25, std::chrono::milliseconds poll = std::chrono::milliseconds(1)) :
+			on_high_(std::move(on_high)), on_low_(std::move(on_low)), high_(high), low_(low), poll_(poll),
+			level_(0), above_(false), loop_(true)
+		{
+			poll_thread_ = std::thread([this]() { DoWork(); });
+		}
+
+		~FlowControl() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				loop_ = false;
+			}
+			changed_.notify_all();
+			poll_thread_.join();
+		}
+
+		FlowControl(const FlowControl&) = delete;
+		FlowControl& operator=(const FlowControl&) = delete;
+
+		// Fraction of the queue filled at the last poll, 0 without a consumer
+		double Level() const { return level_.load(std::memory_order_relaxed); }
+
+		// true from crossing the high watermark until the queue drained below the low one
+		bool IsThrottled() const { return above_.load(std::memory_order_acquire); }
+
+		// Returns at once unless throttled, then waits for the low watermark. false on timeout.
+		bool WaitUntilLow(std::chrono::milliseconds timeout) {
+			if (!IsThrottled())
+				return true;
+			std::unique_lock<std::mutex> lock(mutex_);
+			return changed_.wait_for(lock, timeout, [this] { return !IsThrottled() || !loop_; });
+		}
+
+		// h2n_wait_writable: waits until a message with bytes of strings fits the queue, an h2n_status
+		static int WaitWritable(unsigned int bytes, std::chrono::milliseconds timeout) {
+			return h2n_wait_writable(bytes, (int)timeout.count());
+		}
+
+	private:
+		std::function<void()> on_high_;
+		std::function<void()> on_low_;
+		const double high_;
+		const double low_;
+		const std::chrono::milliseconds poll_;
+		std::atomic<double> level_;
+		std::atomic<bool> above_;
+		bool loop_;
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		std::thread poll_thread_;
+
+		void DoWork() {
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (loop_) {
+				lock.unlock();
+				unsigned int used = 0, capacity = 0;
+				// without a consumer senders fail at once, nothing to wait for
+				double level = h2n_queue_usage(&used, &capacity) == H2N_STATUS_OK && capacity ? (double)used / capacity : 0;
+				level_.store(level, std::memory_order_relaxed);
+				bool above = above_.load(std::memory_order_relaxed);
+				if (!above && level >= high_) {
+					above_.store(true, std::memory_order_release);
+					if (on_high_)
+						on_high_();
+				}
+				else if (above && level <= low_) {
+					{
+						std::lock_guard<std::mutex> changed(mutex_);
+						above_.store(false, std::memory_order_release);
+					}
+					changed_.notify_all();
+					if (on_low_)
+						on_low_();
+				}
+				lock.lock();
+				changed_.wait_for(lock, poll_, [this] { return !loop_; });
+			}
+		}
+	};
+
 
 	enum class HandHistoryFormat : int
 	{
@@ -98,15 +243,177 @@ namespace Hand2Note {
 		}
 	};
 
+	typedef uint32_t StringId;
+
+	// Process-wide dictionary of strings (nicknames, player ids) to dense 32-bit ids.
+	//
+	// Find and Resolve don't lock: strings live in chunks that never move, and the hash table
+	// slots are published atomically. Intern takes a lock only for a new string; a grown table
+	// replaces the old one, which is kept until the interner is destroyed for readers still on it.
+	// Ids are never reused, an interner holding limit strings takes no new ones.
+	//
+	//	StringId id = StringInterner::Global().Intern(u8"德州小丑王");
+	//	seat.InternedNickname(id);
+	class StringInterner {
+	public:
+		enum : StringId { None = 0xFFFFFFFF };
+
+		// limit is capped at MaxSize(), the ids the chunk table has room for
+		explicit StringInterner(size_t limit = MaxSize()) : size_(0), limit_(limit < MaxSize() ? limit : MaxSize()), table_(nullptr) {
+			for (auto& chunk : chunks_)
+				chunk.store(nullptr, std::memory_order_relaxed);
+			table_.store(NewTable(MinSlots), std::memory_order_relaxed);
+		}
+
+		~StringInterner() {
+			for (auto& chunk : chunks_)
+				delete[] chunk.load(std::memory_order_relaxed);
+			for (Table* t : retired_)
+				Free(t);
+			Free(table_.load(std::memory_order_relaxed));
+		}
+
+		static StringInterner& Global() {
+			static StringInterner interner;
+			return interner;
+		}
+
+		size_t Size() const { return size_.load(std::memory_order_acquire); }
+
+		static size_t MaxSize() { return (size_t)MaxChunks * ChunkSize; }
+
+		// Id of the string, None if it isn't interned
+		StringId Find(const char* str, size_t len) const {
+			return Find(str, len, Hash(str, len));
+		}
+
+		StringId Find(const std::string& str) const { return Find(str.data(), str.size()); }
+
+		// Id of the string, interned if it is new. None for a new string once the interner is full.
+		StringId Intern(const char* str, size_t len) {
+			const uint32_t hash = Hash(str, len);
+			StringId id = Find(str, len, hash);
+			if (id != None)
+				return id;
+			std::lock_guard<std::mutex> lock(mutex_);
+			id = Find(str, len, hash);
+			if (id != None)
+				return id;
+			if (size_.load(std::memory_order_relaxed) >= limit_)
+				return None;
+			id = (StringId)size_.load(std::memory_order_relaxed);
+			std::string* chunk = chunks_[id >> ChunkBits].load(std::memory_order_relaxed);
+			if (!chunk) {
+				chunk = new std::string[ChunkSize];
+				chunks_[id >> ChunkBits].store(chunk, std::memory_order_release);
+			}
+			chunk[id & (ChunkSize - 1)].assign(str, len);
+			// the string is complete before its id can be seen
+			size_.store(id + 1, std::memory_order_release);
+			Table* t = table_.load(std::memory_order_relaxed);
+			if ((id + 1) * 2 > t->mask + 1)
+				t = Grow(t);
+			Insert(t, hash, id);
+			return id;
+		}
+
+		StringId Intern(const std::string& str) { return Intern(str.data(), str.size()); }
+
+		// Interns the decimal string of a numeric player id
+		StringId Intern(uint64_t player_id) {
+			char buf[24];
+			int len = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)player_id);
+			return Intern(buf, (size_t)len);
+		}
+
+		// The string of an interned id, stays valid for the life of the interner. id must be one
+		// Intern returned, not None.
+		const std::string& Resolve(StringId id) const {
+			assert(id < Size());
+			return chunks_[id >> ChunkBits].load(std::memory_order_acquire)[id & (ChunkSize - 1)];
+		}
+
+	private:
+		enum : uint32_t { ChunkBits = 12, ChunkSize = 1u << ChunkBits, MaxChunks = 1u << 14, MinSlots = 1024 };
+
+		// slot is (hash << 32 | id + 1), 0 when empty
+		struct Table {
+			size_t                mask;
+			std::atomic<uint64_t> slots[1];
+		};
+
+		std::atomic<std::string*> chunks_[MaxChunks];
+		std::atomic<size_t>       size_;
+		const size_t              limit_;
+		std::atomic<Table*>       table_;
+		std::vector<Table*>       retired_;
+		std::mutex                mutex_;
+
+		StringInterner(const StringInterner&) = delete;
+		StringInterner& operator=(const StringInterner&) = delete;
+
+		// FNV-1a
+		static uint32_t Hash(const char* str, size_t len) {
+			uint32_t h = 2166136261u;
+			for (size_t i = 0; i < len; ++i)
+				h = (h ^ (uint8_t)str[i]) * 16777619u;
+			return h;
+		}
+
+		static Table* NewTable(size_t slots) {
+			Table* t = (Table*)::operator new(sizeof(Table) + (slots - 1) * sizeof(std::atomic<uint64_t>));
+			t->mask = slots - 1;
+			for (size_t i = 0; i < slots; ++i)
+				new (&t->slots[i]) std::atomic<uint64_t>(0);
+			return t;
+		}
+
+		static void Free(Table* t) { ::operator delete(t); }
+
+		StringId Find(const char* str, size_t len, uint32_t hash) const {
+			const Table* t = table_.load(std::memory_order_acquire);
+			for (size_t i = hash & t->mask; ; i = (i + 1) & t->mask) {
+				uint64_t slot = t->slots[i].load(std::memory_order_acquire);
+				if (!slot)
+					return None;
+				if ((uint32_t)(slot >> 32) != hash)
+					continue;
+				StringId id = (StringId)slot - 1;
+				const std::string& s = Resolve(id);
+				if (s.size() == len && memcmp(s.data(), str, len) == 0)
+					return id;
+			}
+		}
+
+		static void Insert(Table* t, uint32_t hash, StringId id) {
+			size_t i = hash & t->mask;
+			while (t->slots[i].load(std::memory_order_relaxed))
+				i = (i + 1) & t->mask;
+			t->slots[i].store((uint64_t)hash << 32 | (id + 1), std::memory_order_release);
+		}
+
+		Table* Grow(Table* old) {
+			Table* t = NewTable((old->mask + 1) * 2);
+			for (size_t i = 0; i <= old->mask; ++i) {
+				uint64_t slot = old->slots[i].load(std::memory_order_relaxed);
+				if (slot)
+					Insert(t, (uint32_t)(slot >> 32), (StringId)slot - 1);
+			}
+			table_.store(t, std::memory_order_release);
+			retired_.push_back(old);
+			return t;
+		}
+	};
+
 	class HandHistoryMessage {
 	public:
 		HandHistoryMessage() :
-			room_(Room::PokerStars), format_(HandHistoryFormat::PokerStars), game_id_(0), is_zoom_(false)
+			format_(HandHistoryFormat::PokerStars), room_(Room::PokerStars), game_id_(0), is_zoom_(false)
 		{
 		}
 
 		HandHistoryMessage(Room room, uint64_t game_id, HandHistoryFormat format, const std::string& FormattedHandHistory) :
-			room_(room), format_(format), game_id_(game_id), fhh_(FormattedHandHistory), is_zoom_(false)
+			fhh_(FormattedHandHistory), format_(format), room_(room), game_id_(game_id), is_zoom_(false)
 		{
 		}
 
@@ -132,7 +439,7 @@ namespace Hand2Note {
 		std::string ohh_;
 		HandHistoryFormat format_;
 		Room room_;
-		uint64 game_id_;
+		uint64_t game_id_;
 		bool is_zoom_;
 
 		void MakeH2NApiLibMessage(h2n_hh_message* msg) const {
@@ -151,36 +458,107 @@ namespace Hand2Note {
 	class SeatInfo {
 	public:
 		SeatInfo() :
-			seat_idx_(0), stack_(0), is_hero_(false), player_id_(0), is_dealer_(false), 
-			is_posted_bb_(false), is_posted_sb_(false), is_posted_bb_outofqueue_(false), 
-			is_posted_sb_outofqueue_(false), is_posted_straddle_(false), is_sitting_out_(false)
+			seat_idx_(0), nickname_id_(StringInterner::None), player_id_str_id_(StringInterner::None),
+			player_id_(0), stack_(0), is_dealer_(false), is_posted_sb_(false), is_posted_bb_(false),
+			is_posted_sb_outofqueue_(false), is_posted_bb_outofqueue_(false), is_posted_straddle_(false),
+			is_hero_(false), is_sitting_out_(false)
 		{
 		}
 
 		SeatInfo(const std::string& name, int index, double stack, bool is_hero = false):
-			nickname_(name), seat_idx_(index), stack_(stack), is_hero_(is_hero),
-			player_id_(0), is_dealer_(false), is_posted_bb_(false), is_posted_sb_(false),
-			is_posted_bb_outofqueue_(false), is_posted_sb_outofqueue_(false), is_posted_straddle_(false),
-			is_sitting_out_(false)
+			seat_idx_(index), nickname_(name), nickname_id_(StringInterner::None), player_id_str_id_(StringInterner::None),
+			player_id_(0), stack_(stack), is_dealer_(false), is_posted_sb_(false), is_posted_bb_(false),
+			is_posted_sb_outofqueue_(false), is_posted_bb_outofqueue_(false), is_posted_straddle_(false),
+			is_hero_(is_hero), is_sitting_out_(false)
 		{
 		}
 
-		SeatInfo(uint64 player_id, int index, double stack, bool is_hero = false): 
-			seat_idx_(index), stack_(stack), is_hero_(is_hero),
-			player_id_(player_id), is_dealer_(false), is_posted_bb_(false), is_posted_sb_(false),
-			is_posted_bb_outofqueue_(false), is_posted_sb_outofqueue_(false), is_posted_straddle_(false),
-			is_sitting_out_(false)
+		SeatInfo(uint64_t player_id, int index, double stack, bool is_hero = false):
+			seat_idx_(index), nickname_id_(StringInterner::None), player_id_str_id_(StringInterner::None),
+			player_id_(player_id), stack_(stack), is_dealer_(false), is_posted_sb_(false), is_posted_bb_(false),
+			is_posted_sb_outofqueue_(false), is_posted_bb_outofqueue_(false), is_posted_straddle_(false),
+			is_hero_(is_hero), is_sitting_out_(false)
 		{
 		}
 
 		int SeatIndex() const { return seat_idx_; }
 		void SeatIndex(int idx) { seat_idx_ = idx; }
 
-		const std::string& Nickname() const { return nickname_; }
-		void Nickname(const std::string& nick) { nickname_ = nick; }
+		const std::string& Nickname() const {
+			return nickname_id_ != StringInterner::None ? StringInterner::Global().Resolve(nickname_id_) : nickname_;
+		}
+		void Nickname(const std::string& nick) { nickname_ = nick; nickname_id_ = StringInterner::None; }
+
+		uint64_t PlayerId() const { return player_id_; }
+		void PlayerId(uint64_t pid) { player_id_ = pid; player_id_str_id_ = StringInterner::None; player_id_str_.clear(); }
+
+		// Any player id string h2n_seat_info takes. Ids that aren't the decimal form of a number
+		// are interned as they are, or kept by the seat once the interner is full, and PlayerId() is 0 for them.
+		void PlayerId(const std::string& pid) {
+			uint64_t id;
+			if (ParsePlayerId(pid.data(), pid.size(), id))
+				PlayerId(id);
+			else {
+				player_id_ = 0;
+				player_id_str_id_ = StringInterner::Global().Intern(pid);
+				if (player_id_str_id_ == StringInterner::None)
+					player_id_str_ = pid;
+				else
+					player_id_str_.clear();
+			}
+		}
+
+		// The player id as sent to Hand2Note
+		const std::string& PlayerIdString() const {
+			if (player_id_str_id_ != StringInterner::None)
+				return StringInterner::Global().Resolve(player_id_str_id_);
+			// with a zero PlayerId() the string is the id set or an earlier "0"
+			if (player_id_ || player_id_str_.empty())
+				player_id_str_ = std::to_string(player_id_);
+			return player_id_str_;
+		}
+
+		// The id PlayerIdString() sends when it isn't the decimal form of PlayerId(), nullptr otherwise
+		const std::string* PlayerIdText() const {
+			if (player_id_)
+				return nullptr;
+			if (player_id_str_id_ != StringInterner::None)
+				return &StringInterner::Global().Resolve(player_id_str_id_);
+			return player_id_str_.empty() || player_id_str_ == "0" ? nullptr : &player_id_str_;
+		}
+
+		// true if str is the decimal form of a player id, the one PlayerId(uint64_t) sends
+		static bool ParsePlayerId(const char* str, size_t len, uint64_t& id) {
+			if (!len || len > 20 || (str[0] == '0' && len > 1))
+				return false;
+			id = 0;
+			for (size_t i = 0; i < len; ++i) {
+				const unsigned digit = (unsigned)(str[i] - '0');
+				if (digit > 9 || id > (UINT64_MAX - digit) / 10)
+					return false;
+				id = id * 10 + digit;
+			}
+			return true;
+		}
+
+		// Nickname interned in StringInterner::Global(), the seat holds no string of its own.
+		// None, from a full interner, keeps the plain nickname set before.
+		StringId InternedNickname() const { return nickname_id_; }
+		void InternedNickname(StringId id) {
+			nickname_id_ = id;
+			if (id != StringInterner::None)
+				nickname_.clear();
+		}
 
-		uint64 PlayerId() const { return player_id_; }
-		void PlayerId(uint64 pid) { player_id_ = pid; }
+		// The interned player id string, None unless set by InternedPlayerId or a non-numeric PlayerId
+		StringId InternedPlayerId() const { return player_id_str_id_; }
+
+		// Sets the player id and its interned decimal string, sent as is instead of being formatted per message
+		void InternedPlayerId(uint64_t pid) {
+			player_id_ = pid;
+			player_id_str_.clear();
+			player_id_str_id_ = StringInterner::Global().Intern(pid);
+		}
 
 		double Stack() const { return stack_; }
 		void Stack(double s) { stack_ = s; }
@@ -215,7 +593,9 @@ namespace Hand2Note {
 	private:
 		int          seat_idx_;
 		std::string  nickname_;
-		uint64       player_id_;
+		StringId     nickname_id_;
+		StringId     player_id_str_id_;
+		uint64_t     player_id_;
 		double       stack_;
 		std::string  pocket_cards_;
 		bool         is_dealer_;
@@ -237,9 +617,8 @@ namespace Hand2Note {
 			s->is_posted_sb_outofqueue = is_posted_sb_outofqueue_ ? 1 : 0;
 			s->is_posted_straddle = is_posted_straddle_ ? 1 : 0;
 			s->is_sitting_out = is_sitting_out_ ? 1 : 0;
-			s->nickname = nickname_.c_str();
-			player_id_str_ = std::to_string(player_id_);
-			s->player_id = player_id_str_.c_str();
+			s->nickname = Nickname().c_str();
+			s->player_id = PlayerIdString().c_str();
 			s->pocket_cards = pocket_cards_.c_str();
 			s->seat_idx = seat_idx_;
 			s->stack = stack_;
@@ -256,13 +635,15 @@ namespace Hand2Note {
 		HandStartMessage() :
 			room_(Room::PokerStars), game_id_(0), table_hwnd_(0), max_players_(0),
 			is_tourney_(false), is_omaha_(false), is_limit_(false), is_zoom_(false),
-			is_cap_(false), is_potlimit_(false), currency_(Currency::Dollar), sb_(0), bb_(0),
+			is_cap_(false), is_potlimit_(false), is_shortdeck_(false), is_omahafive_(false),
+			is_straightbeatstrips_(true), currency_(Currency::Dollar), sb_(0), bb_(0),
 			ante_(0), straddle_(0)
 		{}
-		HandStartMessage(Room room, uint64 gameid = 0, int table_hwnd = 0) :
+		HandStartMessage(Room room, uint64_t gameid = 0, int table_hwnd = 0) :
 			room_(room), game_id_(gameid), table_hwnd_(table_hwnd), max_players_(0),
 			is_tourney_(false), is_omaha_(false), is_limit_(false), is_zoom_(false),
-			is_cap_(false), is_potlimit_(false), currency_(Currency::Dollar), sb_(0), bb_(0),
+			is_cap_(false), is_potlimit_(false), is_shortdeck_(false), is_omahafive_(false),
+			is_straightbeatstrips_(true), currency_(Currency::Dollar), sb_(0), bb_(0),
 			ante_(0), straddle_(0)
 		{}
 
@@ -299,6 +680,16 @@ namespace Hand2Note {
 		bool IsPotLimit() const { return is_potlimit_; }
 		void SetPotLimit(bool potlim) { is_potlimit_ = potlim; }
 
+		bool IsShortDeck() const { return is_shortdeck_; }
+		void SetShortDeck(bool shortdeck) { is_shortdeck_ = shortdeck; }
+
+		bool IsOmahaFive() const { return is_omahafive_; }
+		void SetOmahaFive(bool omahafive) { is_omahafive_ = omahafive; }
+
+		// short deck only, true by default
+		bool IsStraightBeatsTrips() const { return is_straightbeatstrips_; }
+		void SetStraightBeatsTrips(bool straightbeatstrips) { is_straightbeatstrips_ = straightbeatstrips; }
+
 		Currency currency() const { return currency_; }
 		void SetCurrency(Currency curr) { currency_ = curr; }
 
@@ -318,7 +709,7 @@ namespace Hand2Note {
 		const SeatsList& Seats() const { return seats_; }
 	private:
 		Room        room_;
-		uint64      game_id_;
+		uint64_t    game_id_;
 		std::string table_name_;
 		int         table_hwnd_;
 		int         max_players_;
@@ -328,6 +719,9 @@ namespace Hand2Note {
 		bool        is_zoom_;
 		bool        is_cap_;
 		bool        is_potlimit_;
+		bool        is_shortdeck_;
+		bool        is_omahafive_;
+		bool        is_straightbeatstrips_;
 		Currency    currency_;
 		double      sb_;
 		double      bb_;
@@ -346,6 +740,9 @@ namespace Hand2Note {
 			msg->is_limit = is_limit_ ? 1 : 0;
 			msg->is_omaha = is_omaha_ ? 1 : 0;
 			msg->is_potlimit = is_potlimit_ ? 1 : 0;
+			msg->is_shortdeck = is_shortdeck_ ? 1 : 0;
+			msg->is_omahafive = is_omahafive_ ? 1 : 0;
+			msg->is_straightbeatstrips = is_straightbeatstrips_ ? 1 : 0;
 			msg->is_tourney = is_tourney_ ? 1 : 0;
 			msg->is_zoom = is_zoom_ ? 1 : 0;
 			msg->max_players = max_players_;
@@ -355,8 +752,9 @@ namespace Hand2Note {
 			msg->table_hwnd = table_hwnd_;
 			msg->table_name = table_name_.c_str();
 
+			// seats past H2N_MAX_SEATS don't fit, Protocol::SendHandStart rejects such messages
 			msg->seats_num = 0;
-			for (SeatsList::const_iterator it = seats_.cbegin(); it != seats_.cend(); ++it) {
+			for (SeatsList::const_iterator it = seats_.cbegin(); it != seats_.cend() && msg->seats_num < H2N_MAX_SEATS; ++it) {
 				it->MakeH2NApiSeatInfo( &(msg->seats[msg->seats_num++]));
 			}
 		}
@@ -378,6 +776,23 @@ namespace Hand2Note {
 		River = H2N_STREET_RIVER,
 	};
 
+	enum class Command : int
+	{
+		CloseHud = H2N_COMMAND_CLOSEHUD,
+		ReopenTable = H2N_COMMAND_REOPENTABLE,
+		RestartEmulator = H2N_COMMAND_RESTARTEMULATOR,
+	};
+
+	// The int results of Protocol::Send*
+	enum class SendStatus : int
+	{
+		Ok = H2N_STATUS_OK,
+		QueueFull = H2N_STATUS_QUEUE_FULL,
+		ConsumerAbsent = H2N_STATUS_CONSUMER_ABSENT,
+		InvalidMessage = H2N_STATUS_INVALID_MESSAGE,
+		Truncated = H2N_STATUS_TRUNCATED,
+	};
+
 	class HandActionMessage {
 	public:
 		HandActionMessage() :
@@ -409,7 +824,7 @@ namespace Hand2Note {
 		void Pot(double val) { pot_ = val; }
 
 	private:
-		uint64      game_id_;
+		uint64_t    game_id_;
 		int         seat_idx_;
 		Action      type_;
 		double      amount_;
@@ -436,7 +851,7 @@ namespace Hand2Note {
 		}
 
 		HandStreetMessage(uint64_t game_id, Street type, const std::string& board, double pot = 0) :
-			game_id_(game_id), type_(type), board_(board), pot_(0)
+			game_id_(game_id), type_(type), board_(board), pot_(pot)
 		{
 		}
 
@@ -453,9 +868,9 @@ namespace Hand2Note {
 		void Pot(double val) { pot_ = val; }
 
 	private:
-		uint64      game_id_;
+		uint64_t    game_id_;
 		Street      type_;
-		str         board_;
+		std::string board_;
 		double      pot_;
 
 		void MakeH2NApiLibMessage(h2n_street_message* msg) const {
@@ -468,32 +883,2663 @@ namespace Hand2Note {
 		friend class Protocol;
 	};
 
+	// 52 bit card set, bit Cards::Index(card): 13 ranks (2..A) of clubs, then diamonds, hearts and spades
+	typedef uint64_t CardMask;
 
-	class Protocol {
+	enum class CardsResult : int
+	{
+		Ok = 0,
+		InvalidCard,    // not a rank followed by a suit like "Ts", or 2..5 in short deck
+		DuplicateCard,  // card repeated or already dealt elsewhere
+		InvalidCount,   // wrong number of cards for the street or the game
+	};
+
+	// Card strings of SeatInfo::PoketCards and HandStreetMessage::Board ("5h8s7sTs") to card masks and back.
+	class Cards {
 	public:
-		inline static int SendHandHistory(const HandHistoryMessage& msg) {
-			h2n_hh_message m;
-			msg.MakeH2NApiLibMessage(&m);
-			return h2n_send_handhistory(&m);
+		static const int Count = 52;
+		static const int ShortDeckCount = 36;
+
+		// 0..12 for 2..A, -1 if c is not a rank
+		static constexpr int Rank(char c) {
+			return c >= '2' && c <= '9' ? c - '2' : c == 'T' ? 8 : c == 'J' ? 9 : c == 'Q' ? 10 : c == 'K' ? 11 : c == 'A' ? 12 : -1;
 		}
-		inline static int SendHandStart(const HandStartMessage& msg) {
-			h2n_start_hand_message m;
-			msg.MakeH2NApiLibMessage(&m);
-			return h2n_send_hand_start(&m);
+
+		// 0..3 for c, d, h, s, -1 if c is not a suit
+		static constexpr int Suit(char c) {
+			return c == 'c' ? 0 : c == 'd' ? 1 : c == 'h' ? 2 : c == 's' ? 3 : -1;
 		}
-		inline static int SendHandActon(const HandActionMessage& msg) {
-			h2n_action_message m;
-			msg.MakeH2NApiLibMessage(&m);
-			return h2n_send_action(&m);
+
+		// Bit of the card in CardMask, -1 if invalid
+		static constexpr int Index(char rank, char suit) {
+			return Rank(rank) < 0 || Suit(suit) < 0 ? -1 : Suit(suit) * 13 + Rank(rank);
 		}
-		inline static int SendHandStreed(const HandStreetMessage& msg) {
-			h2n_street_message m;
-			msg.MakeH2NApiLibMessage(&m);
-			return h2n_send_street(&m);
+
+		static constexpr CardMask Card(char rank, char suit) {
+			return Index(rank, suit) < 0 ? 0 : (CardMask)1 << Index(rank, suit);
+		}
+
+		// Ranks 2..5 of all suits, not in play in short deck
+		static constexpr CardMask LowRanks = 0xFull | 0xFull << 13 | 0xFull << 26 | 0xFull << 39;
+
+		static int Size(CardMask mask) {
+			return (int)(detail::PopCount((uint32_t)mask) + detail::PopCount((uint32_t)(mask >> 32)));
+		}
+
+		// Card count per street: board of flop, turn, river, 0 for preflop
+		static int BoardCount(Street street) {
+			return street == Street::Flop ? 3 : street == Street::Turn ? 4 : street == Street::River ? 5 : 0;
+		}
+
+		// Pocket cards per player: 5 in five card omaha, 4 in omaha, 2 otherwise
+		static int PocketCount(const HandStartMessage& msg) {
+			return msg.IsOmahaFive() ? 5 : msg.IsOmaha() ? 4 : 2;
+		}
+
+		// Parses a card string into mask, cards already in dead are reported as duplicates.
+		static CardsResult Parse(const char* begin, const char* end, CardMask& mask, CardMask dead = 0, bool short_deck = false) {
+			mask = 0;
+			if ((end - begin) & 1)
+				return CardsResult::InvalidCard;
+			const Tables& t = Lookup();
+			const CardMask low = short_deck ? LowRanks : 0;
+			for (const char* p = begin; p != end; p += 2) {
+				unsigned idx = t.rank[(uint8_t)p[0]] + t.suit[(uint8_t)p[1]];
+				CardMask card = (CardMask)1 << (idx & 63);
+				if (idx >= Count || (card & low))
+					return CardsResult::InvalidCard;
+				if ((mask | dead) & card)
+					return CardsResult::DuplicateCard;
+				mask |= card;
+			}
+			return CardsResult::Ok;
+		}
+
+		static CardsResult Parse(const std::string& cards, CardMask& mask, CardMask dead = 0, bool short_deck = false) {
+			return Parse(cards.data(), cards.data() + cards.size(), mask, dead, short_deck);
+		}
+
+		// Writes 2 chars per card in mask order (no terminating zero), returns the length
+		static size_t Format(CardMask mask, char* out) {
+			static const char ranks[] = "23456789TJQKA";
+			static const char suits[] = "cdhs";
+			char* p = out;
+			for (; mask; mask &= mask - 1) {
+				unsigned idx = CountTrailingZeros64(mask);
+				*p++ = ranks[idx % 13];
+				*p++ = suits[idx / 13];
+			}
+			return p - out;
+		}
+
+		static std::string ToString(CardMask mask) {
+			char buf[Count * 2];
+			return std::string(buf, Format(mask, buf));
+		}
+
+		// 36 bit short deck mask, 9 ranks (6..A) per suit, and back
+		static CardMask ToShortDeck(CardMask mask) {
+			CardMask out = 0;
+			for (int s = 0; s < 4; ++s)
+				out |= (mask >> (s * 13 + 4) & 0x1FF) << (s * 9);
+			return out;
+		}
+
+		static CardMask FromShortDeck(CardMask mask) {
+			CardMask out = 0;
+			for (int s = 0; s < 4; ++s)
+				out |= (mask >> (s * 9) & 0x1FF) << (s * 13 + 4);
+			return out;
+		}
+
+		// Board for the street, not overlapping dead (e.g. known pocket cards)
+		static CardsResult Validate(const HandStreetMessage& msg, CardMask& board, CardMask dead = 0, bool short_deck = false) {
+			CardsResult result = Parse(msg.Board(), board, dead, short_deck);
+			if (result == CardsResult::Ok && Size(board) != BoardCount(msg.StreetType()))
+				return CardsResult::InvalidCount;
+			return result;
+		}
+
+		// Known pocket cards of all seats: count per game type, no card dealt twice
+		static CardsResult Validate(const HandStartMessage& msg, CardMask& dealt) {
+			dealt = 0;
+			const size_t count = PocketCount(msg) * 2;
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			for (size_t i = 0; i < seats.size(); ++i) {
+				const std::string& cards = seats[i].PoketCards();
+				if (cards.empty())
+					continue;
+				if (cards.size() != count)
+					return CardsResult::InvalidCount;
+				CardMask mask;
+				CardsResult result = Parse(cards, mask, dealt, msg.IsShortDeck());
+				if (result != CardsResult::Ok)
+					return result;
+				dealt |= mask;
+			}
+			return CardsResult::Ok;
+		}
+
+	private:
+		// rank 0..12 and suit * 13 by char, 64 for anything else, so that a valid card sums to its index
+		struct Tables {
+			uint8_t rank[256];
+			uint8_t suit[256];
+
+			constexpr Tables() : rank(), suit() {
+				for (int c = 0; c < 256; ++c) {
+					rank[c] = Rank((char)c) < 0 ? 64 : (uint8_t)Rank((char)c);
+					suit[c] = Suit((char)c) < 0 ? 64 : (uint8_t)(Suit((char)c) * 13);
+				}
+			}
+		};
+
+		static const Tables& Lookup() {
+			static constexpr Tables tables;
+			return tables;
+		}
+
+		static unsigned CountTrailingZeros64(uint64_t v) {
+			return (uint32_t)v ? detail::CountTrailingZeros((uint32_t)v) : 32 + detail::CountTrailingZeros((uint32_t)(v >> 32));
 		}
+	};
 
+
+	enum class HandCategory : int
+	{
+		HighCard = 0,
+		Pair,
+		TwoPair,
+		Trips,
+		Straight,
+		Flush,
+		FullHouse,
+		Quads,
+		StraightFlush,
 	};
-}
+
+	// Strength of the best five card hand, greater is better.
+	// bits 24..27 rank of the category under the game rules, 20..23 HandCategory, 0..19 ranks (0..12) of
+	// the cards deciding within the category, 4 bits each, most significant first.
+	typedef uint32_t HandValue;
+
+	// Showdown hand evaluation from card masks: hold'em (5..7 cards), short deck and omaha with 4 or 5 pocket cards.
+	//
+	// Lookup tables by 13 bit rank set (rank count, straights, top five ranks, top rank, ~64 KB) are built on first use.
+	// Pairs, trips and quads come from bit operations on the four suit rank sets.
+	class Evaluator {
+	public:
+		static HandCategory Category(HandValue v) { return (HandCategory)(v >> 20 & 0xF); }
+
+		// Best hand of 5..7 cards with regular rankings
+		static HandValue Eval(CardMask cards) {
+			const Tables& t = Lookup();
+			const uint32_t sc = (uint32_t)(cards & 0x1FFF), sd = (uint32_t)(cards >> 13 & 0x1FFF);
+			const uint32_t sh = (uint32_t)(cards >> 26 & 0x1FFF), ss = (uint32_t)(cards >> 39 & 0x1FFF);
+			const uint32_t ranks = sc | sd | sh | ss;
+			const unsigned n_ranks = t.bits[ranks];
+			const unsigned n_dups = t.bits[sc] + t.bits[sd] + t.bits[sh] + t.bits[ss] - n_ranks;
+
+			if (n_ranks >= 5) {
+				// with at most 7 cards a flush excludes quads and full house
+				for (uint32_t suit : { sc, sd, sh, ss }) {
+					if (t.bits[suit] >= 5) {
+						if (t.straight[suit])
+							return Value(HandCategory::StraightFlush, (uint32_t)(t.straight[suit] - 1) << 16);
+						return Value(HandCategory::Flush, t.top_five[suit]);
+					}
+				}
+				if (t.straight[ranks] && n_dups < 3)
+					return Value(HandCategory::Straight, (uint32_t)(t.straight[ranks] - 1) << 16);
+			}
+			HandValue v = Dups(t, sc, sd, sh, ss, ranks, n_dups);
+			if (n_ranks >= 5 && t.straight[ranks] && Category(v) < HandCategory::Straight)
+				return Value(HandCategory::Straight, (uint32_t)(t.straight[ranks] - 1) << 16);
+			return v;
+		}
+
+		// Short deck (6+) hold'em: flush beats full house, A6789 is the lowest straight,
+		// trips beat a straight unless straight_beats_trips (HandStartMessage::IsStraightBeatsTrips)
+		static HandValue EvalShortDeck(CardMask cards, bool straight_beats_trips = true) {
+			const Tables& t = Lookup();
+			const uint8_t* order = ShortDeckOrder(straight_beats_trips);
+			const uint32_t sc = (uint32_t)(cards & 0x1FFF), sd = (uint32_t)(cards >> 13 & 0x1FFF);
+			const uint32_t sh = (uint32_t)(cards >> 26 & 0x1FFF), ss = (uint32_t)(cards >> 39 & 0x1FFF);
+			const uint32_t ranks = sc | sd | sh | ss;
+			const unsigned n_ranks = t.bits[ranks];
+
+			HandValue best = Reorder(Dups(t, sc, sd, sh, ss, ranks, t.bits[sc] + t.bits[sd] + t.bits[sh] + t.bits[ss] - n_ranks), order);
+			if (n_ranks >= 5) {
+				for (uint32_t suit : { sc, sd, sh, ss }) {
+					if (t.bits[suit] >= 5) {
+						HandValue v = t.short_straight[suit]
+							? Value(HandCategory::StraightFlush, (uint32_t)(t.short_straight[suit] - 1) << 16, order)
+							: Value(HandCategory::Flush, t.top_five[suit], order);
+						best = v > best ? v : best;
+					}
+				}
+				if (t.short_straight[ranks]) {
+					HandValue v = Value(HandCategory::Straight, (uint32_t)(t.short_straight[ranks] - 1) << 16, order);
+					best = v > best ? v : best;
+				}
+			}
+			return best;
+		}
+
+		// Exactly five cards, regular rankings
+		static HandValue Eval5(CardMask cards) {
+			const Tables& t = Lookup();
+			const uint32_t sc = (uint32_t)(cards & 0x1FFF), sd = (uint32_t)(cards >> 13 & 0x1FFF);
+			const uint32_t sh = (uint32_t)(cards >> 26 & 0x1FFF), ss = (uint32_t)(cards >> 39 & 0x1FFF);
+			const uint32_t ranks = sc | sd | sh | ss;
+			const unsigned n_ranks = t.bits[ranks];
+			if (n_ranks < 5)
+				return Dups(t, sc, sd, sh, ss, ranks, 5 - n_ranks);
+			const bool flush = sc == ranks || sd == ranks || sh == ranks || ss == ranks;
+			if (t.straight[ranks])
+				return Value(flush ? HandCategory::StraightFlush : HandCategory::Straight, (uint32_t)(t.straight[ranks] - 1) << 16);
+			return Value(flush ? HandCategory::Flush : HandCategory::HighCard, t.top_five[ranks]);
+		}
+
+		// Omaha: exactly two of the 4 or 5 pocket cards and three of the board (3..5 cards)
+		static HandValue EvalOmaha(CardMask pocket, CardMask board) {
+			CardMask pairs[10], triples[10];
+			int n_pairs = Subsets(pocket, 2, pairs);
+			int n_triples = Subsets(board, 3, triples);
+			HandValue best = 0;
+			for (int i = 0; i < n_pairs; ++i) {
+				for (int j = 0; j < n_triples; ++j) {
+					HandValue v = Eval5(pairs[i] | triples[j]);
+					best = v > best ? v : best;
+				}
+			}
+			return best;
+		}
+
+		// Dispatch by the game of the hand
+		static HandValue Eval(const HandStartMessage& game, CardMask pocket, CardMask board) {
+			if (game.IsOmaha() || game.IsOmahaFive())
+				return EvalOmaha(pocket, board);
+			if (game.IsShortDeck())
+				return EvalShortDeck(pocket | board, game.IsStraightBeatsTrips());
+			return Eval(pocket | board);
+		}
+
+	private:
+		struct Tables {
+			uint8_t  bits[8192];           // number of ranks in the set
+			uint8_t  straight[8192];       // top rank + 1 of the best straight, 0 if none
+			uint8_t  short_straight[8192]; // same with A6789 as the lowest one
+			uint8_t  top_card[8192];
+			uint32_t top_five[8192];       // top five ranks packed 4 bits each
+
+			Tables() {
+				for (uint32_t m = 0; m < 8192; ++m) {
+					bits[m] = (uint8_t)detail::PopCount(m);
+					straight[m] = short_straight[m] = top_card[m] = 0;
+					top_five[m] = 0;
+					for (int top = 12; top >= 4; --top) {
+						uint32_t run = 0x1Fu << (top - 4);
+						if ((m & run) == run) {
+							straight[m] = short_straight[m] = (uint8_t)(top + 1);
+							break;
+						}
+					}
+					if (!straight[m] && (m & 0x100F) == 0x100F)
+						straight[m] = 4;
+					if (!short_straight[m] && (m & 0x10F0) == 0x10F0)
+						short_straight[m] = 8;
+					int n = 0;
+					for (int r = 12; r >= 0 && n < 5; --r) {
+						if (m >> r & 1) {
+							if (!n)
+								top_card[m] = (uint8_t)r;
+							top_five[m] |= (uint32_t)r << (16 - 4 * n++);
+						}
+					}
+				}
+			}
+		};
+
+		// rank of each HandCategory in short deck, flush above full house
+		static const uint8_t* ShortDeckOrder(bool straight_beats_trips) {
+			static const uint8_t straight_first[9] = { 0, 1, 2, 3, 4, 6, 5, 7, 8 };
+			static const uint8_t trips_first[9] = { 0, 1, 2, 4, 3, 6, 5, 7, 8 };
+			return straight_beats_trips ? straight_first : trips_first;
+		}
+
+		static const Tables& Lookup() {
+			static const Tables tables;
+			return tables;
+		}
+
+		static HandValue Value(HandCategory c, uint32_t ranks) {
+			return (uint32_t)c << 24 | (uint32_t)c << 20 | ranks;
+		}
+
+		static HandValue Value(HandCategory c, uint32_t ranks, const uint8_t* order) {
+			return (uint32_t)order[(int)c] << 24 | (uint32_t)c << 20 | ranks;
+		}
+
+		static HandValue Reorder(HandValue v, const uint8_t* order) {
+			return (uint32_t)order[(int)Category(v)] << 24 | (v & 0xFFFFFF);
+		}
+
+		// Best of quads, full house, trips, two pair, pair and high card
+		static HandValue Dups(const Tables& t, uint32_t sc, uint32_t sd, uint32_t sh, uint32_t ss, uint32_t ranks, unsigned n_dups) {
+			if (n_dups == 0)
+				return Value(HandCategory::HighCard, t.top_five[ranks]);
+			// ranks held 2 or 4 times
+			const uint32_t two_mask = ranks ^ (sc ^ sd ^ sh ^ ss);
+			if (n_dups == 1) {
+				uint32_t pair = t.top_card[two_mask];
+				return Value(HandCategory::Pair, pair << 16 | (t.top_five[ranks ^ two_mask] >> 8) << 4);
+			}
+			const uint32_t four_mask = sc & sd & sh & ss;
+			if (four_mask) {
+				uint32_t quads = t.top_card[four_mask];
+				return Value(HandCategory::Quads, quads << 16 | (uint32_t)t.top_card[ranks ^ (1u << quads)] << 12);
+			}
+			const uint32_t three_mask = ((sc & sd) | (sh & ss)) & ((sc & sh) | (sd & ss));
+			if (three_mask) {
+				uint32_t trips = t.top_card[three_mask];
+				uint32_t rest = (two_mask | three_mask) ^ (1u << trips);
+				if (rest)
+					return Value(HandCategory::FullHouse, trips << 16 | (uint32_t)t.top_card[rest] << 12);
+				return Value(HandCategory::Trips, trips << 16 | (t.top_five[ranks ^ (1u << trips)] >> 12) << 8);
+			}
+			uint32_t hi = t.top_card[two_mask];
+			uint32_t lo = t.top_card[two_mask ^ (1u << hi)];
+			uint32_t kicker = t.top_card[ranks ^ (1u << hi) ^ (1u << lo)];
+			return Value(HandCategory::TwoPair, hi << 16 | lo << 12 | kicker << 8);
+		}
+
+		// All k card subsets of mask (up to 5 cards)
+		static int Subsets(CardMask mask, int k, CardMask* out) {
+			CardMask cards[5];
+			int n = 0;
+			for (; mask && n < 5; mask &= mask - 1)
+				cards[n++] = mask & (~mask + 1);
+			int count = 0;
+			for (int a = 0; a < n; ++a) {
+				for (int b = a + 1; b < n; ++b) {
+					if (k == 2) {
+						out[count++] = cards[a] | cards[b];
+						continue;
+					}
+					for (int c = b + 1; c < n; ++c)
+						out[count++] = cards[a] | cards[b] | cards[c];
+				}
+			}
+			return count;
+		}
+	};
+
+	enum class TrackResult : int
+	{
+		Ok = 0,
+		UnknownHand,    // message gameid differs from the tracked hand
+		InvalidSeat,    // seat index out of range or nobody sits there
+		InactiveSeat,   // seat folded, is all-in or wasn't dealt in
+		IllegalAction,  // check facing a bet, bet after a bet, call or raise without a bet to call
+		InvalidAmount,  // amount doesn't match the action or exceeds the stack
+		InvalidStreet,  // street doesn't advance or board has wrong card count
+		InvalidCards,   // unparsable or duplicated cards, board doesn't extend the previous one
+	};
+
+	// Flat state of the tracked hand. Seats are addressed by SeatInfo::SeatIndex.
+	struct HandState {
+		uint64_t game_id;
+		int      street;                       // H2N_STREET_*
+		double   pot;                          // chips collected on previous streets, antes and dead blinds
+		double   committed[H2N_MAX_SEATS];     // chips put in on the current street
+		double   stack[H2N_MAX_SEATS];         // chips behind
+		double   to_call;                      // largest commitment on the current street
+		double   last_raise;                   // size of the last bet or raise, the minimal next raise
+		uint32_t seated_mask;                  // seats dealt in
+		uint32_t active_mask;                  // seats that haven't folded
+		uint32_t allin_mask;                   // active seats without chips behind
+		CardMask board;                        // board of the current street
+		CardMask dealt;                        // known pocket cards of all seats
+		bool     short_deck;
+	};
+
+	// Incremental state of the current hand on one table, fed with the same messages that are sent
+	// to Hand2Note. Tracks pot, per seat commitments and stacks, and checks action legality.
+	//
+	// Pot values filled in by the tracker: HandStreetMessage::Pot is the total pot at the start
+	// of the street, HandActionMessage::Pot is the total pot including the action.
+	//
+	// Amount conventions follow the C# Hand2Note.Api docs: call amount is the chips added,
+	// bet amount is the bet size and raise amount is the "raised to" total of the street.
+	class HandTracker {
+	public:
+		HandTracker() { memset(&state_, 0, sizeof(state_)); }
+
+		const HandState& State() const { return state_; }
+
+		uint64_t GameId() const { return state_.game_id; }
+
+		// Total pot including the current street commitments
+		double Pot() const {
+			double pot = state_.pot;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i)
+				pot += state_.committed[i];
+			return pot;
+		}
+
+		bool IsActive(int seat) const { return seat >= 0 && seat < H2N_MAX_SEATS && (state_.active_mask >> seat & 1); }
+		int ActiveCount() const { return (int)detail::PopCount(state_.active_mask); }
+
+		// Starts tracking a new hand, posts blinds, straddle and antes from the seat flags.
+		// Small blind out of queue is dead money, big blind out of queue is a live bet.
+		TrackResult Start(const HandStartMessage& msg) {
+			memset(&state_, 0, sizeof(state_));
+			state_.game_id = msg.GameId();
+			state_.street = H2N_STREET_PREFLOP;
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			TrackResult result = TrackResult::Ok;
+			for (size_t i = 0; i < seats.size(); ++i) {
+				const SeatInfo& s = seats[i];
+				int idx = s.SeatIndex();
+				if (idx < 0 || idx >= H2N_MAX_SEATS) {
+					result = TrackResult::InvalidSeat;
+					continue;
+				}
+				state_.stack[idx] = s.Stack();
+				if (s.IsSittingOut())
+					continue;
+				state_.seated_mask |= 1u << idx;
+				Post(idx, msg.Ante(), true);
+				if (s.IsPostedSmallBlind())
+					Post(idx, msg.SmallBlind(), false);
+				if (s.IsPostedSmallBlindOutOfQueue())
+					Post(idx, msg.SmallBlind(), true);
+				if (s.IsPostedBigBlind() || s.IsPostedBigBlindOutOfQueue())
+					Post(idx, msg.BigBlind(), false);
+				if (s.IsPostedStaddle())
+					Post(idx, msg.Straddle(), false);
+			}
+			state_.active_mask = state_.seated_mask;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (state_.committed[i] > state_.to_call)
+					state_.to_call = state_.committed[i];
+			}
+			state_.last_raise = msg.BigBlind() > 0 ? msg.BigBlind() : state_.to_call;
+			state_.short_deck = msg.IsShortDeck();
+			if (Cards::Validate(msg, state_.dealt) != CardsResult::Ok && result == TrackResult::Ok)
+				result = TrackResult::InvalidCards;
+			return result;
+		}
+
+		// Validates the action and applies it, fills msg.Pot() on success.
+		// The state is left untouched if the action is rejected.
+		TrackResult Apply(HandActionMessage& msg) {
+			TrackResult result = Apply((const HandActionMessage&)msg);
+			if (result == TrackResult::Ok)
+				msg.Pot(Pot());
+			return result;
+		}
+
+		TrackResult Apply(const HandActionMessage& msg) {
+			if (msg.GameId() != state_.game_id)
+				return TrackResult::UnknownHand;
+			int seat = msg.SeatIndex();
+			if (seat < 0 || seat >= H2N_MAX_SEATS || !(state_.seated_mask >> seat & 1))
+				return TrackResult::InvalidSeat;
+			uint32_t bit = 1u << seat;
+			if (!(state_.active_mask & bit) || (state_.allin_mask & bit))
+				return TrackResult::InactiveSeat;
+
+			double& committed = state_.committed[seat];
+			double& stack = state_.stack[seat];
+			double amount = msg.Amount();
+			double total;
+			switch (msg.ActionType()) {
+			case Action::Fold:
+				state_.active_mask &= ~bit;
+				return TrackResult::Ok;
+			case Action::Check:
+				if (Less(committed, state_.to_call))
+					return TrackResult::IllegalAction;
+				return TrackResult::Ok;
+			case Action::Call:
+				if (!Less(committed, state_.to_call))
+					return TrackResult::IllegalAction;
+				// short all-in calls are allowed
+				if (amount <= 0 || Less(state_.to_call - committed, amount) || (Less(amount, state_.to_call - committed) && Less(amount, stack)))
+					return TrackResult::InvalidAmount;
+				total = committed + amount;
+				break;
+			case Action::Bet:
+				if (state_.to_call > Epsilon)
+					return TrackResult::IllegalAction;
+				if (amount <= 0)
+					return TrackResult::InvalidAmount;
+				total = amount;
+				break;
+			case Action::Raise:
+				if (state_.to_call <= Epsilon)
+					return TrackResult::IllegalAction;
+				if (!Less(state_.to_call, amount))
+					return TrackResult::InvalidAmount;
+				total = amount;
+				break;
+			default:
+				return TrackResult::IllegalAction;
+			}
+
+			double put = total - committed;
+			if (Less(stack, put))
+				return TrackResult::InvalidAmount;
+			bool allin = msg.IsAllin() || !Less(put, stack);
+			if (msg.ActionType() != Action::Call) {
+				double raise = total - state_.to_call;
+				// incomplete raises are allowed only all-in
+				if (Less(raise, state_.last_raise) && !allin)
+					return TrackResult::InvalidAmount;
+				if (raise > state_.last_raise)
+					state_.last_raise = raise;
+				state_.to_call = total;
+			}
+			stack -= put;
+			committed = total;
+			if (allin)
+				state_.allin_mask |= bit;
+			return TrackResult::Ok;
+		}
+
+		// Collects the street commitments into the pot, fills msg.Pot() on success
+		TrackResult Apply(HandStreetMessage& msg) {
+			TrackResult result = Apply((const HandStreetMessage&)msg);
+			if (result == TrackResult::Ok)
+				msg.Pot(state_.pot);
+			return result;
+		}
+
+		TrackResult Apply(const HandStreetMessage& msg) {
+			if (msg.GameId() != state_.game_id)
+				return TrackResult::UnknownHand;
+			int street = (int)msg.StreetType();
+			size_t cards = Cards::BoardCount(msg.StreetType());
+			if (!cards || street <= state_.street || msg.Board().size() != cards * 2)
+				return TrackResult::InvalidStreet;
+			CardMask board;
+			if (Cards::Parse(msg.Board(), board, state_.dealt, state_.short_deck) != CardsResult::Ok || (board & state_.board) != state_.board)
+				return TrackResult::InvalidCards;
+			state_.board = board;
+			state_.pot = Pot();
+			memset(state_.committed, 0, sizeof(state_.committed));
+			state_.to_call = 0;
+			state_.last_raise = 0;
+			state_.street = street;
+			return TrackResult::Ok;
+		}
+
+	private:
+		HandState state_;
+
+		static constexpr double Epsilon = 1e-9;
+		static bool Less(double a, double b) { return a < b - Epsilon; }
+
+		void Post(int seat, double amount, bool dead) {
+			if (amount <= 0)
+				return;
+			if (amount > state_.stack[seat])
+				amount = state_.stack[seat];
+			state_.stack[seat] -= amount;
+			if (dead)
+				state_.pot += amount;
+			else
+				state_.committed[seat] += amount;
+			if (state_.stack[seat] <= Epsilon)
+				state_.allin_mask |= 1u << seat;
+		}
+	};
+
+
+	// Builds a PokerStars format (H2N_HHFMT_STARS) hand history from the dynamic messages of a hand,
+	// so the static hand history sent after the hand agrees with what was sent during it.
+	//
+	// Header, seats and posts are rendered at Start, every action and street appends its line,
+	// Render only adds the showdown and summary. The text buffer is reused between hands.
+	//
+	//	composer.Start(start);
+	//	composer.Apply(action); composer.Apply(street); ...
+	//	composer.Win(seat, amount); // only for showdowns, a single remaining player collects automatically
+	//	composer.Finish(hh_msg, time(nullptr));
+	class HandHistoryComposer {
+	public:
+		HandHistoryComposer() : room_(Room::PokerStars), button_(-1), hero_(-1), zoom_(false), finished_(false), time_pos_(0), time_len_(0)
+		{
+			text_.reserve(4096);
+		}
+
+		const HandTracker& Tracker() const { return tracker_; }
+
+		TrackResult Start(const HandStartMessage& msg) {
+			TrackResult result = tracker_.Start(msg);
+			room_ = msg.room();
+			zoom_ = msg.IsZoom();
+			button_ = hero_ = -1;
+			finished_ = false;
+			board_.clear();
+			currency_ = CurrencySymbol(msg.currency());
+			omaha_ = msg.IsOmaha() || msg.IsOmahaFive();
+			short_deck_ = msg.IsShortDeck();
+			straight_beats_trips_ = msg.IsStraightBeatsTrips();
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				names_[i].clear();
+				cards_[i].clear();
+				won_[i] = 0;
+				invested_[i] = 0;
+				start_stack_[i] = 0;
+				folded_on_[i] = -1;
+				blinds_[i] = 0;
+			}
+
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			for (size_t i = 0; i < seats.size(); ++i) {
+				int idx = seats[i].SeatIndex();
+				if (idx < 0 || idx >= H2N_MAX_SEATS)
+					continue;
+				names_[idx] = seats[i].Nickname();
+				cards_[idx] = seats[i].PoketCards();
+				start_stack_[idx] = seats[i].Stack();
+				if (seats[i].IsDealer())
+					button_ = idx;
+				if (seats[i].IsHero())
+					hero_ = idx;
+				blinds_[idx] = seats[i].IsPostedSmallBlind() ? SmallBlind : seats[i].IsPostedBigBlind() ? BigBlind : 0;
+			}
+
+			text_.clear();
+			text_ += "PokerStars Hand #";
+			Number(msg.GameId());
+			text_ += ": ";
+			text_ += msg.IsShortDeck() ? "6+ Hold'em" : msg.IsOmahaFive() ? "5 Card Omaha" : msg.IsOmaha() ? "Omaha" : "Hold'em";
+			text_ += msg.IsLimit() ? " Limit (" : msg.IsPotLimit() ? " Pot Limit (" : " No Limit (";
+			Amount(msg.SmallBlind());
+			text_ += '/';
+			Amount(msg.BigBlind());
+			if (*currency_.code) {
+				text_ += ' ';
+				text_ += currency_.code;
+			}
+			text_ += ") - ";
+			time_pos_ = text_.size();
+			text_ += "\nTable '";
+			text_ += msg.TableName();
+			text_ += "' ";
+			Number((uint64_t)msg.MaxPlayers());
+			text_ += "-max";
+			if (button_ >= 0) {
+				text_ += " Seat #";
+				Number((uint64_t)button_ + 1);
+				text_ += " is the button";
+			}
+			text_ += '\n';
+
+			const HandState& st = tracker_.State();
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (!(st.seated_mask >> i & 1))
+					continue;
+				text_ += "Seat ";
+				Number((uint64_t)i + 1);
+				text_ += ": ";
+				text_ += names_[i];
+				text_ += " (";
+				Amount(Stack(seats, i));
+				text_ += " in chips)\n";
+			}
+			for (size_t i = 0; i < seats.size(); ++i) {
+				const SeatInfo& s = seats[i];
+				if (s.SeatIndex() >= 0 && s.SeatIndex() < H2N_MAX_SEATS && msg.Ante() > 0 && !s.IsSittingOut())
+					Post(s, "posts the ante ", msg.Ante());
+			}
+			for (size_t i = 0; i < seats.size(); ++i) {
+				const SeatInfo& s = seats[i];
+				if (s.SeatIndex() < 0 || s.SeatIndex() >= H2N_MAX_SEATS || s.IsSittingOut())
+					continue;
+				if (s.IsPostedSmallBlind() || s.IsPostedSmallBlindOutOfQueue())
+					Post(s, "posts small blind ", msg.SmallBlind());
+				if (s.IsPostedBigBlind() || s.IsPostedBigBlindOutOfQueue())
+					Post(s, "posts big blind ", msg.BigBlind());
+				if (s.IsPostedStaddle())
+					Post(s, "posts straddle ", msg.Straddle());
+			}
+			text_ += "*** HOLE CARDS ***\n";
+			if (hero_ >= 0 && !cards_[hero_].empty()) {
+				text_ += "Dealt to ";
+				text_ += names_[hero_];
+				text_ += ' ';
+				Cards(cards_[hero_].data(), cards_[hero_].size());
+				text_ += '\n';
+			}
+			return result;
+		}
+
+		TrackResult Apply(HandActionMessage& msg) {
+			TrackResult result = Apply((const HandActionMessage&)msg);
+			if (result == TrackResult::Ok)
+				msg.Pot(tracker_.Pot());
+			return result;
+		}
+
+		TrackResult Apply(const HandActionMessage& msg) {
+			double to_call = tracker_.State().to_call;
+			TrackResult result = tracker_.Apply(msg);
+			if (result != TrackResult::Ok)
+				return result;
+			int seat = msg.SeatIndex();
+			text_ += names_[seat];
+			switch (msg.ActionType()) {
+			case Action::Fold:
+				text_ += ": folds\n";
+				folded_on_[seat] = tracker_.State().street;
+				return result;
+			case Action::Check:
+				text_ += ": checks\n";
+				return result;
+			case Action::Call:
+				text_ += ": calls ";
+				Amount(msg.Amount());
+				invested_[seat] += msg.Amount();
+				break;
+			case Action::Bet:
+				text_ += ": bets ";
+				Amount(msg.Amount());
+				invested_[seat] += msg.Amount();
+				break;
+			case Action::Raise:
+				text_ += ": raises ";
+				Amount(msg.Amount() - to_call);
+				text_ += " to ";
+				Amount(msg.Amount());
+				invested_[seat] += msg.Amount();
+				break;
+			default:
+				break;
+			}
+			if (tracker_.State().allin_mask >> seat & 1)
+				text_ += " and is all-in";
+			text_ += '\n';
+			return result;
+		}
+
+		TrackResult Apply(HandStreetMessage& msg) {
+			TrackResult result = Apply((const HandStreetMessage&)msg);
+			if (result == TrackResult::Ok)
+				msg.Pot(tracker_.State().pot);
+			return result;
+		}
+
+		TrackResult Apply(const HandStreetMessage& msg) {
+			TrackResult result = tracker_.Apply(msg);
+			if (result != TrackResult::Ok)
+				return result;
+			const std::string& board = msg.Board();
+			text_ += msg.StreetType() == Street::Flop ? "*** FLOP *** " : msg.StreetType() == Street::Turn ? "*** TURN *** " : "*** RIVER *** ";
+			if (board.size() > 6) {
+				Cards(board.data(), board.size() - 2);
+				text_ += ' ';
+				Cards(board.data() + board.size() - 2, 2);
+			}
+			else
+				Cards(board.data(), board.size());
+			text_ += '\n';
+			board_ = board;
+			return result;
+		}
+
+		// Pot share won by seat at showdown
+		void Win(int seat, double amount) {
+			if (seat >= 0 && seat < H2N_MAX_SEATS)
+				won_[seat] += amount;
+		}
+
+		// Completes the hand history, time is the hand start time (UTC).
+		// The returned text stays valid until the next Start.
+		const std::string& Render(std::time_t time) {
+			if (!finished_)
+				Finish();
+			char ts[32];
+			std::tm tm;
+#ifdef _MSC_VER
+			gmtime_s(&tm, &time);
+#else
+			gmtime_r(&time, &tm);
+#endif
+			strftime(ts, sizeof(ts), "%Y/%m/%d %H:%M:%S UTC", &tm);
+			text_.replace(time_pos_, time_len_, ts);
+			time_len_ = strlen(ts);
+			return text_;
+		}
+
+		// Fills msg with the rendered hand history ready for Protocol::SendHandHistory
+		void Finish(HandHistoryMessage& msg, std::time_t time) {
+			Render(time);
+			msg.room(room_);
+			msg.GameId(tracker_.GameId());
+			msg.SetZoom(zoom_);
+			msg.Format(HandHistoryFormat::PokerStars);
+			msg.FormattedHandHistory(text_);
+		}
+
+	private:
+		enum { SmallBlind = 1, BigBlind = 2 };
+
+		struct CurrencyInfo {
+			const char* symbol;
+			const char* code;
+		};
+
+		HandTracker  tracker_;
+		std::string  text_;
+		std::string  names_[H2N_MAX_SEATS];
+		std::string  cards_[H2N_MAX_SEATS];
+		std::string  board_;
+		double       won_[H2N_MAX_SEATS];
+		double       invested_[H2N_MAX_SEATS];
+		double       start_stack_[H2N_MAX_SEATS];
+		int          folded_on_[H2N_MAX_SEATS];
+		int          blinds_[H2N_MAX_SEATS];
+		CurrencyInfo currency_;
+		Room         room_;
+		int          button_;
+		int          hero_;
+		bool         zoom_;
+		bool         finished_;
+		bool         omaha_;
+		bool         short_deck_;
+		bool         straight_beats_trips_;
+		size_t       time_pos_;
+		size_t       time_len_;
+
+		static CurrencyInfo CurrencySymbol(Currency c) {
+			switch (c) {
+			case Currency::Dollar: return { "$", "USD" };
+			case Currency::Euro: return { u8"€", "EUR" };
+			case Currency::Pounds: return { u8"£", "GBP" };
+			case Currency::Yuan: return { u8"¥", "CNY" };
+			default: return { "", "" };
+			}
+		}
+
+		static double Stack(const HandStartMessage::SeatsList& seats, int idx) {
+			for (size_t i = 0; i < seats.size(); ++i) {
+				if (seats[i].SeatIndex() == idx)
+					return seats[i].Stack();
+			}
+			return 0;
+		}
+
+		void Post(const SeatInfo& s, const char* what, double amount) {
+			text_ += s.Nickname();
+			text_ += ": ";
+			text_ += what;
+			Amount(amount);
+			text_ += '\n';
+		}
+
+		void Number(uint64_t v) {
+			char tmp[20];
+			char* end = tmp + sizeof(tmp);
+			char* p = end;
+			do {
+				*--p = (char)('0' + v % 10);
+				v /= 10;
+			} while (v);
+			text_.append(p, end - p);
+		}
+
+		// $1, $0.50, $2.66 like PokerStars does
+		void Amount(double v) {
+			text_ += currency_.symbol;
+			int64_t cents;
+			if (!detail::ToCents(v, cents)) {
+				char tmp[32];
+				snprintf(tmp, sizeof(tmp), "%.2f", v);
+				text_ += tmp;
+				return;
+			}
+			if (cents < 0) {
+				text_ += '-';
+				cents = -cents;
+			}
+			Number((uint64_t)cents / 100);
+			if (cents % 100) {
+				char frac[3] = { '.', (char)('0' + cents % 100 / 10), (char)('0' + cents % 10) };
+				text_.append(frac, 3);
+			}
+		}
+
+		// "5h8s7s" -> "[5h 8s 7s]"
+		void Cards(const char* cards, size_t n) {
+			text_ += '[';
+			for (size_t i = 0; i + 1 < n; i += 2) {
+				if (i)
+					text_ += ' ';
+				text_.append(cards + i, 2);
+			}
+			text_ += ']';
+		}
+
+		static const char* StreetName(int street) {
+			return street <= H2N_STREET_FLOP ? "Flop" : street == H2N_STREET_TURN ? "Turn" : "River";
+		}
+
+		// Showdown without Win calls, when the river is out and all cards are known: the main pot goes
+		// to the best hands of the active seats, every side pot to the best hands of the seats that paid
+		// into all of it. A pot stops at the chips the next all-in seat put in.
+		void SplitPot(double pot, int top, double uncalled) {
+			const HandState& st = tracker_.State();
+			int64_t cents;
+			if (Hand2Note::Cards::Size(st.board) != 5 || !detail::ToCents(pot, cents))
+				return;
+			HandValue values[H2N_MAX_SEATS] = {};
+			int64_t paid[H2N_MAX_SEATS] = {};
+			int64_t total = 0;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (!(st.seated_mask >> i & 1))
+					continue;
+				if (!detail::ToCents(start_stack_[i] - st.stack[i] - (i == top ? uncalled : 0), paid[i]))
+					return;
+				total += paid[i];
+				if (!(st.active_mask >> i & 1))
+					continue;
+				CardMask pocket;
+				if (cards_[i].empty() || Hand2Note::Cards::Parse(cards_[i], pocket) != CardsResult::Ok)
+					return;
+				values[i] = omaha_ ? Evaluator::EvalOmaha(pocket, st.board)
+					: short_deck_ ? Evaluator::EvalShortDeck(pocket | st.board, straight_beats_trips_)
+					: Evaluator::Eval(pocket | st.board);
+			}
+			// the stacks don't add up to the pot, e.g. a seat listed twice
+			if (total != cents)
+				return;
+			for (int64_t level = 0;;) {
+				int64_t next = INT64_MAX;
+				for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+					if ((st.active_mask >> i & 1) && paid[i] > level && paid[i] < next)
+						next = paid[i];
+				}
+				if (next == INT64_MAX)
+					return;
+				uint32_t eligible = 0;
+				bool above = false;
+				for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+					if ((st.active_mask >> i & 1) && paid[i] >= next) {
+						eligible |= 1u << i;
+						above |= paid[i] > next;
+					}
+				}
+				// the last pot also takes what folded seats put in above the last active one
+				int64_t amount = 0;
+				for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+					const int64_t upto = above && paid[i] > next ? next : paid[i];
+					if (upto > level)
+						amount += upto - level;
+				}
+				Award(amount, eligible, values);
+				level = next;
+			}
+		}
+
+		// Splits cents among the best hands of the eligible seats, odd cents go to the first seats
+		void Award(int64_t cents, uint32_t eligible, const HandValue* values) {
+			HandValue best = 0;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if ((eligible >> i & 1) && values[i] > best)
+					best = values[i];
+			}
+			uint32_t winners = 0;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i)
+				winners |= (uint32_t)((eligible >> i & 1) && values[i] == best) << i;
+			const unsigned count = detail::PopCount(winners);
+			if (!count)
+				return;
+			int64_t share = cents / count, odd = cents % count;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (winners >> i & 1)
+					won_[i] += (double)(share + (odd-- > 0 ? 1 : 0)) / 100;
+			}
+		}
+
+		void Finish() {
+			finished_ = true;
+			time_len_ = 0;
+			const HandState& st = tracker_.State();
+
+			// the part of the largest bet nobody matched goes back
+			int top = -1;
+			double second = 0;
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (top < 0 || st.committed[i] > st.committed[top]) {
+					if (top >= 0 && st.committed[top] > second)
+						second = st.committed[top];
+					top = i;
+				}
+				else if (st.committed[i] > second)
+					second = st.committed[i];
+			}
+			double pot = tracker_.Pot();
+			double uncalled = 0;
+			if (top >= 0 && st.committed[top] > second) {
+				uncalled = st.committed[top] - second;
+				text_ += "Uncalled bet (";
+				Amount(uncalled);
+				text_ += ") returned to ";
+				text_ += names_[top];
+				text_ += '\n';
+				pot -= uncalled;
+			}
+
+			bool showdown = detail::PopCount(st.active_mask) > 1;
+			if (!showdown) {
+				for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+					if (st.active_mask >> i & 1)
+						won_[i] = pot;
+				}
+			}
+			else {
+				bool decided = false;
+				for (int i = 0; i < H2N_MAX_SEATS; ++i)
+					decided |= won_[i] > 0;
+				if (!decided)
+					SplitPot(pot, top, uncalled);
+				text_ += "*** SHOW DOWN ***\n";
+				for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+					if (!(st.active_mask >> i & 1) || cards_[i].empty())
+						continue;
+					text_ += names_[i];
+					text_ += ": shows ";
+					Cards(cards_[i].data(), cards_[i].size());
+					text_ += '\n';
+				}
+			}
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (won_[i] <= 0)
+					continue;
+				text_ += names_[i];
+				text_ += " collected ";
+				Amount(won_[i]);
+				text_ += " from pot\n";
+			}
+
+			text_ += "*** SUMMARY ***\nTotal pot ";
+			Amount(pot);
+			text_ += " | Rake ";
+			Amount(0);
+			text_ += '\n';
+			if (!board_.empty()) {
+				text_ += "Board ";
+				Cards(board_.data(), board_.size());
+				text_ += '\n';
+			}
+			for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+				if (!(st.seated_mask >> i & 1))
+					continue;
+				text_ += "Seat ";
+				Number((uint64_t)i + 1);
+				text_ += ": ";
+				text_ += names_[i];
+				if (i == button_)
+					text_ += " (button)";
+				if (blinds_[i] == SmallBlind)
+					text_ += " (small blind)";
+				else if (blinds_[i] == BigBlind)
+					text_ += " (big blind)";
+				if (folded_on_[i] >= 0) {
+					text_ += folded_on_[i] == H2N_STREET_PREFLOP ? " folded before " : " folded on the ";
+					text_ += StreetName(folded_on_[i]);
+					if (folded_on_[i] == H2N_STREET_PREFLOP && invested_[i] <= 0 && !blinds_[i])
+						text_ += " (didn't bet)";
+				}
+				else if (showdown && !cards_[i].empty()) {
+					text_ += " showed ";
+					Cards(cards_[i].data(), cards_[i].size());
+					if (won_[i] > 0) {
+						text_ += " and won (";
+						Amount(won_[i]);
+						text_ += ')';
+					}
+					else
+						text_ += " and lost";
+				}
+				else if (showdown && won_[i] <= 0)
+					text_ += " mucked";
+				else if (won_[i] > 0) {
+					text_ += " collected (";
+					Amount(won_[i]);
+					text_ += ')';
+				}
+				text_ += '\n';
+			}
+		}
+	};
+
+	namespace detail {
+		// Open addressing index of uint64_t keys to uint32_t values in groups of 16 slots.
+		// Every slot has a control byte: the 7 low bits of the hash when full, Empty or Deleted.
+		// A lookup compares the 16 control bytes of a group at once and checks only the matching keys.
+		//
+		// The slots are sized for a load of at most 3/8, so that almost every key is found in its first
+		// group and the deleted slots left by erased keys are dropped rarely (at 3/4 of the slots).
+		class IdIndex {
+		public:
+			enum : uint8_t { Empty = 0x80, Deleted = 0xFE };
+			enum { GroupSize = 16 };
+
+			explicit IdIndex(size_t capacity) : capacity_(capacity) {
+				size_t groups = 1;
+				while (groups * GroupSize * 3 / 8 < capacity)
+					groups *= 2;
+				mask_ = groups - 1;
+				ctrl_.resize(groups * GroupSize);
+				keys_.resize(groups * GroupSize);
+				values_.resize(groups * GroupSize);
+				scratch_.reserve(capacity);
+				Clear();
+			}
+
+			size_t Size() const { return size_; }
+			size_t Capacity() const { return capacity_; }
+
+			void Clear() {
+				memset(ctrl_.data(), Empty, ctrl_.size());
+				size_ = 0;
+				growth_left_ = ctrl_.size() * 3 / 4;
+			}
+
+			const uint32_t* Find(uint64_t key) const {
+				uint64_t h = Hash(key);
+				for (size_t g = h >> 7 & mask_, i = 1;; g = (g + i++) & mask_) {
+					const uint8_t* ctrl = &ctrl_[g * GroupSize];
+					for (uint32_t m = Match(ctrl, (uint8_t)(h & 0x7F)); m; m &= m - 1) {
+						size_t slot = g * GroupSize + CountTrailingZeros(m);
+						if (keys_[slot] == key)
+							return &values_[slot];
+					}
+					if (Match(ctrl, Empty) || i > mask_)
+						return nullptr;
+				}
+			}
+
+			uint32_t* Find(uint64_t key) {
+				return const_cast<uint32_t*>(static_cast<const IdIndex*>(this)->Find(key));
+			}
+
+			// Returns the value of key, inserting value when the key is new (inserted is set then).
+			// nullptr when the index is full.
+			uint32_t* FindOrInsert(uint64_t key, uint32_t value, bool& inserted) {
+				inserted = false;
+				uint64_t h = Hash(key);
+				size_t target = SIZE_MAX;
+				for (size_t g = h >> 7 & mask_, i = 1;; g = (g + i++) & mask_) {
+					const uint8_t* ctrl = &ctrl_[g * GroupSize];
+					for (uint32_t m = Match(ctrl, (uint8_t)(h & 0x7F)); m; m &= m - 1) {
+						size_t slot = g * GroupSize + CountTrailingZeros(m);
+						if (keys_[slot] == key)
+							return &values_[slot];
+					}
+					uint32_t free = MatchFree(ctrl);
+					if (free && target == SIZE_MAX)
+						target = g * GroupSize + CountTrailingZeros(free);
+					if (Match(ctrl, Empty) || i > mask_)
+						break;
+				}
+				if (size_ >= capacity_)
+					return nullptr;
+				if (ctrl_[target] == Empty) {
+					if (growth_left_ == 0) {
+						Rehash();
+						return FindOrInsert(key, value, inserted);
+					}
+					--growth_left_;
+				}
+				ctrl_[target] = (uint8_t)(h & 0x7F);
+				keys_[target] = key;
+				values_[target] = value;
+				++size_;
+				inserted = true;
+				return &values_[target];
+			}
+
+			// Adds the key or updates its value, returns false when the index is full
+			bool Insert(uint64_t key, uint32_t value) {
+				bool inserted;
+				uint32_t* v = FindOrInsert(key, value, inserted);
+				if (v)
+					*v = value;
+				return v != nullptr;
+			}
+
+			bool Erase(uint64_t key) {
+				uint32_t* v = Find(key);
+				if (!v)
+					return false;
+				size_t slot = v - values_.data();
+				// a group with an empty slot never overflowed, so no probe sequence continues past it
+				uint8_t* ctrl = &ctrl_[slot & ~(size_t)(GroupSize - 1)];
+				if (Match(ctrl, Empty)) {
+					ctrl_[slot] = Empty;
+					++growth_left_;
+				}
+				else
+					ctrl_[slot] = Deleted;
+				--size_;
+				return true;
+			}
+
+		private:
+			std::vector<uint8_t>  ctrl_;
+			std::vector<uint64_t> keys_;
+			std::vector<uint32_t> values_;
+			std::vector<std::pair<uint64_t, uint32_t>> scratch_;
+			size_t capacity_;
+			size_t mask_;
+			size_t size_;
+			size_t growth_left_;
+
+			static uint64_t Hash(uint64_t key) {
+				// gameids are often sequential, the high half of the product spreads them over the groups
+				key *= 0x9E3779B97F4A7C15ull;
+				return key ^ (key >> 32);
+			}
+
+			static uint32_t Match(const uint8_t* ctrl, uint8_t tag) {
+#ifdef H2NAPI_SSE2
+				__m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+				return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+				uint32_t m = 0;
+				for (int i = 0; i < GroupSize; ++i)
+					m |= (uint32_t)(ctrl[i] == tag) << i;
+				return m;
+#endif
+			}
+
+			// Empty or Deleted, i.e. the high bit is set
+			static uint32_t MatchFree(const uint8_t* ctrl) {
+#ifdef H2NAPI_SSE2
+				return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+				uint32_t m = 0;
+				for (int i = 0; i < GroupSize; ++i)
+					m |= (uint32_t)(ctrl[i] >> 7) << i;
+				return m;
+#endif
+			}
+
+			// drops the deleted slots once they used up the free ones, no allocation
+			void Rehash() {
+				scratch_.clear();
+				for (size_t i = 0; i < ctrl_.size(); ++i) {
+					if (!(ctrl_[i] & 0x80))
+						scratch_.emplace_back(keys_[i], values_[i]);
+				}
+				Clear();
+				for (size_t i = 0; i < scratch_.size(); ++i)
+					Insert(scratch_[i].first, scratch_[i].second);
+			}
+		};
+	}
+
+	// Fixed capacity map of live hands by gameid, e.g. HandTracker or HandHistoryComposer per hand.
+	//
+	// Insert takes the table of the hand (hwnd or any other table id): the previous hand
+	// of the same table is over once a new one starts there and is evicted.
+	// Nothing is allocated after construction, a new hand reuses the value object of an
+	// evicted or erased one as is, so the caller reinitializes it (HandTracker::Start).
+	template<class T>
+	class HandMap {
+	public:
+		explicit HandMap(size_t capacity = 1024) :
+			games_(capacity), tables_(capacity), entries_(capacity), evicted_(0)
+		{
+			Clear();
+		}
+
+		size_t Size() const { return games_.Size(); }
+		size_t Capacity() const { return entries_.size(); }
+		// Hands evicted by a new hand on their table
+		size_t Evicted() const { return evicted_; }
+
+		T* Find(uint64_t game_id) {
+			const uint32_t* slot = games_.Find(game_id);
+			return slot ? &entries_[*slot].value : nullptr;
+		}
+
+		const T* Find(uint64_t game_id) const {
+			const uint32_t* slot = games_.Find(game_id);
+			return slot ? &entries_[*slot].value : nullptr;
+		}
+
+		// Returns the value of game_id, adding it when it is new; nullptr when the map is full
+		T* Insert(uint64_t game_id, uint64_t table) {
+			bool inserted;
+			if (const uint32_t* table_slot = tables_.Find(table)) {
+				// the new hand takes over the entry of the previous hand on the table
+				uint32_t idx = *table_slot;
+				Entry& entry = entries_[idx];
+				if (entry.game_id == game_id)
+					return &entry.value;
+				games_.Erase(entry.game_id);
+				++evicted_;
+				uint32_t* slot = games_.FindOrInsert(game_id, idx, inserted);
+				if (!inserted) {
+					// the hand is already known on another table
+					tables_.Erase(table);
+					free_.push_back(idx);
+					return &entries_[*slot].value;
+				}
+				entry.game_id = game_id;
+				return &entry.value;
+			}
+			if (free_.empty()) {
+				const uint32_t* slot = games_.Find(game_id);
+				return slot ? &entries_[*slot].value : nullptr;
+			}
+			uint32_t idx = free_.back();
+			uint32_t* slot = games_.FindOrInsert(game_id, idx, inserted);
+			if (!inserted)
+				return &entries_[*slot].value;
+			free_.pop_back();
+			tables_.Insert(table, idx);
+			entries_[idx].game_id = game_id;
+			entries_[idx].table = table;
+			return &entries_[idx].value;
+		}
+
+		bool Erase(uint64_t game_id) {
+			const uint32_t* slot = games_.Find(game_id);
+			if (!slot)
+				return false;
+			uint32_t idx = *slot;
+			games_.Erase(game_id);
+			tables_.Erase(entries_[idx].table);
+			free_.push_back(idx);
+			return true;
+		}
+
+		void Clear() {
+			games_.Clear();
+			tables_.Clear();
+			free_.clear();
+			free_.reserve(entries_.size());
+			for (size_t i = entries_.size(); i-- > 0; )
+				free_.push_back((uint32_t)i);
+		}
+
+	private:
+		struct Entry {
+			uint64_t game_id;
+			uint64_t table;
+			T        value;
+		};
+
+		detail::IdIndex       games_;
+		detail::IdIndex       tables_;
+		std::vector<Entry>    entries_;
+		std::vector<uint32_t> free_;
+		size_t                evicted_;
+	};
+
+
+	// Serializes messages into JSON for h2n_send_json. The buffer is reused between messages,
+	// so a long living writer does not allocate once it has grown to the largest message.
+	// Keys are the field names of the corresponding h2n_* C structs, "msg" holds the message kind.
+	class JsonWriter {
+	public:
+		JsonWriter() : len_(0) { buf_.resize(1024); buf_[0] = 0; }
+
+		const char* c_str() const { return buf_.data(); }
+		size_t size() const { return len_; }
+		std::string str() const { return std::string(buf_.data(), len_); }
+
+		void Clear() { len_ = 0; buf_[0] = 0; }
+
+		JsonWriter& Write(const HandHistoryMessage& msg) {
+			Clear();
+			Raw("{\"msg\":\"handhistory\",\"room\":");
+			Int((int)msg.room());
+			Raw(",\"is_zoom\":");
+			Int(msg.IsZoom() ? 1 : 0);
+			Raw(",\"gameid\":");
+			UInt(msg.GameId());
+			Raw(",\"format\":");
+			Int((int)msg.Format());
+			Raw(",\"hh_formatted\":");
+			String(msg.FormattedHandHistory());
+			Raw(",\"hh_original\":");
+			String(msg.OriginalHandHistory());
+			Raw("}");
+			return *this;
+		}
+
+		JsonWriter& Write(const HandStartMessage& msg) {
+			Clear();
+			Raw("{\"msg\":\"hand_start\",\"room\":");
+			Int((int)msg.room());
+			Raw(",\"gameid\":");
+			UInt(msg.GameId());
+			Raw(",\"table_name\":");
+			String(msg.TableName());
+			Raw(",\"table_hwnd\":");
+			Int(msg.TableHwnd());
+			Raw(",\"max_players\":");
+			Int(msg.MaxPlayers());
+			Raw(",\"is_tourney\":");
+			Int(msg.IsTourney() ? 1 : 0);
+			Raw(",\"is_omaha\":");
+			Int(msg.IsOmaha() ? 1 : 0);
+			Raw(",\"is_limit\":");
+			Int(msg.IsLimit() ? 1 : 0);
+			Raw(",\"is_zoom\":");
+			Int(msg.IsZoom() ? 1 : 0);
+			Raw(",\"is_cap\":");
+			Int(msg.IsCap() ? 1 : 0);
+			Raw(",\"is_potlimit\":");
+			Int(msg.IsPotLimit() ? 1 : 0);
+			Raw(",\"is_shortdeck\":");
+			Int(msg.IsShortDeck() ? 1 : 0);
+			Raw(",\"is_omahafive\":");
+			Int(msg.IsOmahaFive() ? 1 : 0);
+			Raw(",\"is_straightbeatstrips\":");
+			Int(msg.IsStraightBeatsTrips() ? 1 : 0);
+			Raw(",\"currency\":");
+			Int((int)msg.currency());
+			Raw(",\"sb\":");
+			Double(msg.SmallBlind());
+			Raw(",\"bb\":");
+			Double(msg.BigBlind());
+			Raw(",\"ante\":");
+			Double(msg.Ante());
+			Raw(",\"straddle\":");
+			Double(msg.Straddle());
+			Raw(",\"seats\":[");
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			for (size_t i = 0; i < seats.size(); ++i) {
+				if (i)
+					Raw(",");
+				Write(seats[i]);
+			}
+			Raw("]}");
+			return *this;
+		}
+
+		JsonWriter& Write(const HandActionMessage& msg) {
+			Clear();
+			Raw("{\"msg\":\"action\",\"gameid\":");
+			UInt(msg.GameId());
+			Raw(",\"seat_idx\":");
+			Int(msg.SeatIndex());
+			Raw(",\"type\":");
+			Int((int)msg.ActionType());
+			Raw(",\"amount\":");
+			Double(msg.Amount());
+			Raw(",\"is_allin\":");
+			Int(msg.IsAllin() ? 1 : 0);
+			Raw(",\"pot\":");
+			Double(msg.Pot());
+			Raw("}");
+			return *this;
+		}
+
+		JsonWriter& Write(const HandStreetMessage& msg) {
+			Clear();
+			Raw("{\"msg\":\"street\",\"gameid\":");
+			UInt(msg.GameId());
+			Raw(",\"type\":");
+			Int((int)msg.StreetType());
+			Raw(",\"board\":");
+			String(msg.Board());
+			Raw(",\"pot\":");
+			Double(msg.Pot());
+			Raw("}");
+			return *this;
+		}
+
+		// Shortest decimal representation that parses back to exactly the same double.
+		// Amounts with at most two decimals (the usual case for stacks and pots) avoid printf entirely.
+		void Double(double v) {
+			if (!std::isfinite(v)) {
+				Raw("null");
+				return;
+			}
+			int64_t cents;
+			if (detail::ToCents(v, cents)) {
+				if (cents < 0) {
+					Raw("-");
+					cents = -cents;
+				}
+				UInt((uint64_t)cents / 100);
+				unsigned frac = (unsigned)(cents % 100);
+				if (frac) {
+					Reserve(3);
+					char* p = &buf_[len_];
+					*p++ = '.';
+					*p++ = (char)('0' + frac / 10);
+					if (frac % 10)
+						*p++ = (char)('0' + frac % 10);
+					*p = 0;
+					len_ = p - buf_.data();
+				}
+				return;
+			}
+			char tmp[32];
+			for (int precision = 15; precision <= 17; ++precision) {
+				snprintf(tmp, sizeof(tmp), "%.*g", precision, v);
+				if (strtod(tmp, nullptr) == v)
+					break;
+			}
+			for (char* c = tmp; *c; ++c) {
+				if (*c == ',')
+					*c = '.';
+			}
+			Raw(tmp);
+		}
+
+		void Int(int v) {
+			if (v < 0) {
+				Raw("-");
+				UInt(0 - (uint64_t)(int64_t)v);
+			}
+			else
+				UInt((uint64_t)v);
+		}
+
+		void UInt(uint64_t v) {
+			char tmp[20];
+			char* end = tmp + sizeof(tmp);
+			char* p = end;
+			do {
+				*--p = (char)('0' + v % 10);
+				v /= 10;
+			} while (v);
+			Append(p, end - p);
+		}
+
+		// Quoted and escaped UTF-8 string. Multibyte sequences are copied as is,
+		// only '"', '\\' and control characters are escaped.
+		void String(const std::string& s) {
+			const unsigned char* p = (const unsigned char*)s.data();
+			const unsigned char* end = p + s.size();
+			Reserve(s.size() * 6 + 2);
+			char* out = &buf_[len_];
+			*out++ = '"';
+#ifdef H2NAPI_SSE2
+			const __m128i quote = _mm_set1_epi8('"');
+			const __m128i backslash = _mm_set1_epi8('\\');
+			const __m128i ctrl = _mm_set1_epi8(0x1F);
+			while (end - p >= 16) {
+				__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+				__m128i special = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+					_mm_cmpeq_epi8(_mm_max_epu8(chunk, ctrl), ctrl));
+				uint32_t mask = (uint32_t)_mm_movemask_epi8(special);
+				_mm_storeu_si128((__m128i*)out, chunk);
+				if (!mask) {
+					p += 16;
+					out += 16;
+					continue;
+				}
+				unsigned n = detail::CountTrailingZeros(mask);
+				p += n;
+				out += n;
+				out = Escape(out, *p++);
+			}
+#endif
+			for (; p != end; ++p) {
+				unsigned char c = *p;
+				if (c == '"' || c == '\\' || c < 0x20)
+					out = Escape(out, c);
+				else
+					*out++ = (char)c;
+			}
+			*out++ = '"';
+			*out = 0;
+			len_ = out - buf_.data();
+		}
+
+		void Raw(const char* s) { Append(s, strlen(s)); }
+
+	private:
+		std::vector<char> buf_;
+		size_t len_;
+
+		void Write(const SeatInfo& s) {
+			Raw("{\"seat_idx\":");
+			Int(s.SeatIndex());
+			Raw(",\"nickname\":");
+			String(s.Nickname());
+			Raw(",\"player_id\":");
+			if (const std::string* text = s.PlayerIdText())
+				String(*text);
+			else {
+				Raw("\"");
+				UInt(s.PlayerId());
+				Raw("\"");
+			}
+			Raw(",\"stack\":");
+			Double(s.Stack());
+			Raw(",\"pocket_cards\":");
+			String(s.PoketCards());
+			Raw(",\"is_dealer\":");
+			Int(s.IsDealer() ? 1 : 0);
+			Raw(",\"is_posted_sb\":");
+			Int(s.IsPostedSmallBlind() ? 1 : 0);
+			Raw(",\"is_posted_bb\":");
+			Int(s.IsPostedBigBlind() ? 1 : 0);
+			Raw(",\"is_posted_sb_outofqueue\":");
+			Int(s.IsPostedSmallBlindOutOfQueue() ? 1 : 0);
+			Raw(",\"is_posted_bb_outofqueue\":");
+			Int(s.IsPostedBigBlindOutOfQueue() ? 1 : 0);
+			Raw(",\"is_posted_straddle\":");
+			Int(s.IsPostedStaddle() ? 1 : 0);
+			Raw(",\"is_hero\":");
+			Int(s.IsHero() ? 1 : 0);
+			Raw(",\"is_sitting_out\":");
+			Int(s.IsSittingOut() ? 1 : 0);
+			Raw("}");
+		}
+
+		static char* Escape(char* out, unsigned char c) {
+			static const char hex[] = "0123456789abcdef";
+			*out++ = '\\';
+			switch (c) {
+			case '"': *out++ = '"'; break;
+			case '\\': *out++ = '\\'; break;
+			case '\b': *out++ = 'b'; break;
+			case '\f': *out++ = 'f'; break;
+			case '\n': *out++ = 'n'; break;
+			case '\r': *out++ = 'r'; break;
+			case '\t': *out++ = 't'; break;
+			default:
+				*out++ = 'u';
+				*out++ = '0';
+				*out++ = '0';
+				*out++ = hex[c >> 4];
+				*out++ = hex[c & 0xF];
+			}
+			return out;
+		}
+
+		void Reserve(size_t n) {
+			// keeps room for the 16 byte simd stores and the terminating zero
+			size_t need = len_ + n + 17;
+			if (need > buf_.size())
+				buf_.resize(need > buf_.size() * 2 ? need : buf_.size() * 2);
+		}
+
+		void Append(const char* s, size_t n) {
+			Reserve(n);
+			memcpy(&buf_[len_], s, n);
+			len_ += n;
+			buf_[len_] = 0;
+		}
+	};
+
+
+	// Compact tagged binary encoding of the messages, an alternative to the fixed h2n_* structs.
+	//
+	// A frame is [version byte][varint message type][varint body length][body].
+	// The body is a sequence of fields, each prefixed with varint (field id << 3 | wire type).
+	// Fields holding zero, false or an empty string are omitted, seats are written only
+	// for the seats actually present. Readers skip fields with unknown ids, so new fields
+	// can be added without breaking old consumers as long as existing ids are never reused.
+	enum class WireMessage : int
+	{
+		HandHistory = 1,
+		HandStart = 2,
+		Action = 3,
+		Street = 4,
+		Json = 5,
+		Command = 6,
+	};
+
+	namespace detail {
+		enum WireType {
+			WireVarint = 0,
+			WireFixed64 = 1,
+			WireBytes = 2,
+			WireCents = 3, // zigzag varint of amount * 100, used for doubles with at most two decimals
+		};
+
+		const uint8_t WireVersion = 1;
+
+		inline uint64_t ZigZag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+		inline int64_t UnZigZag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+	}
+
+	class WireWriter {
+	public:
+		WireWriter() : buf_(nullptr), cap_(0), len_(0) { Grow(256); }
+
+		// Encodes into [data, data + capacity) without allocating. Frames that don't fit move to
+		// a buffer of the writer: data() != the given pointer tells they did, MaxSize of the
+		// messages is enough to never spill.
+		WireWriter(uint8_t* data, size_t capacity) : buf_(data), cap_(capacity), len_(0) {}
+
+		WireWriter(const WireWriter&) = delete;
+		WireWriter& operator=(const WireWriter&) = delete;
+
+		const uint8_t* data() const { return buf_; }
+		size_t size() const { return len_; }
+
+		void Clear() { len_ = 0; }
+
+		// Write replaces the buffer content with a single frame, Append adds a frame to the end
+		template<class Message>
+		WireWriter& Write(const Message& msg) {
+			Clear();
+			return Append(msg);
+		}
+
+		WireWriter& Append(const HandHistoryMessage& msg) {
+			size_t frame = BeginFrame(WireMessage::HandHistory);
+			Int(1, (int)msg.room());
+			Bool(2, msg.IsZoom());
+			UInt(3, msg.GameId());
+			Int(4, (int)msg.Format());
+			String(5, msg.FormattedHandHistory());
+			String(6, msg.OriginalHandHistory());
+			EndLength(frame);
+			return *this;
+		}
+
+		WireWriter& Append(const HandStartMessage& msg) {
+			size_t frame = BeginFrame(WireMessage::HandStart);
+			Int(1, (int)msg.room());
+			UInt(2, msg.GameId());
+			String(3, msg.TableName());
+			Int(4, msg.TableHwnd());
+			Int(5, msg.MaxPlayers());
+			Bool(6, msg.IsTourney());
+			Bool(7, msg.IsOmaha());
+			Bool(8, msg.IsLimit());
+			Bool(9, msg.IsZoom());
+			Bool(10, msg.IsCap());
+			Bool(11, msg.IsPotLimit());
+			Bool(12, msg.IsShortDeck());
+			Bool(13, msg.IsOmahaFive());
+			Bool(14, msg.IsStraightBeatsTrips());
+			Int(15, (int)msg.currency());
+			Double(16, msg.SmallBlind());
+			Double(17, msg.BigBlind());
+			Double(18, msg.Ante());
+			Double(19, msg.Straddle());
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			for (size_t i = 0; i < seats.size(); ++i) {
+				const SeatInfo& s = seats[i];
+				Tag(20, detail::WireBytes);
+				size_t seat = BeginLength();
+				Int(1, s.SeatIndex());
+				String(2, s.Nickname());
+				PlayerId(s);
+				Double(4, s.Stack());
+				String(5, s.PoketCards());
+				Bool(6, s.IsDealer());
+				Bool(7, s.IsPostedSmallBlind());
+				Bool(8, s.IsPostedBigBlind());
+				Bool(9, s.IsPostedSmallBlindOutOfQueue());
+				Bool(10, s.IsPostedBigBlindOutOfQueue());
+				Bool(11, s.IsPostedStaddle());
+				Bool(12, s.IsHero());
+				Bool(13, s.IsSittingOut());
+				EndLength(seat);
+			}
+			EndLength(frame);
+			return *this;
+		}
+
+		WireWriter& Append(const HandActionMessage& msg) {
+			size_t frame = BeginFrame(WireMessage::Action);
+			UInt(1, msg.GameId());
+			Int(2, msg.SeatIndex());
+			Int(3, (int)msg.ActionType());
+			Double(4, msg.Amount());
+			Bool(5, msg.IsAllin());
+			Double(6, msg.Pot());
+			EndLength(frame);
+			return *this;
+		}
+
+		WireWriter& Append(const HandStreetMessage& msg) {
+			size_t frame = BeginFrame(WireMessage::Street);
+			UInt(1, msg.GameId());
+			Int(2, (int)msg.StreetType());
+			String(3, msg.Board());
+			Double(4, msg.Pot());
+			EndLength(frame);
+			return *this;
+		}
+
+		// h2n_send_json payload
+		WireWriter& AppendJson(const char* json) {
+			size_t frame = BeginFrame(WireMessage::Json);
+			String(1, json, strlen(json));
+			EndLength(frame);
+			return *this;
+		}
+
+		// h2n_send_command arguments
+		WireWriter& AppendCommand(int table_hwnd, int room, int cmd) {
+			size_t frame = BeginFrame(WireMessage::Command);
+			Int(1, table_hwnd);
+			Int(2, room);
+			Int(3, cmd);
+			EndLength(frame);
+			return *this;
+		}
+
+		// The h2n_* structs of the C functions, framed with the same fields as the message classes
+		WireWriter& Append(const h2n_hh_message& msg) {
+			size_t frame = BeginFrame(WireMessage::HandHistory);
+			Int(1, msg.room);
+			Bool(2, msg.is_zoom != 0);
+			UInt(3, (uint64_t)msg.gameid);
+			Int(4, msg.format);
+			CString(5, msg.hh_formatted);
+			CString(6, msg.hh_original);
+			EndLength(frame);
+			return *this;
+		}
+
+		WireWriter& Append(const h2n_start_hand_message& msg) {
+			size_t frame = BeginFrame(WireMessage::HandStart);
+			Int(1, msg.room);
+			UInt(2, (uint64_t)msg.gameid);
+			CString(3, msg.table_name);
+			Int(4, msg.table_hwnd);
+			Int(5, msg.max_players);
+			Bool(6, msg.is_tourney != 0);
+			Bool(7, msg.is_omaha != 0);
+			Bool(8, msg.is_limit != 0);
+			Bool(9, msg.is_zoom != 0);
+			Bool(10, msg.is_cap != 0);
+			Bool(11, msg.is_potlimit != 0);
+			Bool(12, msg.is_shortdeck != 0);
+			Bool(13, msg.is_omahafive != 0);
+			Bool(14, msg.is_straightbeatstrips != 0);
+			Int(15, msg.currency);
+			Double(16, msg.sb);
+			Double(17, msg.bb);
+			Double(18, msg.ante);
+			Double(19, msg.straddle);
+			for (int i = 0; i < msg.seats_num && i < H2N_MAX_SEATS; ++i) {
+				const h2n_seat_info& s = msg.seats[i];
+				Tag(20, detail::WireBytes);
+				size_t seat = BeginLength();
+				Int(1, s.seat_idx);
+				CString(2, s.nickname);
+				PlayerId(s.player_id);
+				Double(4, s.stack);
+				CString(5, s.pocket_cards);
+				Bool(6, s.is_dealer != 0);
+				Bool(7, s.is_posted_sb != 0);
+				Bool(8, s.is_posted_bb != 0);
+				Bool(9, s.is_posted_sb_outofqueue != 0);
+				Bool(10, s.is_posted_bb_outofqueue != 0);
+				Bool(11, s.is_posted_straddle != 0);
+				Bool(12, s.is_hero != 0);
+				Bool(13, s.is_sitting_out != 0);
+				EndLength(seat);
+			}
+			EndLength(frame);
+			return *this;
+		}
+
+		WireWriter& Append(const h2n_action_message& msg) {
+			size_t frame = BeginFrame(WireMessage::Action);
+			UInt(1, (uint64_t)msg.gameid);
+			Int(2, msg.seat_idx);
+			Int(3, msg.type);
+			Double(4, msg.amount);
+			Bool(5, msg.is_allin != 0);
+			Double(6, msg.pot);
+			EndLength(frame);
+			return *this;
+		}
+
+		WireWriter& Append(const h2n_street_message& msg) {
+			size_t frame = BeginFrame(WireMessage::Street);
+			UInt(1, (uint64_t)msg.gameid);
+			Int(2, msg.type);
+			CString(3, msg.board);
+			Double(4, msg.pot);
+			EndLength(frame);
+			return *this;
+		}
+
+		// Upper bounds of the frame sizes Append writes, for encoding into a fixed buffer
+		static size_t MaxSize(const HandHistoryMessage& msg) {
+			return MaxFrameHeader + 4 * MaxScalar + MaxBytes(msg.FormattedHandHistory().size()) + MaxBytes(msg.OriginalHandHistory().size());
+		}
+
+		static size_t MaxSize(const HandStartMessage& msg) {
+			size_t n = MaxFrameHeader + 18 * MaxScalar + MaxBytes(msg.TableName().size());
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			for (size_t i = 0; i < seats.size(); ++i)
+				n += MaxBytes(11 * MaxScalar + MaxBytes(seats[i].Nickname().size()) + MaxBytes(seats[i].PoketCards().size()) + MaxPlayerId(seats[i]));
+			return n;
+		}
+
+		static size_t MaxSize(const HandActionMessage&) { return MaxFrameHeader + 6 * MaxScalar; }
+
+		static size_t MaxSize(const HandStreetMessage& msg) { return MaxFrameHeader + 3 * MaxScalar + MaxBytes(msg.Board().size()); }
+
+		static size_t MaxSizeJson(const char* json) { return MaxFrameHeader + MaxCString(json); }
+
+		static size_t MaxSizeCommand() { return MaxFrameHeader + 3 * MaxScalar; }
+
+		static size_t MaxSize(const h2n_hh_message& msg) {
+			return MaxFrameHeader + 4 * MaxScalar + MaxCString(msg.hh_formatted) + MaxCString(msg.hh_original);
+		}
+
+		static size_t MaxSize(const h2n_start_hand_message& msg) {
+			size_t n = MaxFrameHeader + 18 * MaxScalar + MaxCString(msg.table_name);
+			for (int i = 0; i < msg.seats_num && i < H2N_MAX_SEATS; ++i)
+				n += MaxBytes(11 * MaxScalar + MaxCString(msg.seats[i].nickname) + MaxCString(msg.seats[i].pocket_cards) + MaxCString(msg.seats[i].player_id));
+			return n;
+		}
+
+		static size_t MaxSize(const h2n_action_message&) { return MaxFrameHeader + 6 * MaxScalar; }
+
+		static size_t MaxSize(const h2n_street_message& msg) { return MaxFrameHeader + 3 * MaxScalar + MaxCString(msg.board); }
+
+	private:
+		std::vector<uint8_t> own_;
+		uint8_t* buf_;
+		size_t cap_;
+		size_t len_;
+
+		// Bounds of MaxSize: version, type and length of a frame, a tag with a varint or 8 bytes,
+		// a tag with the length of n bytes
+		static const size_t MaxFrameHeader = 1 + 1 + 5;
+		static const size_t MaxScalar = 2 + 10;
+		static size_t MaxBytes(size_t n) { return 2 + 5 + n; }
+		static size_t MaxCString(const char* s) { return s ? MaxBytes(strlen(s)) : 0; }
+		static size_t MaxPlayerId(const SeatInfo& s) {
+			const std::string* text = s.PlayerIdText();
+			return text ? MaxBytes(text->size()) : 0;
+		}
+
+		void Reserve(size_t n) {
+			size_t need = len_ + n;
+			if (need > cap_)
+				Grow(need);
+		}
+
+		void Grow(size_t need) {
+			size_t cap = need > cap_ * 2 ? need : cap_ * 2;
+			if (buf_ != own_.data()) {
+				// leaving the fixed buffer
+				std::vector<uint8_t> own(cap);
+				if (len_)
+					memcpy(own.data(), buf_, len_);
+				own_.swap(own);
+			}
+			else {
+				own_.resize(cap);
+			}
+			buf_ = own_.data();
+			cap_ = cap;
+		}
+
+		void Varint(uint64_t v) {
+			Reserve(10);
+			uint8_t* p = buf_ + len_;
+			while (v >= 0x80) {
+				*p++ = (uint8_t)(v | 0x80);
+				v >>= 7;
+			}
+			*p++ = (uint8_t)v;
+			len_ = p - buf_;
+		}
+
+		void Tag(int id, detail::WireType type) { Varint(((uint64_t)id << 3) | type); }
+
+		void UInt(int id, uint64_t v) {
+			if (!v)
+				return;
+			Tag(id, detail::WireVarint);
+			Varint(v);
+		}
+
+		void Int(int id, int v) {
+			if (!v)
+				return;
+			Tag(id, detail::WireVarint);
+			Varint(detail::ZigZag(v));
+		}
+
+		void Bool(int id, bool v) {
+			if (!v)
+				return;
+			Tag(id, detail::WireVarint);
+			Varint(1);
+		}
+
+		void Double(int id, double v) {
+			if (v == 0)
+				return;
+			int64_t cents;
+			if (detail::ToCents(v, cents)) {
+				Tag(id, detail::WireCents);
+				Varint(detail::ZigZag(cents));
+				return;
+			}
+			uint64_t bits;
+			memcpy(&bits, &v, sizeof(bits));
+			Tag(id, detail::WireFixed64);
+			Reserve(8);
+			for (int i = 0; i < 8; ++i)
+				buf_[len_++] = (uint8_t)(bits >> (i * 8));
+		}
+
+		void String(int id, const std::string& s) { String(id, s.data(), s.size()); }
+
+		// Seat field 3 holds a numeric player id, field 14 any other id string
+		void PlayerId(const SeatInfo& s) {
+			if (const std::string* text = s.PlayerIdText())
+				String(14, *text);
+			else
+				UInt(3, s.PlayerId());
+		}
+
+		void PlayerId(const char* s) {
+			uint64_t id;
+			const size_t len = s ? strlen(s) : 0;
+			if (SeatInfo::ParsePlayerId(s, len, id))
+				UInt(3, id);
+			else
+				String(14, s, len);
+		}
+
+		void CString(int id, const char* s) {
+			if (s)
+				String(id, s, strlen(s));
+		}
+
+		void String(int id, const char* s, size_t n) {
+			if (!n)
+				return;
+			Tag(id, detail::WireBytes);
+			Varint(n);
+			Reserve(n);
+			memcpy(&buf_[len_], s, n);
+			len_ += n;
+		}
+
+		size_t BeginFrame(WireMessage type) {
+			Reserve(1);
+			buf_[len_++] = detail::WireVersion;
+			Varint((uint64_t)type);
+			return BeginLength();
+		}
+
+		// One byte is reserved for the length, longer lengths shift the body once it is known
+		size_t BeginLength() {
+			Reserve(1);
+			return len_++;
+		}
+
+		void EndLength(size_t pos) {
+			size_t body = len_ - pos - 1;
+			size_t extra = 0;
+			for (size_t v = body >> 7; v; v >>= 7)
+				++extra;
+			if (extra) {
+				Reserve(extra);
+				memmove(&buf_[pos + 1 + extra], &buf_[pos + 1], body);
+			}
+			uint8_t* p = &buf_[pos];
+			while (body >= 0x80) {
+				*p++ = (uint8_t)(body | 0x80);
+				body >>= 7;
+			}
+			*p = (uint8_t)body;
+			len_ += extra;
+		}
+
+		friend class CallRecorder;
+	};
+
+	// Reads a sequence of WireWriter frames.
+	//
+	//	WireReader reader(data, size);
+	//	while (reader.Next()) {
+	//		if (reader.Type() == WireMessage::Action && reader.Read(action)) ...
+	//	}
+	class WireReader {
+	public:
+		WireReader(const void* data, size_t size) :
+			p_((const uint8_t*)data), end_((const uint8_t*)data + size), body_(nullptr), body_end_(nullptr), type_(0), error_(false)
+		{
+		}
+
+		// Moves to the next frame, returns false at the end of data or on malformed frame
+		bool Next() {
+			if (p_ == end_ || error_)
+				return false;
+			uint64_t type, len;
+			if (*p_++ != detail::WireVersion || !Varint(p_, end_, type) || !Varint(p_, end_, len) || len > (uint64_t)(end_ - p_))
+				return Fail();
+			type_ = (int)type;
+			body_ = p_;
+			body_end_ = p_ + len;
+			p_ = body_end_;
+			return true;
+		}
+
+		// true if data ended with a malformed frame
+		bool IsError() const { return error_; }
+
+		WireMessage Type() const { return (WireMessage)type_; }
+
+		// Current frame body
+		const uint8_t* Body() const { return body_; }
+		size_t BodySize() const { return body_end_ - body_; }
+
+		// Start of the next frame
+		const uint8_t* Position() const { return p_; }
+
+		bool Read(HandHistoryMessage& msg) const {
+			if (Type() != WireMessage::HandHistory)
+				return false;
+			Fields f(body_, body_end_);
+			msg = HandHistoryMessage();
+			msg.room((Room)0);
+			msg.Format((HandHistoryFormat)0);
+			while (f.Next()) {
+				switch (f.id) {
+				case 1: msg.room((Room)f.Int()); break;
+				case 2: msg.SetZoom(f.Bool()); break;
+				case 3: msg.GameId(f.value); break;
+				case 4: msg.Format((HandHistoryFormat)f.Int()); break;
+				case 5: msg.FormattedHandHistory(f.String()); break;
+				case 6: msg.OriginalHandHistory(f.String()); break;
+				}
+			}
+			return f.ok;
+		}
+
+		bool Read(HandStartMessage& msg) const {
+			if (Type() != WireMessage::HandStart)
+				return false;
+			Fields f(body_, body_end_);
+			msg = HandStartMessage((Room)0);
+			msg.SetCurrency((Currency)0);
+			msg.SetStraightBeatsTrips(false);
+			HandStartMessage::SeatsList seats;
+			while (f.Next()) {
+				switch (f.id) {
+				case 1: msg.room((Room)f.Int()); break;
+				case 2: msg.GameId(f.value); break;
+				case 3: msg.TableName(f.String()); break;
+				case 4: msg.TableHwnd(f.Int()); break;
+				case 5: msg.MaxPlayers(f.Int()); break;
+				case 6: msg.SetTourney(f.Bool()); break;
+				case 7: msg.SetOmaha(f.Bool()); break;
+				case 8: msg.SetLimit(f.Bool()); break;
+				case 9: msg.SetZoom(f.Bool()); break;
+				case 10: msg.SetCap(f.Bool()); break;
+				case 11: msg.SetPotLimit(f.Bool()); break;
+				case 12: msg.SetShortDeck(f.Bool()); break;
+				case 13: msg.SetOmahaFive(f.Bool()); break;
+				case 14: msg.SetStraightBeatsTrips(f.Bool()); break;
+				case 15: msg.SetCurrency((Currency)f.Int()); break;
+				case 16: msg.SmallBlind(f.Double()); break;
+				case 17: msg.BigBlind(f.Double()); break;
+				case 18: msg.Ante(f.Double()); break;
+				case 19: msg.Straddle(f.Double()); break;
+				case 20:
+					if (f.type == detail::WireBytes) {
+						seats.push_back(SeatInfo());
+						if (!ReadSeat(f.bytes, f.bytes + f.value, seats.back()))
+							return false;
+					}
+					break;
+				}
+			}
+			msg.Seats(seats);
+			return f.ok;
+		}
+
+		bool Read(HandActionMessage& msg) const {
+			if (Type() != WireMessage::Action)
+				return false;
+			Fields f(body_, body_end_);
+			msg = HandActionMessage();
+			while (f.Next()) {
+				switch (f.id) {
+				case 1: msg.GameId(f.value); break;
+				case 2: msg.SeatIndex(f.Int()); break;
+				case 3: msg.ActionType((Action)f.Int()); break;
+				case 4: msg.Amount(f.Double()); break;
+				case 5: msg.SetAllin(f.Bool()); break;
+				case 6: msg.Pot(f.Double()); break;
+				}
+			}
+			return f.ok;
+		}
+
+		bool ReadJson(std::string& json) const {
+			if (Type() != WireMessage::Json)
+				return false;
+			Fields f(body_, body_end_);
+			json.clear();
+			while (f.Next()) {
+				if (f.id == 1)
+					json = f.String();
+			}
+			return f.ok;
+		}
+
+		bool ReadCommand(int& table_hwnd, int& room, int& cmd) const {
+			if (Type() != WireMessage::Command)
+				return false;
+			Fields f(body_, body_end_);
+			table_hwnd = room = cmd = 0;
+			while (f.Next()) {
+				switch (f.id) {
+				case 1: table_hwnd = f.Int(); break;
+				case 2: room = f.Int(); break;
+				case 3: cmd = f.Int(); break;
+				}
+			}
+			return f.ok;
+		}
+
+		bool Read(HandStreetMessage& msg) const {
+			if (Type() != WireMessage::Street)
+				return false;
+			Fields f(body_, body_end_);
+			msg = HandStreetMessage();
+			msg.StreetType((Street)0);
+			while (f.Next()) {
+				switch (f.id) {
+				case 1: msg.GameId(f.value); break;
+				case 2: msg.StreetType((Street)f.Int()); break;
+				case 3: msg.Board(f.String()); break;
+				case 4: msg.Pot(f.Double()); break;
+				}
+			}
+			return f.ok;
+		}
+
+	private:
+		const uint8_t* p_;
+		const uint8_t* end_;
+		const uint8_t* body_;
+		const uint8_t* body_end_;
+		int type_;
+		bool error_;
+
+		bool Fail() {
+			error_ = true;
+			return false;
+		}
+
+		static bool Varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+			v = 0;
+			for (int shift = 0; shift < 64 && p != end; shift += 7) {
+				uint8_t b = *p++;
+				v |= (uint64_t)(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		// Iterates over the fields of a body, value holds the varint value,
+		// the raw fixed64 bits or the length of a bytes field
+		struct Fields {
+			const uint8_t* p;
+			const uint8_t* end;
+			int id;
+			int type;
+			uint64_t value;
+			const uint8_t* bytes;
+			bool ok;
+
+			Fields(const uint8_t* begin, const uint8_t* e) : p(begin), end(e), id(0), type(0), value(0), bytes(nullptr), ok(true) {}
+
+			bool Next() {
+				if (p == end || !ok)
+					return false;
+				uint64_t tag;
+				if (!Varint(p, end, tag))
+					return ok = false;
+				id = (int)(tag >> 3);
+				type = (int)(tag & 7);
+				switch (type) {
+				case detail::WireVarint:
+				case detail::WireCents:
+					return ok = Varint(p, end, value);
+				case detail::WireFixed64:
+					if (end - p < 8)
+						return ok = false;
+					value = 0;
+					for (int i = 0; i < 8; ++i)
+						value |= (uint64_t)*p++ << (i * 8);
+					return true;
+				case detail::WireBytes:
+					if (!Varint(p, end, value) || value > (uint64_t)(end - p))
+						return ok = false;
+					bytes = p;
+					p += value;
+					return true;
+				default:
+					// unknown wire type can't be skipped
+					return ok = false;
+				}
+			}
+
+			int Int() const { return (int)detail::UnZigZag(value); }
+			bool Bool() const { return value != 0; }
+			double Double() const {
+				if (type == detail::WireCents)
+					return (double)detail::UnZigZag(value) / 100;
+				double d;
+				memcpy(&d, &value, sizeof(d));
+				return d;
+			}
+			std::string String() const {
+				return type == detail::WireBytes ? std::string((const char*)bytes, (size_t)value) : std::string();
+			}
+		};
+
+		static bool ReadSeat(const uint8_t* begin, const uint8_t* end, SeatInfo& s) {
+			Fields f(begin, end);
+			while (f.Next()) {
+				switch (f.id) {
+				case 1: s.SeatIndex(f.Int()); break;
+				case 2: s.Nickname(f.String()); break;
+				case 3: s.PlayerId(f.value); break;
+				case 4: s.Stack(f.Double()); break;
+				case 5: s.PoketCards(f.String()); break;
+				case 6: s.SetDealer(f.Bool()); break;
+				case 7: s.SetPostedSmallBlind(f.Bool()); break;
+				case 8: s.SetPostedBigBlind(f.Bool()); break;
+				case 9: s.SetPostedSmallBlindOutOfQueue(f.Bool()); break;
+				case 10: s.SetPostedBigBlindOutOfQueue(f.Bool()); break;
+				case 11: s.SetPostedStraddle(f.Bool()); break;
+				case 12: s.SetHero(f.Bool()); break;
+				case 13: s.SetSittingOut(f.Bool()); break;
+				case 14: s.PlayerId(f.String()); break;
+				}
+			}
+			return f.ok;
+		}
+	};
+
+
+	// Records the calls made through Protocol into a compact binary log for h2n_replay.
+	//
+	// The log starts with the "H2NCALLS" magic followed by records of
+	// [varint nanoseconds since the previous record][WireWriter frame].
+	// Records are buffered in memory and written to the file in large blocks.
+	//
+	//	CallRecorder recorder;
+	//	recorder.Open("session.h2ncalls");
+	//	Protocol::SetRecorder(&recorder);
+	class CallRecorder {
+	public:
+		CallRecorder() : file_(nullptr), last_ns_(0) {}
+		~CallRecorder() { Close(); }
+
+		bool Open(const char* path) {
+			Close();
+			std::lock_guard<std::mutex> lock(mutex_);
+			file_ = fopen(path, "wb");
+			if (!file_)
+				return false;
+			fwrite(Magic(), 1, 8, file_);
+			last_ns_ = Now();
+			return true;
+		}
+
+		void Close() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!file_)
+				return;
+			FlushLocked();
+			fclose(file_);
+			file_ = nullptr;
+		}
+
+		void Flush() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (file_) {
+				FlushLocked();
+				fflush(file_);
+			}
+		}
+
+		template<class Message>
+		void Record(const Message& msg) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			Stamp();
+			writer_.Append(msg);
+			MaybeFlush();
+		}
+
+		void RecordJson(const char* json) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			Stamp();
+			writer_.AppendJson(json);
+			MaybeFlush();
+		}
+
+		void RecordCommand(int table_hwnd, int room, int cmd) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			Stamp();
+			writer_.AppendCommand(table_hwnd, room, cmd);
+			MaybeFlush();
+		}
+
+		static const char* Magic() { return "H2NCALLS"; }
+
+	private:
+		std::mutex mutex_;
+		FILE* file_;
+		uint64_t last_ns_;
+		WireWriter writer_;
+
+		static uint64_t Now() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		void Stamp() {
+			uint64_t now = Now();
+			writer_.Varint(now - last_ns_);
+			last_ns_ = now;
+		}
+
+		void MaybeFlush() {
+			if (writer_.size() >= 64 * 1024)
+				FlushLocked();
+		}
+
+		void FlushLocked() {
+			if (file_)
+				fwrite(writer_.data(), 1, writer_.size(), file_);
+			writer_.Clear();
+		}
+	};
+
+	// Reads a log written by CallRecorder.
+	class CallLogReader {
+	public:
+		CallLogReader() : pos_(0), time_ns_(0), frame_(nullptr, 0) {}
+
+		bool Open(const char* path) {
+			data_.clear();
+			pos_ = 0;
+			time_ns_ = 0;
+			FILE* f = fopen(path, "rb");
+			if (!f)
+				return false;
+			uint8_t block[64 * 1024];
+			size_t n;
+			while ((n = fread(block, 1, sizeof(block), f)) != 0)
+				data_.insert(data_.end(), block, block + n);
+			fclose(f);
+			if (data_.size() < 8 || memcmp(data_.data(), CallRecorder::Magic(), 8) != 0)
+				return false;
+			pos_ = 8;
+			return true;
+		}
+
+		// Moves to the next recorded call
+		bool Next() {
+			const uint8_t* p = data_.data() + pos_;
+			const uint8_t* end = data_.data() + data_.size();
+			uint64_t delta = 0;
+			int shift = 0;
+			for (;;) {
+				if (p == end || shift >= 64)
+					return false;
+				uint8_t b = *p++;
+				delta |= (uint64_t)(b & 0x7F) << shift;
+				shift += 7;
+				if (!(b & 0x80))
+					break;
+			}
+			frame_ = WireReader(p, end - p);
+			if (!frame_.Next())
+				return false;
+			pos_ = frame_.Position() - data_.data();
+			time_ns_ += delta;
+			return true;
+		}
+
+		// Time of the current call in nanoseconds since the recording was opened
+		uint64_t TimeNs() const { return time_ns_; }
+
+		// Current call, use WireReader::Type and Read* to decode it
+		const WireReader& Call() const { return frame_; }
+
+	private:
+		std::vector<uint8_t> data_;
+		size_t pos_;
+		uint64_t time_ns_;
+		WireReader frame_;
+	};
+
+#ifdef H2NAPI_HEADER_ONLY
+	namespace detail {
+		// LocalTransport::Send of h2napi_local.hpp, included at the end of this file
+		template<class Message>
+		inline int SendLocal(const Message& msg);
+	}
+#endif
+
+	// Send* return h2n_status values, see SendStatus
+	class Protocol {
+	public:
+		inline static int SendHandHistory(const HandHistoryMessage& msg) {
+			if (CallRecorder* r = Recorder())
+				r->Record(msg);
+#ifdef H2NAPI_HEADER_ONLY
+			return detail::SendLocal(msg);
+#else
+			h2n_hh_message m;
+			msg.MakeH2NApiLibMessage(&m);
+			return h2n_send_handhistory(&m);
+#endif
+		}
+		inline static int SendHandStart(const HandStartMessage& msg) {
+			if (msg.Seats().size() > H2N_MAX_SEATS)
+				return H2N_STATUS_INVALID_MESSAGE;
+			if (CallRecorder* r = Recorder())
+				r->Record(msg);
+#ifdef H2NAPI_HEADER_ONLY
+			return detail::SendLocal(msg);
+#else
+			h2n_start_hand_message m;
+			msg.MakeH2NApiLibMessage(&m);
+			return h2n_send_hand_start(&m);
+#endif
+		}
+		inline static int SendHandActon(const HandActionMessage& msg) {
+			if (CallRecorder* r = Recorder())
+				r->Record(msg);
+#ifdef H2NAPI_HEADER_ONLY
+			return detail::SendLocal(msg);
+#else
+			h2n_action_message m;
+			msg.MakeH2NApiLibMessage(&m);
+			return h2n_send_action(&m);
+#endif
+		}
+		inline static int SendHandStreed(const HandStreetMessage& msg) {
+			if (CallRecorder* r = Recorder())
+				r->Record(msg);
+#ifdef H2NAPI_HEADER_ONLY
+			return detail::SendLocal(msg);
+#else
+			h2n_street_message m;
+			msg.MakeH2NApiLibMessage(&m);
+			return h2n_send_street(&m);
+#endif
+		}
+		inline static int SendJson(const JsonWriter& json) {
+			return SendJson(json.c_str());
+		}
+		inline static int SendJson(const char* json) {
+			if (CallRecorder* r = Recorder())
+				r->RecordJson(json);
+			return h2n_send_json(json);
+		}
+		inline static int SendCommand(int table_hwnd, Room room, Command cmd) {
+			if (CallRecorder* r = Recorder())
+				r->RecordCommand(table_hwnd, (int)room, (int)cmd);
+			return h2n_send_command(table_hwnd, (int)room, (int)cmd);
+		}
+
+		// true if Hand2Note listens, Send* fail with H2N_STATUS_CONSUMER_ABSENT otherwise. Cheap
+		// enough to check before composing a message; with h2napi.dll, which has no such export,
+		// it is h2n_is_running.
+		inline static bool IsConsumerAttached() {
+#if defined(_WIN32) && !defined(H2NAPI_HEADER_ONLY)
+			return h2n_is_running() != 0;
+#else
+			return h2n_consumer_attached() != 0;
+#endif
+		}
+
+		// Fill the h2n_* structs the Send* functions pass to h2napi. Pointers in the structs
+		// refer to the strings of msg and stay valid while msg is alive and not modified.
+		inline static void Marshal(const HandHistoryMessage& msg, h2n_hh_message* m) { msg.MakeH2NApiLibMessage(m); }
+		inline static void Marshal(const HandStartMessage& msg, h2n_start_hand_message* m) { msg.MakeH2NApiLibMessage(m); }
+		inline static void Marshal(const HandActionMessage& msg, h2n_action_message* m) { msg.MakeH2NApiLibMessage(m); }
+		inline static void Marshal(const HandStreetMessage& msg, h2n_street_message* m) { msg.MakeH2NApiLibMessage(m); }
+
+		// All following Send* calls are also appended to the recorder, nullptr stops recording.
+		// The recorder must outlive the calls made while it is set.
+		inline static void SetRecorder(CallRecorder* recorder) {
+			RecorderSlot().store(recorder, std::memory_order_release);
+		}
+		inline static CallRecorder* Recorder() {
+			return RecorderSlot().load(std::memory_order_acquire);
+		}
+
+	private:
+		inline static std::atomic<CallRecorder*>& RecorderSlot() {
+			static std::atomic<CallRecorder*> recorder(nullptr);
+			return recorder;
+		}
+	};
+}
+
+#ifdef H2NAPI_HEADER_ONLY
+	#include "h2napi_local.hpp"
+#endif
 
 
 #endif
@@ -0,0 +1,280 @@
+#ifndef _H2NAPIEQUITYHPP__
+#define _H2NAPIEQUITYHPP__
+
+#include "h2napi.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace Hand2Note {
+
+	struct EquityOptions {
+		unsigned threads = 0;                 // 0 for std::thread::hardware_concurrency()
+		uint64_t exhaustive_limit = 100000;   // boards to enumerate at most, larger spaces are sampled
+		uint64_t samples = 200000;            // Monte Carlo boards
+		uint64_t seed = 2416948123;
+	};
+
+	struct EquityResult {
+		int      players;
+		double   equity[H2N_MAX_SEATS];      // share of the pot, ties split
+		double   win[H2N_MAX_SEATS];         // boards won alone, as a fraction
+		double   tie[H2N_MAX_SEATS];         // boards split
+		uint64_t boards;
+		bool     exhaustive;                  // all boards enumerated, exact result
+	};
+
+	// All-in equity of known pocket cards for the rest of the board, in the game of the hand:
+	// hold'em, short deck, omaha and five card omaha (HandStartMessage flags).
+	//
+	// Turn and river (and the flop, within EquityOptions::exhaustive_limit boards) are enumerated,
+	// preflop is sampled with an own random generator per thread. Every board is evaluated for all
+	// players in one pass, the work is split across threads by board.
+	//
+	//	CardMask pockets[2];
+	//	Cards::Parse("AhAs", pockets[0]);
+	//	Cards::Parse("KdKc", pockets[1]);
+	//	EquityResult r = EquityCalculator(start).Calculate(pockets, 2, 0);
+	class EquityCalculator {
+	public:
+		EquityCalculator() : omaha_(false), short_deck_(false), straight_beats_trips_(true), pocket_sizes_(PocketSize(2)) {}
+
+		explicit EquityCalculator(const HandStartMessage& game) :
+			omaha_(game.IsOmaha() || game.IsOmahaFive()), short_deck_(game.IsShortDeck()),
+			straight_beats_trips_(game.IsStraightBeatsTrips()),
+			pocket_sizes_(PocketSize(game.IsOmahaFive() ? 5 : game.IsOmaha() ? 4 : 2))
+		{
+		}
+
+		// omaha takes pockets of 4 or 5 cards
+		EquityCalculator(bool omaha, bool short_deck, bool straight_beats_trips = true) :
+			omaha_(omaha), short_deck_(short_deck), straight_beats_trips_(straight_beats_trips),
+			pocket_sizes_(omaha ? PocketSize(4) | PocketSize(5) : PocketSize(2))
+		{
+		}
+
+		// board is 0, 3, 4 or 5 cards, dead are other known cards out of the deck (e.g. folded hands).
+		// The result is empty (no boards) for pockets of the wrong size for the game or cards used twice.
+		EquityResult Calculate(const CardMask* pockets, int players, CardMask board, CardMask dead = 0,
+			const EquityOptions& opt = EquityOptions()) const
+		{
+			EquityResult result;
+			memset(&result, 0, sizeof(result));
+			result.players = players;
+			if (players < 1 || players > H2N_MAX_SEATS || (board & dead))
+				return result;
+
+			CardMask used = board | dead;
+			const int pocket_size = Cards::Size(pockets[0]);
+			for (int i = 0; i < players; ++i) {
+				// all players of an omaha hand hold the same number of cards
+				if ((used & pockets[i]) || Cards::Size(pockets[i]) != pocket_size || pocket_size > 5 || !(pocket_sizes_ & PocketSize(pocket_size)))
+					return result;
+				used |= pockets[i];
+			}
+			if (short_deck_ && (used & Cards::LowRanks))
+				return result;
+			Deck deck;
+			deck.size = 0;
+			for (int c = 0; c < Cards::Count; ++c) {
+				CardMask card = (CardMask)1 << c;
+				if (!(used & card) && !(short_deck_ && (card & Cards::LowRanks)))
+					deck.cards[deck.size++] = card;
+			}
+			const int missing = 5 - Cards::Size(board);
+			if (missing < 0 || missing > deck.size)
+				return result;
+
+			const uint64_t total = Combinations(deck.size, missing);
+			result.exhaustive = total <= opt.exhaustive_limit;
+			const uint64_t boards = result.exhaustive ? total : opt.samples;
+			unsigned threads = opt.threads ? opt.threads : std::thread::hardware_concurrency();
+			// a thread start costs about as much as a few thousand boards
+			uint64_t by_work = boards / 4096 + 1;
+			threads = (unsigned)std::max<uint64_t>(1, std::min<uint64_t>(threads ? threads : 1, by_work));
+
+			std::vector<Tally> tallies(threads);
+			auto work = [&](unsigned t) {
+				// counted on the thread's own stack, no cache line sharing
+				Tally tally;
+				if (result.exhaustive)
+					Enumerate(pockets, players, board, deck, missing, t, threads, tally);
+				else
+					Sample(pockets, players, board, deck, missing, boards / threads + (t < boards % threads ? 1 : 0),
+						opt.seed + t * 0x9E3779B97F4A7C15ull, tally);
+				tallies[t] = tally;
+			};
+			std::vector<std::thread> pool;
+			for (unsigned t = 1; t < threads; ++t)
+				pool.emplace_back(work, t);
+			work(0);
+			for (auto& th : pool)
+				th.join();
+
+			Tally sum;
+			for (const Tally& t : tallies)
+				sum.Add(t);
+			result.boards = sum.boards;
+			for (int i = 0; i < players && sum.boards; ++i) {
+				result.equity[i] = sum.equity[i] / sum.boards;
+				result.win[i] = (double)sum.win[i] / sum.boards;
+				result.tie[i] = (double)sum.tie[i] / sum.boards;
+			}
+			return result;
+		}
+
+	private:
+		bool     omaha_;
+		bool     short_deck_;
+		bool     straight_beats_trips_;
+		uint32_t pocket_sizes_;    // bit n set for pockets of n cards
+
+		static uint32_t PocketSize(int cards) { return 1u << cards; }
+
+		struct Deck {
+			CardMask cards[Cards::Count];
+			int      size;
+		};
+
+		struct Tally {
+			double   equity[H2N_MAX_SEATS];
+			uint64_t win[H2N_MAX_SEATS];
+			uint64_t tie[H2N_MAX_SEATS];
+			uint64_t boards;
+
+			Tally() { memset(this, 0, sizeof(*this)); }
+
+			void Add(const Tally& t) {
+				for (int i = 0; i < H2N_MAX_SEATS; ++i) {
+					equity[i] += t.equity[i];
+					win[i] += t.win[i];
+					tie[i] += t.tie[i];
+				}
+				boards += t.boards;
+			}
+		};
+
+		// xoshiro256**, seeded by splitmix64
+		class Random {
+		public:
+			explicit Random(uint64_t seed) {
+				for (uint64_t& v : s_) {
+					seed += 0x9E3779B97F4A7C15ull;
+					uint64_t z = seed;
+					z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+					z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+					v = z ^ (z >> 31);
+				}
+			}
+
+			uint64_t Next() {
+				uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+				uint64_t t = s_[1] << 17;
+				s_[2] ^= s_[0];
+				s_[3] ^= s_[1];
+				s_[1] ^= s_[2];
+				s_[0] ^= s_[3];
+				s_[2] ^= t;
+				s_[3] = Rotl(s_[3], 45);
+				return result;
+			}
+
+			// 0..n-1 without division
+			uint32_t Below(uint32_t n) { return (uint32_t)(((Next() >> 32) * n) >> 32); }
+
+		private:
+			uint64_t s_[4];
+
+			static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+		};
+
+		static uint64_t Combinations(int n, int k) {
+			uint64_t r = 1;
+			for (int i = 0; i < k; ++i)
+				r = r * (n - i) / (i + 1);
+			return r;
+		}
+
+		HandValue Value(CardMask pocket, CardMask board) const {
+			if (omaha_)
+				return Evaluator::EvalOmaha(pocket, board);
+			if (short_deck_)
+				return Evaluator::EvalShortDeck(pocket | board, straight_beats_trips_);
+			return Evaluator::Eval(pocket | board);
+		}
+
+		void Showdown(const CardMask* pockets, int players, CardMask board, Tally& tally) const {
+			HandValue values[H2N_MAX_SEATS];
+			HandValue best = 0;
+			for (int i = 0; i < players; ++i) {
+				values[i] = Value(pockets[i], board);
+				best = values[i] > best ? values[i] : best;
+			}
+			int winners = 0;
+			for (int i = 0; i < players; ++i)
+				winners += values[i] == best;
+			const double share = 1.0 / winners;
+			for (int i = 0; i < players; ++i) {
+				if (values[i] != best)
+					continue;
+				tally.equity[i] += share;
+				if (winners == 1)
+					++tally.win[i];
+				else
+					++tally.tie[i];
+			}
+			++tally.boards;
+		}
+
+		// All boards completing board with k deck cards, this thread takes every threads-th first card
+		void Enumerate(const CardMask* pockets, int players, CardMask board, const Deck& deck, int k,
+			unsigned thread, unsigned threads, Tally& tally) const
+		{
+			if (k == 0) {
+				if (thread == 0)
+					Showdown(pockets, players, board, tally);
+				return;
+			}
+			int idx[5];
+			for (int first = (int)thread; first <= deck.size - k; first += (int)threads) {
+				idx[0] = first;
+				for (int i = 1; i < k; ++i)
+					idx[i] = first + i;
+				for (;;) {
+					CardMask b = board;
+					for (int i = 0; i < k; ++i)
+						b |= deck.cards[idx[i]];
+					Showdown(pockets, players, b, tally);
+					// next combination with the same first card
+					int i = k - 1;
+					while (i > 0 && idx[i] == deck.size - k + i)
+						--i;
+					if (i == 0)
+						break;
+					++idx[i];
+					for (int j = i + 1; j < k; ++j)
+						idx[j] = idx[j - 1] + 1;
+				}
+			}
+		}
+
+		void Sample(const CardMask* pockets, int players, CardMask board, const Deck& deck, int k,
+			uint64_t boards, uint64_t seed, Tally& tally) const
+		{
+			Random rnd(seed);
+			for (uint64_t n = 0; n < boards; ++n) {
+				CardMask b = board;
+				for (int i = 0; i < k; ) {
+					CardMask card = deck.cards[rnd.Below((uint32_t)deck.size)];
+					if (b & card)
+						continue;
+					b |= card;
+					++i;
+				}
+				Showdown(pockets, players, b, tally);
+			}
+		}
+	};
+}
+
+#endif
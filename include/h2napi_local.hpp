@@ -0,0 +1,309 @@
+#ifndef _H2NAPILOCALHPP__
+#define _H2NAPILOCALHPP__
+
+// The h2napi functions over a local SharedRing, for platforms without h2napi.dll.
+//
+// Every call is encoded as one WireWriter frame into one record of the ring named
+// by the H2NAPI_RING environment variable ("/h2napi" by default). The ring is created by the
+// consumer (h2n_mock_consumer, or a test attaching to it) at any capacity; while there is no
+// ring or nobody is attached, send functions return H2N_STATUS_CONSUMER_ABSENT without encoding
+// anything. A consumer that creates the ring anew is followed within 100 ms.
+// A consumer process that exited without detaching is noticed within 100 ms, within 1 ms
+// once its ring is full.
+//
+// The source build compiles the functions once in src/h2napi_local.cpp. With H2NAPI_HEADER_ONLY
+// defined h2napi.hpp includes this file, the functions are inline and Protocol::Send* encode
+// the message classes straight into the transport without filling the h2n_* structs.
+
+#include "h2napi.hpp"
+#include "h2napi_ring.hpp"
+
+#include <memory>
+
+namespace Hand2Note {
+
+	class LocalTransport {
+	public:
+		static LocalTransport& Instance() {
+			static LocalTransport transport;
+			return transport;
+		}
+
+		// The ring of H2NAPI_RING, nullptr until there is one. At most every 100 ms the name is
+		// looked up again: a ring the consumer removed and created anew replaces the open one,
+		// and a consumer process that exited without Detach is detached.
+		SharedRing* Ring() {
+			SharedRing* ring = ring_.load(std::memory_order_acquire);
+			const int64_t now = Now();
+			if (now < check_.load(std::memory_order_relaxed))
+				return ring;
+			std::lock_guard<std::mutex> lock(mutex_);
+			ring = ring_.load(std::memory_order_relaxed);
+			if (now < check_.load(std::memory_order_relaxed))
+				return ring;
+			check_.store(now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(CheckPeriod)).count(), std::memory_order_relaxed);
+			const char* env = getenv("H2NAPI_RING");
+			const char* name = env && *env ? env : SharedRing::DefaultName();
+			if (!ring || !ring->IsNamed(name)) {
+				std::unique_ptr<SharedRing> reopened(new SharedRing());
+				if (reopened->Open(name, SharedRing::AnyCapacity)) {
+					ring = reopened.get();
+					rings_.push_back(std::move(reopened));
+					ring_.store(ring, std::memory_order_release);
+				}
+			}
+			if (ring)
+				ring->CheckConsumer();
+			return ring;
+		}
+
+		bool ConsumerAttached() {
+			SharedRing* ring = Ring();
+			return ring && ring->ConsumerAttached();
+		}
+
+		int QueueUsage(unsigned int* used, unsigned int* capacity) {
+			SharedRing* ring = Ring();
+			if (!ring || !ring->ConsumerAttached())
+				return H2N_STATUS_CONSUMER_ABSENT;
+			if (used)
+				*used = (unsigned int)ring->Used();
+			if (capacity)
+				*capacity = (unsigned int)ring->Capacity();
+			return H2N_STATUS_OK;
+		}
+
+		// Spins briefly, then yields, then sleeps up to 1 ms between checks: the consumer moves
+		// the tail without signaling producers, there is no wait across processes on every platform
+		int WaitWritable(size_t bytes, int timeout_ms) {
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms < 0 ? 0 : timeout_ms);
+			std::chrono::microseconds sleep(0);
+			for (int i = 0;; ++i) {
+				SharedRing* ring = Ring();
+				if (!ring || !ring->ConsumerAttached())
+					return H2N_STATUS_CONSUMER_ABSENT;
+				const RingResult r = ring->Writable(bytes + FieldAllowance);
+				if (r != RingResult::Full)
+					return Status(r);
+				if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+					return H2N_STATUS_QUEUE_FULL;
+				if (i >= 128) {
+					// a consumer that died attached never frees space
+					if (!Alive(ring))
+						return H2N_STATUS_CONSUMER_ABSENT;
+					if (sleep < std::chrono::microseconds(1000))
+						sleep += std::chrono::microseconds(50);
+					std::this_thread::sleep_for(sleep);
+				}
+				else if (i >= 64) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// A message class or an h2n_* struct, anything WireWriter::Append takes. The frame is
+		// encoded straight into a ring record reserved for WireWriter::MaxSize bytes.
+		template<class Message>
+		int Send(const Message& msg) {
+			SharedRing* ring = Ring();
+			if (!ring || !ring->ConsumerAttached())
+				return H2N_STATUS_CONSUMER_ABSENT;
+			if (!IsValid(msg))
+				return H2N_STATUS_INVALID_MESSAGE;
+			return Encode(ring, WireWriter::MaxSize(msg), [&](WireWriter& w) { w.Append(msg); });
+		}
+
+		int SendJson(const char* json) {
+			SharedRing* ring = Ring();
+			if (!ring || !ring->ConsumerAttached())
+				return H2N_STATUS_CONSUMER_ABSENT;
+			if (!json)
+				return H2N_STATUS_INVALID_MESSAGE;
+			return Encode(ring, WireWriter::MaxSizeJson(json), [&](WireWriter& w) { w.AppendJson(json); });
+		}
+
+		int SendCommand(int table_hwnd, int room, int cmd) {
+			SharedRing* ring = Ring();
+			if (!ring || !ring->ConsumerAttached())
+				return H2N_STATUS_CONSUMER_ABSENT;
+			return Encode(ring, WireWriter::MaxSizeCommand(), [&](WireWriter& w) { w.AppendCommand(table_hwnd, room, cmd); });
+		}
+
+		// Rooms Hand2Note names tables for, other rooms get "H2N<room id>"
+		static const char* TablePrefix(int room) {
+			switch (room) {
+			case H2N_ROOM_POKERSTARS: return "PS";
+			case H2N_ROOM_FISHPOKERS: return "FSHP";
+			default: return nullptr;
+			}
+		}
+
+	private:
+		std::atomic<SharedRing*> ring_{ nullptr };
+		std::atomic<int64_t> check_{ 0 };    // steady_clock ticks of the next look at the ring name
+		std::atomic<int64_t> checked_{ 0 };  // steady_clock ticks of the last consumer process check
+		std::mutex mutex_;
+		// every ring opened, a send may still be writing to a replaced one
+		std::vector<std::unique_ptr<SharedRing>> rings_;
+
+		// ms between looks at the ring name and the consumer process, and between process
+		// checks while the ring is full
+		enum { CheckPeriod = 100, FullCheckPeriod = 1 };
+
+		// the record WireWriter::MaxSize reserves for a message above the length of its strings,
+		// at most ~1.8 KB for a hand start with H2N_MAX_SEATS seats
+		static const size_t FieldAllowance = 2048;
+
+		LocalTransport() {}
+
+		// the seats of a hand start must fit h2n_start_hand_message, the other fields take any value
+		template<class Message>
+		static bool IsValid(const Message&) { return true; }
+		static bool IsValid(const HandStartMessage& msg) { return msg.Seats().size() <= H2N_MAX_SEATS; }
+		static bool IsValid(const h2n_start_hand_message& msg) { return msg.seats_num >= 0 && msg.seats_num <= H2N_MAX_SEATS; }
+
+		static int64_t Now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+		// ConsumerAttached, for a full ring: a consumer killed without Detach leaves its process
+		// id in the ring header and never frees space. The process is checked at most every
+		// FullCheckPeriod and a dead one is detached.
+		bool Alive(SharedRing* ring) {
+			if (!ring->ConsumerAttached())
+				return false;
+			const int64_t now = Now();
+			if (now - checked_.load(std::memory_order_relaxed) < std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(FullCheckPeriod)).count())
+				return true;
+			checked_.store(now, std::memory_order_relaxed);
+			return ring->CheckConsumer();
+		}
+
+		static int Status(RingResult r) {
+			switch (r) {
+			case RingResult::Ok: return H2N_STATUS_OK;
+			case RingResult::Full: return H2N_STATUS_QUEUE_FULL;
+			case RingResult::TooLarge: return H2N_STATUS_TRUNCATED;
+			default: return H2N_STATUS_CONSUMER_ABSENT;
+			}
+		}
+
+		// Runs append on a writer over a ring record of bound bytes and commits the bytes written.
+		// A bound over MaxRecord may still leave room for the frame itself: it is encoded in a per
+		// thread buffer and written with its exact size. A full ring fails before encoding anything.
+		template<class Append>
+		int Encode(SharedRing* ring, size_t bound, Append append) {
+			uint8_t* slot;
+			const RingResult r = ring->Reserve(bound, slot);
+			if (r == RingResult::Ok) {
+				WireWriter w(slot, bound);
+				append(w);
+				if (w.data() == slot) {
+					ring->Commit(slot, w.size(), bound);
+					return H2N_STATUS_OK;
+				}
+				ring->Cancel(slot, bound);
+			}
+			else if (r == RingResult::Full) {
+				// nothing frees space in the ring of a dead consumer
+				return Alive(ring) ? H2N_STATUS_QUEUE_FULL : H2N_STATUS_CONSUMER_ABSENT;
+			}
+			else if (r != RingResult::TooLarge) {
+				return Status(r);
+			}
+			WireWriter& w = Writer();
+			w.Clear();
+			append(w);
+			const RingResult written = ring->Write(w.data(), w.size());
+			if (written == RingResult::Full && !Alive(ring))
+				return H2N_STATUS_CONSUMER_ABSENT;
+			return Status(written);
+		}
+
+		// keeps the capacity of the largest message sent by the thread
+		static WireWriter& Writer() {
+			static thread_local WireWriter writer;
+			return writer;
+		}
+	};
+
+#ifdef H2NAPI_HEADER_ONLY
+	namespace detail {
+		template<class Message>
+		inline int SendLocal(const Message& msg) {
+			return LocalTransport::Instance().Send(msg);
+		}
+	}
+#endif
+}
+
+#if defined(H2NAPI_HEADER_ONLY) || defined(H2NAPI_LOCAL_IMPLEMENTATION)
+
+extern "C" {
+
+H2N_API int h2n_is_running() {
+	Hand2Note::SharedRing* ring = Hand2Note::LocalTransport::Instance().Ring();
+	return ring && ring->CheckConsumer() ? 1 : 0;
+}
+
+// a read of the ring header, the consumer process is checked at most every 100 ms
+H2N_API int h2n_consumer_attached() {
+	return Hand2Note::LocalTransport::Instance().ConsumerAttached() ? 1 : 0;
+}
+
+H2N_API int h2n_queue_usage(unsigned int* used, unsigned int* capacity) {
+	return Hand2Note::LocalTransport::Instance().QueueUsage(used, capacity);
+}
+
+H2N_API int h2n_wait_writable(unsigned int bytes, int timeout_ms) {
+	return Hand2Note::LocalTransport::Instance().WaitWritable(bytes, timeout_ms);
+}
+
+// 'XXXXnnnnnnnn' like Hand2Note: the room prefix and a hash of the original name
+H2N_API char* h2n_make_table_name(int room, const char* original_name) {
+	uint32_t hash = 2166136261u;
+	for (const char* p = original_name ? original_name : ""; *p; ++p)
+		hash = (hash ^ (uint8_t)*p) * 16777619u;
+	char buf[32];
+	const char* prefix = Hand2Note::LocalTransport::TablePrefix(room);
+	if (prefix)
+		snprintf(buf, sizeof(buf), "%s%u", prefix, hash);
+	else
+		snprintf(buf, sizeof(buf), "H2N%d_%u", room, hash);
+	char* ret = (char*)malloc(strlen(buf) + 1);
+	if (ret)
+		strcpy(ret, buf);
+	return ret;
+}
+
+H2N_API void h2n_free_cstring(char* str) {
+	free(str);
+}
+
+H2N_API int h2n_send_handhistory(h2n_hh_message* msg) {
+	return msg ? Hand2Note::LocalTransport::Instance().Send(*msg) : H2N_STATUS_INVALID_MESSAGE;
+}
+
+H2N_API int h2n_send_hand_start(h2n_start_hand_message* msg) {
+	return msg ? Hand2Note::LocalTransport::Instance().Send(*msg) : H2N_STATUS_INVALID_MESSAGE;
+}
+
+H2N_API int h2n_send_action(h2n_action_message* msg) {
+	return msg ? Hand2Note::LocalTransport::Instance().Send(*msg) : H2N_STATUS_INVALID_MESSAGE;
+}
+
+H2N_API int h2n_send_street(h2n_street_message* msg) {
+	return msg ? Hand2Note::LocalTransport::Instance().Send(*msg) : H2N_STATUS_INVALID_MESSAGE;
+}
+
+H2N_API int h2n_send_json(const char* json_str) {
+	return Hand2Note::LocalTransport::Instance().SendJson(json_str);
+}
+
+H2N_API int h2n_send_command(int table_hwnd, int room_id, int cmd) {
+	return Hand2Note::LocalTransport::Instance().SendCommand(table_hwnd, room_id, cmd);
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,406 @@
+#ifndef _H2NAPIRINGHPP__
+#define _H2NAPIRINGHPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <signal.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Hand2Note {
+
+	enum class RingResult : int
+	{
+		Ok = 0,
+		Full,       // not enough free space, nothing was written
+		TooLarge,   // the record can never fit, it is larger than half of the ring
+		NotOpen,
+	};
+
+	// Multi-producer, single-consumer ring of byte records in named shared memory, the local
+	// transport of the h2napi functions where there is no h2napi.dll.
+	//
+	// The memory is a Header followed by Capacity() bytes of records. A record is an 8 byte
+	// header (atomic uint32_t flags and size, zero while it is being written) and the payload padded
+	// to 8 bytes. Producers reserve space by moving Header::head with a CAS, write the payload
+	// and publish the size with one release store. A record never wraps: the space left at
+	// the end is taken by a skip record. The consumer reads records at Header::tail, zeroes
+	// them and moves the tail, so free space always reads as zero.
+	//
+	//	SharedRing ring;
+	//	ring.Open("/h2napi", SharedRing::DefaultCapacity, true);
+	//	ring.Attach();
+	//	ring.Poll([](const uint8_t* data, size_t size) { ... });
+	class SharedRing {
+	public:
+		static const char* DefaultName() { return "/h2napi"; }
+		static const size_t DefaultCapacity = (size_t)1 << 22;
+		static const size_t AnyCapacity = 0;    // Open an existing ring at the capacity it was created with
+		static const uint32_t Magic = 0x524E3248;    // "H2NR"
+		static const uint32_t Version = 1;
+
+		SharedRing() : header_(nullptr), data_(nullptr), capacity_(0) {}
+		~SharedRing() { Close(); }
+
+		SharedRing(const SharedRing&) = delete;
+		SharedRing& operator=(const SharedRing&) = delete;
+
+		// Maps the ring called name (a POSIX shared memory name or a Windows mapping name).
+		// Without create an existing ring is opened, its capacity must be the same unless it is
+		// AnyCapacity. capacity is a power of two from 4 KiB to 1 GiB.
+		bool Open(const char* name, size_t capacity = DefaultCapacity, bool create = false) {
+			Close();
+			if (capacity == AnyCapacity ? create : !IsCapacity(capacity))
+				return false;
+			size_t size = sizeof(Header) + capacity;
+#ifdef _WIN32
+			mapping_ = create ?
+				CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name) :
+				OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+			// a view of size 0 maps the whole ring, the capacity is read from its header
+			void* p = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, capacity == AnyCapacity ? 0 : size) : nullptr;
+			if (!p) {
+				Close();
+				return false;
+			}
+			if (capacity == AnyCapacity) {
+				MEMORY_BASIC_INFORMATION info;
+				size = VirtualQuery(p, &info, sizeof(info)) ? (size_t)info.RegionSize : 0;
+			}
+#else
+			int fd = shm_open(name, O_RDWR | (create ? O_CREAT : 0), 0600);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			bool sized = fstat(fd, &st) == 0;
+			if (sized && capacity == AnyCapacity)
+				size = (size_t)st.st_size;
+			// a ring created at the same moment by another process has the same size or fails the capacity check
+			sized = sized && size > sizeof(Header) && (st.st_size == (off_t)size || (st.st_size == 0 && ftruncate(fd, (off_t)size) == 0));
+			void* p = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+			close(fd);
+			if (p == MAP_FAILED)
+				return false;
+			size_ = size;
+			dev_ = st.st_dev;
+			ino_ = st.st_ino;
+#endif
+			header_ = (Header*)p;
+			data_ = (uint8_t*)p + sizeof(Header);
+			capacity_ = capacity;
+			if (capacity == AnyCapacity ? !Adopt(size) : !Initialize()) {
+				Close();
+				return false;
+			}
+			tail_.store(header_->tail.load(std::memory_order_acquire), std::memory_order_release);
+			return true;
+		}
+
+		void Close() {
+#ifdef _WIN32
+			if (header_)
+				UnmapViewOfFile(header_);
+			if (mapping_)
+				CloseHandle(mapping_);
+			mapping_ = nullptr;
+#else
+			if (header_)
+				munmap(header_, size_);
+#endif
+			header_ = nullptr;
+			data_ = nullptr;
+			capacity_ = 0;
+		}
+
+		// Deletes the name, processes that have the ring open keep using it
+		static void Remove(const char* name) {
+#ifdef _WIN32
+			(void)name;
+#else
+			shm_unlink(name);
+#endif
+		}
+
+		bool IsOpen() const { return header_ != nullptr; }
+
+		// Whether name still refers to this ring, false once it was removed or created anew.
+		// A Windows mapping lives while any process has it open and can't be replaced.
+		bool IsNamed(const char* name) const {
+#ifdef _WIN32
+			(void)name;
+			return header_ != nullptr;
+#else
+			if (!header_)
+				return false;
+			int fd = shm_open(name, O_RDONLY, 0);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			const bool same = fstat(fd, &st) == 0 && st.st_dev == dev_ && st.st_ino == ino_;
+			close(fd);
+			return same;
+#endif
+		}
+		size_t Capacity() const { return capacity_; }
+
+		// Bytes of records not read by the consumer yet
+		size_t Used() const {
+			return header_ ? (size_t)(header_->head.load(std::memory_order_acquire) - header_->tail.load(std::memory_order_acquire)) : 0;
+		}
+
+		// Payload bytes a single record can hold
+		size_t MaxRecord() const { return capacity_ / 2 - RecordHeader; }
+
+		// true if some process called Attach and didn't Detach yet, one load without a system call
+		bool ConsumerAttached() const {
+			return header_ && header_->consumer.load(std::memory_order_relaxed) != 0;
+		}
+
+		// ConsumerAttached, and the consumer process is still alive
+		bool ConsumerAlive() const {
+			if (!header_)
+				return false;
+			uint32_t pid = header_->consumer.load(std::memory_order_acquire);
+			return pid && ProcessAlive(pid);
+		}
+
+		// ConsumerAlive, and detaches a consumer that exited without Detach so that
+		// ConsumerAttached reads false again
+		bool CheckConsumer() {
+			if (!header_)
+				return false;
+			uint32_t pid = header_->consumer.load(std::memory_order_acquire);
+			if (!pid || ProcessAlive(pid))
+				return pid != 0;
+			// fails, leaving pid the new one, if another consumer attached in the meantime
+			return !header_->consumer.compare_exchange_strong(pid, 0, std::memory_order_acq_rel) && pid != 0;
+		}
+
+		// Whether Reserve(size) would succeed now, without reserving anything
+		RingResult Writable(size_t size) const {
+			if (!header_)
+				return RingResult::NotOpen;
+			if (size > MaxRecord())
+				return RingResult::TooLarge;
+			const uint64_t need = RecordHeader + Align(size);
+			const uint64_t head = header_->head.load(std::memory_order_relaxed);
+			const uint64_t room = capacity_ - (head & (capacity_ - 1));
+			const uint64_t pad = room < need ? room : 0;
+			return head + pad + need - header_->tail.load(std::memory_order_acquire) > capacity_ ? RingResult::Full : RingResult::Ok;
+		}
+
+		// Reserves a record of size bytes, the payload is written to data and published with Commit
+		RingResult Reserve(size_t size, uint8_t*& data) {
+			if (!header_)
+				return RingResult::NotOpen;
+			if (size > MaxRecord())
+				return RingResult::TooLarge;
+			const uint64_t need = RecordHeader + Align(size);
+			uint64_t head = header_->head.load(std::memory_order_relaxed);
+			uint64_t pad;
+			do {
+				uint64_t room = capacity_ - (head & (capacity_ - 1));
+				pad = room < need ? room : 0;
+				// the tail only moves forward, the consumer's cache line is read only when the
+				// last tail seen leaves too little space
+				if (head + pad + need - tail_.load(std::memory_order_acquire) > capacity_) {
+					uint64_t tail = header_->tail.load(std::memory_order_acquire);
+					tail_.store(tail, std::memory_order_release);
+					if (head + pad + need - tail > capacity_)
+						return RingResult::Full;
+				}
+			} while (!header_->head.compare_exchange_weak(head, head + pad + need, std::memory_order_acq_rel, std::memory_order_relaxed));
+			if (pad)
+				Word(head).store((uint32_t)pad | Skip, std::memory_order_release);
+			data = data_ + ((head + pad) & (capacity_ - 1)) + RecordHeader;
+			return RingResult::Ok;
+		}
+
+		// Publishes a reserved record, size is the one given to Reserve
+		void Commit(uint8_t* data, size_t size) {
+			reinterpret_cast<std::atomic<uint32_t>*>(data - RecordHeader)->store((uint32_t)size | Data, std::memory_order_release);
+		}
+
+		// Publishes the first size bytes of a record reserved with reserved >= size bytes, for
+		// payloads encoded in place whose exact size is only known afterwards. The rest of the
+		// reservation becomes a skip record, published by the same release store.
+		void Commit(uint8_t* data, size_t size, size_t reserved) {
+			const uint64_t rest = Align(reserved) - Align(size);
+			if (rest)
+				reinterpret_cast<std::atomic<uint32_t>*>(data + Align(size))->store((uint32_t)rest | Skip, std::memory_order_relaxed);
+			Commit(data, size);
+		}
+
+		// Gives up a reserved record, the consumer skips it
+		void Cancel(uint8_t* data, size_t reserved) {
+			reinterpret_cast<std::atomic<uint32_t>*>(data - RecordHeader)->store((uint32_t)(RecordHeader + Align(reserved)) | Skip, std::memory_order_release);
+		}
+
+		RingResult Write(const void* data, size_t size) {
+			uint8_t* p;
+			RingResult r = Reserve(size, p);
+			if (r != RingResult::Ok)
+				return r;
+			memcpy(p, data, size);
+			Commit(p, size);
+			return RingResult::Ok;
+		}
+
+		// Makes this process the consumer, false if another live process is attached
+		bool Attach() {
+			if (!header_)
+				return false;
+			const uint32_t self = CurrentProcess();
+			uint32_t pid = header_->consumer.load(std::memory_order_acquire);
+			for (;;) {
+				if (pid == self)
+					return true;
+				if (pid && ProcessAlive(pid))
+					return false;
+				if (header_->consumer.compare_exchange_weak(pid, self, std::memory_order_acq_rel))
+					return true;
+			}
+		}
+
+		void Detach() {
+			uint32_t self = CurrentProcess();
+			if (header_)
+				header_->consumer.compare_exchange_strong(self, 0, std::memory_order_acq_rel);
+		}
+
+		// Consumer: calls fn(const uint8_t* data, size_t size) for every published record in order,
+		// at most max of them. Returns the number of records read.
+		template<class Fn>
+		size_t Poll(Fn fn, size_t max = (size_t)-1) {
+			if (!header_)
+				return 0;
+			uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+			size_t n = 0;
+			while (n < max) {
+				uint32_t word = Word(tail).load(std::memory_order_acquire);
+				if (!word)
+					break;
+				uint8_t* record = data_ + (tail & (capacity_ - 1));
+				uint64_t len;
+				if (word & Skip) {
+					len = word & ~Skip;
+				}
+				else {
+					word &= ~Data;
+					len = RecordHeader + Align(word);
+					fn((const uint8_t*)record + RecordHeader, (size_t)word);
+					++n;
+				}
+				memset(record, 0, (size_t)len);
+				tail += len;
+				header_->tail.store(tail, std::memory_order_release);
+			}
+			return n;
+		}
+
+	private:
+		static const uint32_t Initializing = 1;
+		static const uint32_t Skip = 0x80000000u;
+		static const uint32_t Data = 0x40000000u;
+		static const size_t RecordHeader = 8;
+
+		struct Header {
+			std::atomic<uint32_t> magic;
+			uint32_t              version;
+			uint64_t              capacity;
+			alignas(64) std::atomic<uint64_t> head;     // reserved by producers
+			alignas(64) std::atomic<uint64_t> tail;     // read by the consumer
+			alignas(64) std::atomic<uint32_t> consumer; // process id, 0 when there is no consumer
+		};
+
+		Header*  header_;
+		uint8_t* data_;
+		size_t   capacity_;
+		std::atomic<uint64_t> tail_{ 0 };    // Header::tail as last read by Reserve
+#ifdef _WIN32
+		HANDLE   mapping_ = nullptr;
+#else
+		size_t   size_ = 0;
+		dev_t    dev_ = 0;    // identify the shared memory object, see IsNamed
+		ino_t    ino_ = 0;
+#endif
+
+		static uint64_t Align(uint64_t n) { return (n + 7) & ~(uint64_t)7; }
+
+		static bool IsCapacity(uint64_t capacity) {
+			return capacity >= 4096 && capacity <= ((uint64_t)1 << 30) && !(capacity & (capacity - 1));
+		}
+
+		std::atomic<uint32_t>& Word(uint64_t pos) {
+			return *reinterpret_cast<std::atomic<uint32_t>*>(data_ + (pos & (capacity_ - 1)));
+		}
+
+		// new memory is zero, the first process to map it writes the header
+		bool Initialize() {
+			uint32_t magic = 0;
+			if (header_->magic.compare_exchange_strong(magic, Initializing, std::memory_order_acq_rel)) {
+				header_->version = Version;
+				header_->capacity = capacity_;
+				header_->magic.store(Magic, std::memory_order_release);
+				return true;
+			}
+			for (int i = 0; magic == Initializing && i < 1000; ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				magic = header_->magic.load(std::memory_order_acquire);
+			}
+			return magic == Magic && header_->version == Version && header_->capacity == capacity_;
+		}
+
+		// Opening at AnyCapacity: waits for the creator to write the header and takes the
+		// capacity from it, the mapping of size bytes must hold all of it
+		bool Adopt(size_t size) {
+			uint32_t magic = header_->magic.load(std::memory_order_acquire);
+			for (int i = 0; magic == Initializing && i < 1000; ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				magic = header_->magic.load(std::memory_order_acquire);
+			}
+			if (magic != Magic || header_->version != Version || !IsCapacity(header_->capacity) || sizeof(Header) + header_->capacity > size)
+				return false;
+			capacity_ = (size_t)header_->capacity;
+			return true;
+		}
+
+		static uint32_t CurrentProcess() {
+#ifdef _WIN32
+			return (uint32_t)GetCurrentProcessId();
+#else
+			return (uint32_t)getpid();
+#endif
+		}
+
+		static bool ProcessAlive(uint32_t pid) {
+#ifdef _WIN32
+			HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+			if (!process)
+				return false;
+			bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+			CloseHandle(process);
+			return alive;
+#else
+			return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,757 @@
+#ifndef _H2NAPISTATSHPP__
+#define _H2NAPISTATSHPP__
+
+#include "h2napi.hpp"
+#include <unordered_map>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Hand2Note {
+
+	// Player counters of StatsAggregator. Every stat is counted at most once per hand,
+	// the opportunities (Hands, ThreeBetOpportunity, CbetOpportunity) are the denominators.
+	enum class Stat : int
+	{
+		Hands = 0,            // hands dealt in (not sitting out)
+		Vpip,                 // called, bet or raised preflop
+		Pfr,                  // bet or raised preflop
+		ThreeBetOpportunity,  // acted preflop facing exactly one raise
+		ThreeBet,             // reraised facing exactly one raise
+		CbetOpportunity,      // preflop aggressor first to bet on the flop
+		Cbet,                 // bet the flop as the preflop aggressor
+		Count
+	};
+
+	// Streaming VPIP / PFR / 3bet / c-bet counters keyed by (room, player), fed with the same
+	// messages that are sent to Hand2Note. Players are identified by SeatInfo::PlayerId, or by
+	// the nickname when the room has no player ids.
+	//
+	// Counters are stored by column, one uint32_t array per Stat indexed by player row, so
+	// queries over all players (Select, Sum) are SSE2 scans of two arrays.
+	//
+	//	stats.Start(start);
+	//	stats.Apply(action); stats.Apply(street); ...
+	//	stats.Select(Stat::Vpip, 0.4, 1.0, 100, rows); // loose players with 100+ hands
+	class StatsAggregator {
+	public:
+		// tables is the number of tables played at once, a new hand evicts the previous one of its
+		// table: the same table_hwnd, or the same table name for hands without one
+		explicit StatsAggregator(size_t tables = 1024) : hands_(tables), journal_(false) {}
+
+		size_t Size() const { return player_ids_.size(); }
+
+		// Forgets all players and live hands
+		void Clear() {
+			hands_.Clear();
+			rows_.clear();
+			for (auto& col : columns_)
+				col.clear();
+			rooms_.clear();
+			player_ids_.clear();
+			nicknames_.clear();
+			delta_.clear();
+		}
+
+		// Row of the player, -1 if unknown
+		int Find(Room room, uint64_t player_id) const {
+			auto it = rows_.find(Key(room, player_id, std::string()));
+			return it == rows_.end() ? -1 : (int)it->second;
+		}
+
+		int Find(Room room, const std::string& nickname) const {
+			auto it = rows_.find(Key(room, 0, nickname));
+			return it == rows_.end() ? -1 : (int)it->second;
+		}
+
+		Room PlayerRoom(size_t row) const { return rooms_[row]; }
+		uint64_t PlayerId(size_t row) const { return player_ids_[row]; }
+		const std::string& Nickname(size_t row) const { return nicknames_[row]; }
+
+		uint32_t Get(size_t row, Stat stat) const { return columns_[(int)stat][row]; }
+		const uint32_t* Column(Stat stat) const { return columns_[(int)stat].data(); }
+
+		// Denominator of the stat, the stat itself for opportunities
+		static Stat Opportunities(Stat stat) {
+			switch (stat) {
+			case Stat::Vpip:
+			case Stat::Pfr: return Stat::Hands;
+			case Stat::ThreeBet: return Stat::ThreeBetOpportunity;
+			case Stat::Cbet: return Stat::CbetOpportunity;
+			default: return stat;
+			}
+		}
+
+		// stat / opportunities of the row, 0 without opportunities
+		double Ratio(size_t row, Stat stat) const {
+			uint32_t den = Get(row, Opportunities(stat));
+			return den ? (double)Get(row, stat) / den : 0;
+		}
+
+		// Starts a hand, adds the seated players and counts their hands.
+		// Seats without player id and nickname are not tracked.
+		TrackResult Start(const HandStartMessage& msg) {
+			Hand* hand = hands_.Insert(msg.GameId(), Table(msg));
+			if (!hand)
+				return TrackResult::UnknownHand;
+			memset(hand, 0, sizeof(*hand));
+			hand->street = H2N_STREET_PREFLOP;
+			hand->aggressor = -1;
+			TrackResult result = TrackResult::Ok;
+			const HandStartMessage::SeatsList& seats = msg.Seats();
+			for (size_t i = 0; i < seats.size(); ++i) {
+				const SeatInfo& s = seats[i];
+				int idx = s.SeatIndex();
+				if (idx < 0 || idx >= H2N_MAX_SEATS) {
+					result = TrackResult::InvalidSeat;
+					continue;
+				}
+				if (s.IsSittingOut() || (!s.PlayerId() && s.Nickname().empty()))
+					continue;
+				hand->rows[idx] = Row(msg.room(), s);
+				hand->seated_mask |= 1u << idx;
+				Count(hand->rows[idx], Stat::Hands);
+			}
+			return result;
+		}
+
+		TrackResult Apply(const HandActionMessage& msg) {
+			Hand* hand = hands_.Find(msg.GameId());
+			if (!hand)
+				return TrackResult::UnknownHand;
+			int seat = msg.SeatIndex();
+			if (seat < 0 || seat >= H2N_MAX_SEATS || !(hand->seated_mask >> seat & 1))
+				return TrackResult::InvalidSeat;
+			uint32_t row = hand->rows[seat];
+			Action action = msg.ActionType();
+			bool aggressive = action == Action::Bet || action == Action::Raise;
+
+			if (hand->street == H2N_STREET_PREFLOP) {
+				if (hand->raises == 1 && hand->aggressor != seat && action != Action::Check && Once(hand->three_bet_mask, seat)) {
+					Count(row, Stat::ThreeBetOpportunity);
+					if (aggressive)
+						Count(row, Stat::ThreeBet);
+				}
+				if ((aggressive || action == Action::Call) && Once(hand->vpip_mask, seat))
+					Count(row, Stat::Vpip);
+				if (aggressive) {
+					if (Once(hand->pfr_mask, seat))
+						Count(row, Stat::Pfr);
+					++hand->raises;
+					hand->aggressor = seat;
+				}
+			}
+			else if (hand->street == H2N_STREET_FLOP && !hand->flop_bet) {
+				if (seat == hand->aggressor && !hand->cbet_seen) {
+					hand->cbet_seen = true;
+					Count(row, Stat::CbetOpportunity);
+					if (aggressive)
+						Count(row, Stat::Cbet);
+				}
+				hand->flop_bet = aggressive;
+			}
+			return TrackResult::Ok;
+		}
+
+		TrackResult Apply(const HandStreetMessage& msg) {
+			Hand* hand = hands_.Find(msg.GameId());
+			if (!hand)
+				return TrackResult::UnknownHand;
+			int street = (int)msg.StreetType();
+			if (!Cards::BoardCount(msg.StreetType()) || street <= hand->street)
+				return TrackResult::InvalidStreet;
+			hand->street = street;
+			return TrackResult::Ok;
+		}
+
+		// Appends the rows with min_ratio <= stat / opportunities <= max_ratio and at least
+		// min_opportunities opportunities, returns the number of rows appended.
+		size_t Select(Stat stat, double min_ratio, double max_ratio, uint32_t min_opportunities, std::vector<uint32_t>& rows) const {
+			const uint32_t* num = Column(stat);
+			const uint32_t* den = Column(Opportunities(stat));
+			const size_t size = Size(), before = rows.size();
+			const float lo = (float)min_ratio, hi = (float)max_ratio;
+			const uint32_t min_den = min_opportunities ? min_opportunities : 1;
+			// every row is written, the count only advances past the matching ones
+			rows.resize(before + size);
+			uint32_t* out = rows.data() + before;
+			size_t count = 0, i = 0;
+#ifdef H2NAPI_SSE2
+			// counters stay below 2^31, signed compares are fine
+			const __m128i vmin = _mm_set1_epi32((int)min_den - 1);
+			const __m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+			for (; i + 4 <= size; i += 4) {
+				__m128i n = _mm_loadu_si128((const __m128i*)(num + i));
+				__m128i d = _mm_loadu_si128((const __m128i*)(den + i));
+				__m128 nf = _mm_cvtepi32_ps(n), df = _mm_cvtepi32_ps(d);
+				__m128 ok = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(d, vmin)),
+					_mm_and_ps(_mm_cmpge_ps(nf, _mm_mul_ps(df, vlo)), _mm_cmple_ps(nf, _mm_mul_ps(df, vhi))));
+				unsigned bits = (unsigned)_mm_movemask_ps(ok);
+				out[count] = (uint32_t)i;
+				count += bits & 1;
+				out[count] = (uint32_t)i + 1;
+				count += bits >> 1 & 1;
+				out[count] = (uint32_t)i + 2;
+				count += bits >> 2 & 1;
+				out[count] = (uint32_t)i + 3;
+				count += bits >> 3;
+			}
+#endif
+			for (; i < size; ++i) {
+				float n = (float)(int)num[i], d = (float)(int)den[i];
+				out[count] = (uint32_t)i;
+				count += den[i] >= min_den && n >= d * lo && n <= d * hi;
+			}
+			rows.resize(before + count);
+			return count;
+		}
+
+		uint64_t Sum(Stat stat) const {
+			const uint32_t* col = Column(stat);
+			const size_t size = Size();
+			uint64_t sum = 0;
+			size_t i = 0;
+#ifdef H2NAPI_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			__m128i acc = zero;
+			for (; i + 4 <= size; i += 4) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(col + i));
+				acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_unpacklo_epi32(v, zero), _mm_unpackhi_epi32(v, zero)));
+			}
+			uint64_t lanes[2];
+			_mm_storeu_si128((__m128i*)lanes, acc);
+			sum = lanes[0] + lanes[1];
+#endif
+			for (; i < size; ++i)
+				sum += col[i];
+			return sum;
+		}
+
+	private:
+		struct Hand {
+			uint32_t rows[H2N_MAX_SEATS];
+			uint32_t seated_mask;
+			uint32_t vpip_mask;       // seats already counted in the hand
+			uint32_t pfr_mask;
+			uint32_t three_bet_mask;
+			int      street;
+			int      raises;          // preflop bets and raises
+			int      aggressor;       // last preflop raiser, -1 if none
+			bool     flop_bet;
+			bool     cbet_seen;
+		};
+
+		// Delta log records kept for StatsStore while journal_ is set:
+		// varint (row << 3 | stat) for a counter increment, or varint NewPlayer followed by
+		// varint room, varint player id, varint nickname length and the nickname for a new row.
+		enum { NewPlayer = 7 };
+		static_assert((int)Stat::Count <= NewPlayer, "stat doesn't fit the delta record tag");
+
+		HandMap<Hand>                             hands_;
+		std::unordered_map<std::string, uint32_t> rows_;
+		std::string                               key_;
+		std::vector<uint32_t>                     columns_[(int)Stat::Count];
+		std::vector<Room>                         rooms_;
+		std::vector<uint64_t>                     player_ids_;
+		std::vector<std::string>                  nicknames_;
+		bool                                      journal_;
+		std::vector<uint8_t>                      delta_;
+
+		friend class StatsStore;
+
+		// room, then 'i' and the player id or 'n' and the nickname
+		static std::string& Key(std::string& key, Room room, uint64_t player_id, const std::string& nickname) {
+			int32_t r = (int32_t)room;
+			key.assign((const char*)&r, sizeof(r));
+			if (player_id) {
+				key += 'i';
+				key.append((const char*)&player_id, sizeof(player_id));
+			}
+			else {
+				key += 'n';
+				key += nickname;
+			}
+			return key;
+		}
+
+		static std::string Key(Room room, uint64_t player_id, const std::string& nickname) {
+			std::string key;
+			return Key(key, room, player_id, nickname);
+		}
+
+		// The table of a hand for hands_: the room and the window, or the room and a hash of the
+		// table name when table_hwnd is 0, as many converters leave it. Hands of one room with
+		// neither share a single table.
+		static uint64_t Table(const HandStartMessage& msg) {
+			uint64_t table = ((uint64_t)(uint32_t)msg.room() << 32);
+			if (msg.TableHwnd())
+				return table | (uint32_t)msg.TableHwnd();
+			uint32_t hash = 2166136261u;
+			const std::string& name = msg.TableName();
+			for (size_t i = 0; i < name.size(); ++i)
+				hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+			// keeps names and windows apart
+			return table | hash | (uint64_t)1 << 63;
+		}
+
+		uint32_t Row(Room room, const SeatInfo& s) {
+			// the scratch key keeps its capacity, a known player costs no allocation
+			auto it = rows_.find(Key(key_, room, s.PlayerId(), s.Nickname()));
+			if (it != rows_.end())
+				return it->second;
+			return AddPlayer(room, s.PlayerId(), s.Nickname());
+		}
+
+		// key_ holds the key of the player
+		uint32_t AddPlayer(Room room, uint64_t player_id, const std::string& nickname) {
+			uint32_t row = (uint32_t)player_ids_.size();
+			rows_.emplace(key_, row);
+			rooms_.push_back(room);
+			player_ids_.push_back(player_id);
+			nicknames_.push_back(nickname);
+			for (auto& col : columns_)
+				col.push_back(0);
+			if (journal_) {
+				Delta(NewPlayer);
+				Delta((uint32_t)(int32_t)room);
+				Delta(player_id);
+				Delta(nicknames_.back().size());
+				delta_.insert(delta_.end(), nicknames_.back().begin(), nicknames_.back().end());
+			}
+			return row;
+		}
+
+		void Count(uint32_t row, Stat stat) {
+			++columns_[(int)stat][row];
+			if (journal_)
+				Delta((uint64_t)row << 3 | (int)stat);
+		}
+
+		void Delta(uint64_t v) {
+			while (v >= 0x80) {
+				delta_.push_back((uint8_t)(v | 0x80));
+				v >>= 7;
+			}
+			delta_.push_back((uint8_t)v);
+		}
+
+		static bool Once(uint32_t& mask, int seat) {
+			uint32_t bit = 1u << seat;
+			if (mask & bit)
+				return false;
+			mask |= bit;
+			return true;
+		}
+	};
+
+	namespace detail {
+		// Read-only mapping of a whole file
+		class MappedFile {
+		public:
+			MappedFile() : data_(nullptr), size_(0) {}
+			~MappedFile() { Close(); }
+
+			bool Open(const char* path) {
+				Close();
+#ifdef _WIN32
+				file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file_ == INVALID_HANDLE_VALUE)
+					return false;
+				LARGE_INTEGER size;
+				if (!GetFileSizeEx(file_, &size)) {
+					Close();
+					return false;
+				}
+				size_ = (size_t)size.QuadPart;
+				if (size_) {
+					mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+					data_ = mapping_ ? (const uint8_t*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+				}
+#else
+				int fd = open(path, O_RDONLY);
+				if (fd < 0)
+					return false;
+				struct stat st;
+				if (fstat(fd, &st) != 0) {
+					close(fd);
+					return false;
+				}
+				size_ = (size_t)st.st_size;
+				if (size_) {
+					void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+					data_ = p == MAP_FAILED ? nullptr : (const uint8_t*)p;
+				}
+				close(fd);
+#endif
+				if (size_ && !data_) {
+					Close();
+					return false;
+				}
+				return true;
+			}
+
+			void Close() {
+#ifdef _WIN32
+				if (data_)
+					UnmapViewOfFile(data_);
+				if (mapping_)
+					CloseHandle(mapping_);
+				if (file_ != INVALID_HANDLE_VALUE)
+					CloseHandle(file_);
+				mapping_ = nullptr;
+				file_ = INVALID_HANDLE_VALUE;
+#else
+				if (data_)
+					munmap((void*)data_, size_);
+#endif
+				data_ = nullptr;
+				size_ = 0;
+			}
+
+			const uint8_t* Data() const { return data_; }
+			size_t Size() const { return size_; }
+
+		private:
+			const uint8_t* data_;
+			size_t         size_;
+#ifdef _WIN32
+			HANDLE         file_ = INVALID_HANDLE_VALUE;
+			HANDLE         mapping_ = nullptr;
+#endif
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+		};
+
+		// Writes the buffered data of f through to the disk
+		inline bool SyncFile(FILE* f) {
+			if (fflush(f) != 0)
+				return false;
+#ifdef _WIN32
+			return _commit(_fileno(f)) == 0;
+#else
+			return fsync(fileno(f)) == 0;
+#endif
+		}
+
+		// Atomically replaces to with from
+		inline bool ReplaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+			return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+			return rename(from.c_str(), to.c_str()) == 0;
+#endif
+		}
+
+		inline uint64_t Fnv1a(uint64_t h, const void* data, size_t size) {
+			const uint8_t* p = (const uint8_t*)data;
+			for (size_t i = 0; i < size; ++i)
+				h = (h ^ p[i]) * 0x100000001B3ull;
+			return h;
+		}
+	}
+
+	// Persistent StatsAggregator: a snapshot file of all the players and counters, and a delta log
+	// of the changes made after the snapshot. Open maps the snapshot, replays the log and starts
+	// a new snapshot generation, so a restart is ready after reading a few bytes per player.
+	//
+	// Snapshot (path): header, then the counter columns (uint32_t per player, Stat order), rooms
+	// (int32_t), player ids (uint64_t), nickname offsets (uint32_t, players + 1) and the nickname
+	// bytes, checked by FNV-1a. It is written to path.tmp, synced and renamed over path.
+	//
+	// Delta log (path.log): "H2NDELTA", the uint64_t generation of its snapshot, then one batch per
+	// Flush of [uint32_t size][uint32_t checksum][StatsAggregator delta records]. A log of another
+	// generation is already part of the snapshot and ignored; a torn batch ends the replay.
+	//
+	// Live hands are not persisted: actions of hands started before a restart are UnknownHand.
+	//
+	//	StatsAggregator stats;
+	//	StatsStore store(stats);
+	//	store.Open("players.h2nstats");
+	//	... stats.Start / Apply, store.Flush() after every hand, store.Snapshot() every few minutes
+	class StatsStore {
+	public:
+		explicit StatsStore(StatsAggregator& stats) : stats_(stats), log_(nullptr), generation_(0), log_bytes_(0), replayed_(0), torn_(false) {}
+		~StatsStore() { Close(); }
+
+		// Replaces the aggregator content with the stored one, false if the snapshot is unreadable
+		// or a new generation can't be written. A missing snapshot starts an empty store.
+		bool Open(const std::string& path) {
+			Close();
+			path_ = path;
+			generation_ = 0;
+			replayed_ = 0;
+			torn_ = false;
+			stats_.Clear();
+			if (!Load())
+				return false;
+			Replay();
+			return Snapshot();
+		}
+
+		// Appends the changes since the last Flush to the log, sync writes them through to the disk.
+		// A failed append may leave part of a batch in the log, and Replay stops there: the changes are
+		// kept and written by a snapshot instead, retried by the next Flush until one succeeds.
+		bool Flush(bool sync = false) {
+			std::vector<uint8_t>& delta = stats_.delta_;
+			if (torn_)
+				return Snapshot();
+			if (!log_)
+				return false;
+			if (delta.empty())
+				return true;
+			uint32_t head[2] = { (uint32_t)delta.size(), (uint32_t)detail::Fnv1a(FnvBasis, delta.data(), delta.size()) };
+			bool ok = fwrite(head, sizeof(head), 1, log_) == 1 && fwrite(delta.data(), 1, delta.size(), log_) == delta.size();
+			ok = (sync ? detail::SyncFile(log_) : fflush(log_) == 0) && ok;
+			if (!ok) {
+				torn_ = true;
+				return Snapshot();
+			}
+			log_bytes_ += sizeof(head) + delta.size();
+			delta.clear();
+			return true;
+		}
+
+		// Writes all players to a new snapshot and starts its delta log
+		bool Snapshot() {
+			const std::string tmp = path_ + ".tmp";
+			FILE* f = fopen(tmp.c_str(), "wb");
+			if (!f)
+				return false;
+			bool ok = Write(f, generation_ + 1);
+			ok = detail::SyncFile(f) && ok;
+			ok = fclose(f) == 0 && ok;
+			if (!ok || !detail::ReplaceFile(tmp, path_)) {
+				remove(tmp.c_str());
+				return false;
+			}
+			// the snapshot holds everything, the old log is obsolete from here on
+			++generation_;
+			stats_.delta_.clear();
+			stats_.journal_ = true;
+			if (log_)
+				fclose(log_);
+			log_bytes_ = 0;
+			log_ = fopen((path_ + ".log").c_str(), "wb");
+			if (!log_) {
+				torn_ = true;
+				return false;
+			}
+			ok = fwrite(LogMagic(), 1, 8, log_) == 8 && fwrite(&generation_, sizeof(generation_), 1, log_) == 1;
+			ok = detail::SyncFile(log_) && ok;
+			torn_ = !ok;
+			return ok;
+		}
+
+		// Flushes the log and detaches from the aggregator
+		void Close() {
+			if (log_) {
+				Flush(true);
+				fclose(log_);
+				log_ = nullptr;
+			}
+			stats_.journal_ = false;
+			stats_.delta_.clear();
+		}
+
+		uint64_t Generation() const { return generation_; }
+		// Delta bytes appended since the last snapshot, e.g. to snapshot when the log grows large
+		uint64_t LogBytes() const { return log_bytes_; }
+		// Log batches replayed by Open
+		size_t Replayed() const { return replayed_; }
+
+		static const char* Magic() { return "H2NSTATS"; }
+		static const char* LogMagic() { return "H2NDELTA"; }
+
+	private:
+		struct Header {
+			char     magic[8];
+			uint32_t version;
+			uint32_t stats;        // Stat::Count
+			uint64_t generation;
+			uint64_t players;
+			uint64_t strings;      // nickname bytes
+			uint64_t checksum;     // FNV-1a of everything after the header
+		};
+
+		enum { Version = 1 };
+		static constexpr uint64_t FnvBasis = 0xCBF29CE484222325ull;
+
+		StatsAggregator& stats_;
+		std::string      path_;
+		FILE*            log_;
+		uint64_t         generation_;
+		uint64_t         log_bytes_;
+		size_t           replayed_;
+		bool             torn_;        // the log may end with a partial batch, the next Flush snapshots
+
+		static size_t PayloadSize(uint64_t players, uint64_t strings) {
+			return (size_t)(players * (sizeof(uint32_t) * (int)Stat::Count + sizeof(int32_t) + sizeof(uint64_t) + sizeof(uint32_t))
+				+ sizeof(uint32_t) + strings);
+		}
+
+		bool Write(FILE* f, uint64_t generation) {
+			const size_t players = stats_.Size();
+			std::vector<int32_t> rooms(players);
+			std::vector<uint32_t> offsets(players + 1);
+			for (size_t i = 0; i < players; ++i) {
+				rooms[i] = (int32_t)stats_.rooms_[i];
+				offsets[i + 1] = offsets[i] + (uint32_t)stats_.nicknames_[i].size();
+			}
+
+			Header h;
+			memset(&h, 0, sizeof(h));
+			memcpy(h.magic, Magic(), 8);
+			h.version = Version;
+			h.stats = (uint32_t)Stat::Count;
+			h.generation = generation;
+			h.players = players;
+			h.strings = offsets[players];
+			h.checksum = FnvBasis;
+			// the checksum is computed over the same pieces in the same order as they are written
+			auto piece = [&](const void* data, size_t size, bool write) {
+				if (!write) {
+					h.checksum = detail::Fnv1a(h.checksum, data, size);
+					return true;
+				}
+				return !size || fwrite(data, 1, size, f) == size;
+			};
+			auto pieces = [&](bool write) {
+				bool ok = true;
+				for (const auto& col : stats_.columns_)
+					ok = piece(col.data(), players * sizeof(uint32_t), write) && ok;
+				ok = piece(rooms.data(), players * sizeof(int32_t), write) && ok;
+				ok = piece(stats_.player_ids_.data(), players * sizeof(uint64_t), write) && ok;
+				ok = piece(offsets.data(), offsets.size() * sizeof(uint32_t), write) && ok;
+				for (const std::string& name : stats_.nicknames_)
+					ok = piece(name.data(), name.size(), write) && ok;
+				return ok;
+			};
+			pieces(false);
+			return fwrite(&h, sizeof(h), 1, f) == 1 && pieces(true);
+		}
+
+		bool Load() {
+			if (FILE* f = fopen(path_.c_str(), "rb"))
+				fclose(f);
+			else
+				return true;
+			detail::MappedFile file;
+			if (!file.Open(path_.c_str()) || file.Size() < sizeof(Header))
+				return false;
+			Header h;
+			memcpy(&h, file.Data(), sizeof(h));
+			if (memcmp(h.magic, Magic(), 8) != 0 || h.version != Version || h.stats != (uint32_t)Stat::Count
+				|| h.players > UINT32_MAX || h.strings > UINT32_MAX || file.Size() != sizeof(Header) + PayloadSize(h.players, h.strings))
+				return false;
+			const uint8_t* p = file.Data() + sizeof(Header);
+			if (detail::Fnv1a(FnvBasis, p, file.Size() - sizeof(Header)) != h.checksum)
+				return false;
+
+			const size_t players = (size_t)h.players;
+			for (auto& col : stats_.columns_) {
+				col.resize(players);
+				if (players)
+					memcpy(col.data(), p, players * sizeof(uint32_t));
+				p += players * sizeof(uint32_t);
+			}
+			const uint8_t* rooms = p;
+			p += players * sizeof(int32_t);
+			stats_.player_ids_.resize(players);
+			if (players)
+				memcpy(stats_.player_ids_.data(), p, players * sizeof(uint64_t));
+			p += players * sizeof(uint64_t);
+			const uint8_t* offsets = p;
+			const char* strings = (const char*)(p + (players + 1) * sizeof(uint32_t));
+
+			stats_.rooms_.resize(players);
+			stats_.nicknames_.resize(players);
+			stats_.rows_.reserve(players);
+			for (size_t i = 0; i < players; ++i) {
+				int32_t room;
+				uint32_t begin, end;
+				memcpy(&room, rooms + i * sizeof(int32_t), sizeof(room));
+				memcpy(&begin, offsets + i * sizeof(uint32_t), sizeof(begin));
+				memcpy(&end, offsets + (i + 1) * sizeof(uint32_t), sizeof(end));
+				if (begin > end || end > h.strings) {
+					stats_.Clear();
+					return false;
+				}
+				stats_.rooms_[i] = (Room)room;
+				stats_.nicknames_[i].assign(strings + begin, end - begin);
+				stats_.rows_.emplace(StatsAggregator::Key(stats_.key_, stats_.rooms_[i], stats_.player_ids_[i], stats_.nicknames_[i]), (uint32_t)i);
+			}
+			generation_ = h.generation;
+			return true;
+		}
+
+		// Applies the log batches of the loaded generation, up to the first damaged one
+		void Replay() {
+			detail::MappedFile file;
+			if (!file.Open((path_ + ".log").c_str()) || file.Size() < 16 || memcmp(file.Data(), LogMagic(), 8) != 0)
+				return;
+			uint64_t generation;
+			memcpy(&generation, file.Data() + 8, sizeof(generation));
+			if (generation != generation_)
+				return;
+			const uint8_t* p = file.Data() + 16;
+			const uint8_t* end = file.Data() + file.Size();
+			while (end - p >= 8) {
+				uint32_t head[2];
+				memcpy(head, p, sizeof(head));
+				p += sizeof(head);
+				if (head[0] > (size_t)(end - p) || (uint32_t)detail::Fnv1a(FnvBasis, p, head[0]) != head[1] || !Apply(p, p + head[0]))
+					return;
+				p += head[0];
+				++replayed_;
+			}
+		}
+
+		static bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+			v = 0;
+			for (int shift = 0; shift < 64 && p != end; shift += 7) {
+				uint8_t b = *p++;
+				v |= (uint64_t)(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool Apply(const uint8_t* p, const uint8_t* end) {
+			while (p != end) {
+				uint64_t tag;
+				if (!ReadVarint(p, end, tag))
+					return false;
+				if (tag == StatsAggregator::NewPlayer) {
+					uint64_t room, id, len;
+					if (!ReadVarint(p, end, room) || !ReadVarint(p, end, id) || !ReadVarint(p, end, len) || len > (uint64_t)(end - p))
+						return false;
+					std::string nickname((const char*)p, (size_t)len);
+					p += len;
+					StatsAggregator::Key(stats_.key_, (Room)(int32_t)room, id, nickname);
+					stats_.AddPlayer((Room)(int32_t)room, id, nickname);
+					continue;
+				}
+				uint64_t row = tag >> 3;
+				int stat = (int)(tag & 7);
+				if (row >= stats_.Size() || stat >= (int)Stat::Count)
+					return false;
+				++stats_.columns_[stat][row];
+			}
+			return true;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,4 @@
+// h2napi functions of the source build, see include/h2napi_local.hpp
+
+#define H2NAPI_LOCAL_IMPLEMENTATION
+#include "h2napi_local.hpp"
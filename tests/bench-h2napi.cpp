@@ -0,0 +1,383 @@
+// Microbenchmarks of the public h2napi calls.
+//
+//   h2napi_bench [name filter] [--min-time seconds]
+//
+// Prints a JSON document with ns/op, cycles/op and heap allocations/op for every benchmark.
+
+#include "h2napi.hpp"
+#include "h2napi_equity.hpp"
+#include "h2napi_stats.hpp"
+#ifndef _WIN32
+	#include "h2napi_ring.hpp"
+#endif
+
+#include <new>
+#include <random>
+#include <unordered_map>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(size_t size) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+// Every pointer reaching these comes from the malloc of operator new above. GCC inlines the
+// replaced operators and warns about free on the result of new, the pairing is right.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+	#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+	inline uint64_t Cycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+	template<class T>
+	inline void DoNotOptimize(const T& value) {
+#if defined(_MSC_VER)
+		static volatile const void* sink;
+		sink = &value;
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r"(&value) : "memory");
+#endif
+	}
+
+	struct Result {
+		std::string name;
+		uint64_t iterations;
+		double ns;
+		double cycles;
+		double allocations;
+	};
+
+	class Bench {
+	public:
+		Bench(const char* filter, double min_time) : filter_(filter), min_time_(min_time) {}
+
+		template<class Fn>
+		void Run(const char* name, Fn fn) {
+			if (filter_ && !strstr(name, filter_))
+				return;
+			for (int i = 0; i < 1000; ++i)
+				fn();
+
+			uint64_t iterations = 1000;
+			for (;;) {
+				uint64_t allocs = g_allocations.load(std::memory_order_relaxed);
+				auto t0 = std::chrono::steady_clock::now();
+				uint64_t c0 = Cycles();
+				for (uint64_t i = 0; i < iterations; ++i)
+					fn();
+				uint64_t c1 = Cycles();
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+				allocs = g_allocations.load(std::memory_order_relaxed) - allocs;
+				if (seconds >= min_time_ || iterations >= (1ull << 34)) {
+					results_.push_back({ name, iterations, seconds * 1e9 / iterations,
+						(double)(c1 - c0) / iterations, (double)allocs / iterations });
+					return;
+				}
+				// aim a bit past min_time to avoid another round
+				double scale = seconds > 0 ? min_time_ * 1.2 / seconds : 100;
+				iterations = (uint64_t)(iterations * (scale < 100 ? (scale > 2 ? scale : 2) : 100));
+			}
+		}
+
+		void Print() const {
+			Hand2Note::JsonWriter json;
+			printf("{\n  \"benchmarks\": [");
+			for (size_t i = 0; i < results_.size(); ++i) {
+				const Result& r = results_[i];
+				json.Clear();
+				json.Raw("{\"name\":");
+				json.String(r.name);
+				json.Raw(",\"iterations\":");
+				json.UInt(r.iterations);
+				json.Raw(",\"ns_per_op\":");
+				json.Double(Round(r.ns));
+				json.Raw(",\"cycles_per_op\":");
+				json.Double(Round(r.cycles));
+				json.Raw(",\"allocs_per_op\":");
+				json.Double(Round(r.allocations));
+				json.Raw("}");
+				printf("%s\n    %s", i ? "," : "", json.c_str());
+			}
+			printf("\n  ]\n}\n");
+		}
+
+	private:
+		const char* filter_;
+		double min_time_;
+		std::vector<Result> results_;
+
+		static double Round(double v) { return std::floor(v * 100 + 0.5) / 100; }
+	};
+
+#ifndef _WIN32
+	// Off Windows h2napi is the local transport, a thread drains its ring so that the Send/*
+	// benchmarks measure the writes rather than the failure of a missing consumer.
+	class LocalConsumer {
+	public:
+		LocalConsumer() : done_(false) {
+			const char* env = getenv("H2NAPI_RING");
+			std::string name = env && *env ? env : Hand2Note::SharedRing::DefaultName();
+			if (!ring_.Open(name.c_str(), Hand2Note::SharedRing::DefaultCapacity, true) || !ring_.Attach())
+				return;
+			thread_ = std::thread([this] {
+				while (!done_.load(std::memory_order_relaxed)) {
+					if (!ring_.Poll([](const uint8_t*, size_t) {}))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		~LocalConsumer() {
+			done_ = true;
+			if (thread_.joinable()) {
+				thread_.join();
+				ring_.Detach();
+			}
+		}
+
+	private:
+		Hand2Note::SharedRing ring_;
+		std::atomic<bool> done_;
+		std::thread thread_;
+	};
+#endif
+
+	Hand2Note::HandStartMessage MakeHandStart() {
+		Hand2Note::HandStartMessage msg(Hand2Note::Room::PokerMaster, 2416948123, 0x00F418FE);
+		msg.TableName(Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerMaster, u8"大安上王33"));
+		msg.MaxPlayers(9);
+		msg.SetCurrency(Hand2Note::Currency::Yuan);
+		msg.SmallBlind(0.25);
+		msg.BigBlind(0.5);
+		msg.Ante(0.25);
+		const char* names[] = { u8"无能为力", u8"张琳", u8"天天大水上", u8"安排！", u8"木樽", u8"德州小丑王" };
+		const int seats[] = { 0, 2, 3, 4, 6, 7 };
+		const double stacks[] = { 109.54, 168.45, 59.26, 48.14, 247.19, 53.82 };
+		Hand2Note::HandStartMessage::SeatsList list;
+		for (int i = 0; i < 6; ++i) {
+			Hand2Note::SeatInfo s(names[i], seats[i], stacks[i], i == 5);
+			s.PlayerId(1000000 + i);
+			list.push_back(s);
+		}
+		list[4].SetDealer(true);
+		list[5].SetPostedSmallBlind(true);
+		list[5].PoketCards("Ah9c");
+		list[0].SetPostedBigBlind(true);
+		msg.Seats(list);
+		return msg;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* filter = nullptr;
+	double min_time = 0.2;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			min_time = atof(argv[++i]);
+		else
+			filter = argv[i];
+	}
+
+	Bench bench(filter, min_time);
+#ifndef _WIN32
+	// before the first h2napi call, the transport looks for a missing ring only every 100 ms
+	LocalConsumer consumer;
+#endif
+
+	const Hand2Note::HandStartMessage start = MakeHandStart();
+	Hand2Note::HandActionMessage action(2416948123, 2, Hand2Note::Action::Raise, 1, false);
+	action.Pot(3.5);
+	Hand2Note::HandStreetMessage street(2416948123, Hand2Note::Street::Turn, "5h8s7sTs");
+	street.Pot(8.82);
+	Hand2Note::HandHistoryMessage hh(Hand2Note::Room::PokerMaster, 2416948123, Hand2Note::HandHistoryFormat::PokerStars,
+		std::string("PokerStars Hand #2416948123: Hold'em No Limit ($0.25/$0.50 USD) - 2019/01/21 13:44:57 ET\n") + std::string(1500, 'x'));
+	Hand2Note::JsonWriter json;
+	json.Write(action);
+	Hand2Note::ClientStatusChecker status;
+
+	bench.Run("IsRunning", [&] { DoNotOptimize(status.IsRunning()); });
+	bench.Run("MakeTableName", [&] { DoNotOptimize(Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerMaster, u8"大安上王33")); });
+
+	bench.Run("Marshal/HandHistory", [&] { h2n_hh_message m; Hand2Note::Protocol::Marshal(hh, &m); DoNotOptimize(m); });
+	bench.Run("Marshal/HandStart", [&] { h2n_start_hand_message m; Hand2Note::Protocol::Marshal(start, &m); DoNotOptimize(m); });
+	// the same seats with interned nicknames and player ids
+	Hand2Note::HandStartMessage interned = start;
+	{
+		Hand2Note::HandStartMessage::SeatsList list = start.Seats();
+		for (Hand2Note::SeatInfo& s : list) {
+			s.InternedNickname(Hand2Note::StringInterner::Global().Intern(s.Nickname()));
+			s.InternedPlayerId(s.PlayerId());
+		}
+		interned.Seats(list);
+	}
+	bench.Run("Marshal/HandStartInterned", [&] { h2n_start_hand_message m; Hand2Note::Protocol::Marshal(interned, &m); DoNotOptimize(m); });
+	const std::string nickname = u8"德州小丑王";
+	bench.Run("Interner/Find", [&] { DoNotOptimize(Hand2Note::StringInterner::Global().Find(nickname)); });
+	bench.Run("Marshal/Action", [&] { h2n_action_message m; Hand2Note::Protocol::Marshal(action, &m); DoNotOptimize(m); });
+	bench.Run("Marshal/Street", [&] { h2n_street_message m; Hand2Note::Protocol::Marshal(street, &m); DoNotOptimize(m); });
+
+	// the frames of the local transport: through the C struct, and straight from the class into a slot of MaxSize bytes
+	Hand2Note::WireWriter wire;
+	std::vector<uint8_t> slot(64 * 1024);
+	bench.Run("Wire/HandStartStruct", [&] { h2n_start_hand_message m; Hand2Note::Protocol::Marshal(start, &m); DoNotOptimize(wire.Write(m).size()); });
+	bench.Run("Wire/HandStart", [&] {
+		Hand2Note::WireWriter w(slot.data(), Hand2Note::WireWriter::MaxSize(start));
+		DoNotOptimize(w.Append(start).size());
+	});
+	bench.Run("Wire/Action", [&] {
+		Hand2Note::WireWriter w(slot.data(), Hand2Note::WireWriter::MaxSize(action));
+		DoNotOptimize(w.Append(action).size());
+	});
+
+	bench.Run("Send/HandHistory", [&] { DoNotOptimize(Hand2Note::Protocol::SendHandHistory(hh)); });
+	bench.Run("Send/HandStart", [&] { DoNotOptimize(Hand2Note::Protocol::SendHandStart(start)); });
+	bench.Run("Send/Action", [&] { DoNotOptimize(Hand2Note::Protocol::SendHandActon(action)); });
+	bench.Run("Send/Street", [&] { DoNotOptimize(Hand2Note::Protocol::SendHandStreed(street)); });
+	bench.Run("Send/Json", [&] { DoNotOptimize(Hand2Note::Protocol::SendJson(json)); });
+	bench.Run("Send/Command", [&] { DoNotOptimize(Hand2Note::Protocol::SendCommand(0x00F418FE, Hand2Note::Room::PokerFish, Hand2Note::Command::CloseHud)); });
+
+	bench.Run("Cards/Parse", [&] { Hand2Note::CardMask m; Hand2Note::Cards::Parse(street.Board(), m); DoNotOptimize(m); });
+	bench.Run("Cards/Format", [&] { char buf[10]; DoNotOptimize(Hand2Note::Cards::Format(0x8000100040002ull, buf)); });
+
+	// random seven card hands, omaha pocket cards with a five card board
+	std::vector<Hand2Note::CardMask> hands(4096), short_hands(4096), boards(4096), pockets(4096);
+	std::mt19937_64 rnd(2416948123);
+	auto deal = [&rnd](int n, Hand2Note::CardMask deck) {
+		Hand2Note::CardMask m = 0;
+		while (Hand2Note::Cards::Size(m) < n)
+			m |= (1ull << rnd() % 52) & deck;
+		return m;
+	};
+	for (size_t i = 0; i < hands.size(); ++i) {
+		hands[i] = deal(7, ~0ull);
+		short_hands[i] = deal(7, ~Hand2Note::Cards::LowRanks);
+		boards[i] = deal(5, ~0ull);
+		pockets[i] = deal(4, ~boards[i]);
+	}
+	size_t hand = 0;
+	bench.Run("Eval/Holdem7", [&] { DoNotOptimize(Hand2Note::Evaluator::Eval(hands[++hand & 4095])); });
+	bench.Run("Eval/ShortDeck7", [&] { DoNotOptimize(Hand2Note::Evaluator::EvalShortDeck(short_hands[++hand & 4095])); });
+	bench.Run("Eval/Omaha4", [&] { ++hand; DoNotOptimize(Hand2Note::Evaluator::EvalOmaha(pockets[hand & 4095], boards[hand & 4095])); });
+
+	// preflop is sampled (20k boards here, the default is 200k), the flop is enumerated
+	Hand2Note::CardMask heads_up[2], flop;
+	Hand2Note::Cards::Parse("AhAs", heads_up[0]);
+	Hand2Note::Cards::Parse("KdKc", heads_up[1]);
+	Hand2Note::Cards::Parse("5h8s7s", flop);
+	Hand2Note::EquityCalculator equity;
+	Hand2Note::EquityOptions sampled;
+	sampled.samples = 20000;
+	bench.Run("Equity/PreflopHU", [&] { DoNotOptimize(equity.Calculate(heads_up, 2, 0, 0, sampled).equity[0]); });
+	bench.Run("Equity/FlopHU", [&] { DoNotOptimize(equity.Calculate(heads_up, 2, flop).equity[0]); });
+
+	// counters of a whole hand, then scans over 100k players
+	Hand2Note::StatsAggregator stats;
+	bench.Run("Stats/Hand", [&] {
+		typedef Hand2Note::HandActionMessage A;
+		const uint64_t id = start.GameId();
+		stats.Start(start);
+		stats.Apply(A(id, 2, Hand2Note::Action::Raise, 1));
+		for (int seat : { 3, 4, 6 })
+			stats.Apply(A(id, seat, Hand2Note::Action::Fold, 0));
+		stats.Apply(A(id, 7, Hand2Note::Action::Call, 0.75));
+		stats.Apply(A(id, 0, Hand2Note::Action::Fold, 0));
+		stats.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Flop, "5h8s7s"));
+		stats.Apply(A(id, 7, Hand2Note::Action::Check, 0));
+		stats.Apply(A(id, 2, Hand2Note::Action::Bet, 2.66));
+		DoNotOptimize(stats.Get(0, Hand2Note::Stat::Cbet));
+	});
+	Hand2Note::StatsAggregator players;
+	{
+		std::mt19937 rnd(1);
+		Hand2Note::HandStartMessage::SeatsList seats(9);
+		for (uint64_t hand = 1; players.Size() < 100000; ++hand) {
+			Hand2Note::HandStartMessage msg(Hand2Note::Room::PokerMaster, hand, (int)(hand % 1000));
+			for (int i = 0; i < 9; ++i)
+				seats[i] = Hand2Note::SeatInfo(1 + rnd() % 100000, i, 100);
+			msg.Seats(seats);
+			players.Start(msg);
+			for (int i = 0; i < 9; ++i)
+				players.Apply(Hand2Note::HandActionMessage(hand, i, rnd() % 3 ? Hand2Note::Action::Fold : Hand2Note::Action::Call, 1));
+		}
+	}
+	std::vector<uint32_t> rows;
+	rows.reserve(players.Size());
+	bench.Run("Stats/Select100k", [&] {
+		rows.clear();
+		DoNotOptimize(players.Select(Hand2Note::Stat::Vpip, 0.4, 1, 5, rows));
+	});
+	bench.Run("Stats/Sum100k", [&] { DoNotOptimize(players.Sum(Hand2Note::Stat::Vpip)); });
+
+	Hand2Note::HandHistoryComposer composer;
+	bench.Run("Compose/Hand", [&] {
+		typedef Hand2Note::HandActionMessage A;
+		const uint64_t id = start.GameId();
+		composer.Start(start);
+		composer.Apply(A(id, 2, Hand2Note::Action::Raise, 1));
+		for (int seat : { 3, 4, 6 })
+			composer.Apply(A(id, seat, Hand2Note::Action::Fold, 0));
+		composer.Apply(A(id, 7, Hand2Note::Action::Call, 0.75));
+		composer.Apply(A(id, 0, Hand2Note::Action::Fold, 0));
+		composer.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Flop, "5h8s7s"));
+		composer.Apply(A(id, 7, Hand2Note::Action::Check, 0));
+		composer.Apply(A(id, 2, Hand2Note::Action::Bet, 2.66));
+		composer.Apply(A(id, 7, Hand2Note::Action::Fold, 0));
+		DoNotOptimize(composer.Render(1548078297).size());
+	});
+
+	// gameid lookup per action with 1000 live tables, the next hand on a table replaces its previous one
+	const size_t tables = 1000;
+	std::vector<uint64_t> ids(tables);
+	for (size_t i = 0; i < tables; ++i)
+		ids[i] = 2416948123 + i * 7919;
+	std::vector<uint64_t> unordered_ids = ids;
+	Hand2Note::HandMap<double> hand_map(tables);
+	std::unordered_map<uint64_t, double> unordered;
+	for (size_t i = 0; i < tables; ++i) {
+		*hand_map.Insert(ids[i], i) = 1;
+		unordered[ids[i]] = 1;
+	}
+	size_t next = 0;
+	bench.Run("HandMap/Find", [&] { next = (next + 337) % tables; DoNotOptimize(*hand_map.Find(ids[next])); });
+	bench.Run("unordered_map/Find", [&] { next = (next + 337) % tables; DoNotOptimize(unordered.find(unordered_ids[next])->second); });
+	bench.Run("HandMap/NextHand", [&] {
+		next = (next + 337) % tables;
+		ids[next] += tables * 7919;
+		*hand_map.Insert(ids[next], next) = 1;
+	});
+	bench.Run("unordered_map/NextHand", [&] {
+		next = (next + 337) % tables;
+		unordered.erase(unordered_ids[next]);
+		unordered_ids[next] += tables * 7919;
+		unordered[unordered_ids[next]] = 1;
+	});
+
+	bench.Print();
+	return 0;
+}
@@ -0,0 +1,428 @@
+#ifndef _H2NMOCKCONSUMERHPP__
+#define _H2NMOCKCONSUMERHPP__
+
+#include "h2napi.hpp"
+
+namespace Hand2Note {
+
+	// Consumer side decoder for h2n_send_json payloads produced by JsonWriter.
+	// Decodes straight into the h2n_* C structs in a single pass, no DOM is built.
+	// Strings are unescaped into an internal buffer, so the const char* fields
+	// of the decoded struct stay valid until the next Parse call.
+	class JsonReader {
+	public:
+		enum Kind {
+			Invalid,
+			HandHistory,
+			HandStart,
+			Action,
+			Street,
+		};
+
+		JsonReader() : p_(nullptr), end_(nullptr), out_(nullptr) { Reset(); }
+
+		Kind Parse(const char* json) { return Parse(json, strlen(json)); }
+
+		Kind Parse(const char* json, size_t len) {
+			Reset();
+			// unescaped strings are never longer than the escaped ones
+			if (strings_.size() < len + 1)
+				strings_.resize(len + 1);
+			out_ = strings_.data();
+			p_ = json;
+			end_ = json + len;
+
+			Kind kind = Invalid;
+			if (!Consume('{'))
+				return Invalid;
+			if (Consume('}'))
+				return Invalid;
+			do {
+				const char* key;
+				size_t key_len;
+				if (!ReadKey(key, key_len))
+					return Invalid;
+				if (Is(key, key_len, "msg")) {
+					const char* v;
+					size_t n;
+					if (!ReadString(v, n))
+						return Invalid;
+					if (Is(v, n, "handhistory"))
+						kind = HandHistory;
+					else if (Is(v, n, "hand_start"))
+						kind = HandStart;
+					else if (Is(v, n, "action"))
+						kind = Action;
+					else if (Is(v, n, "street"))
+						kind = Street;
+					else
+						return Invalid;
+				}
+				else if (!ReadField(key, key_len))
+					return Invalid;
+			} while (Consume(','));
+			if (!Consume('}'))
+				return Invalid;
+			SkipSpaces();
+			return p_ == end_ ? kind : Invalid;
+		}
+
+		const h2n_hh_message& HandHistoryMessage() const { return hh_; }
+		const h2n_start_hand_message& HandStartMessage() const { return start_; }
+		const h2n_action_message& ActionMessage() const { return action_; }
+		const h2n_street_message& StreetMessage() const { return street_; }
+
+	private:
+		const char* p_;
+		const char* end_;
+		char* out_;
+		std::vector<char> strings_;
+
+		h2n_hh_message hh_;
+		h2n_start_hand_message start_;
+		h2n_action_message action_;
+		h2n_street_message street_;
+
+		void Reset() {
+			memset(&hh_, 0, sizeof(hh_));
+			memset(&start_, 0, sizeof(start_));
+			memset(&action_, 0, sizeof(action_));
+			memset(&street_, 0, sizeof(street_));
+			hh_.hh_formatted = hh_.hh_original = "";
+			start_.table_name = "";
+			street_.board = "";
+		}
+
+		template<size_t N>
+		static bool Is(const char* s, size_t n, const char(&lit)[N]) {
+			return n == N - 1 && memcmp(s, lit, N - 1) == 0;
+		}
+
+		// Every key is offered to all message structs, so fields may come in any order
+		// and "msg" doesn't have to be the first one.
+		bool ReadField(const char* key, size_t n) {
+			if (Is(key, n, "gameid")) {
+				double v;
+				if (!ReadNumber(v))
+					return false;
+				hh_.gameid = start_.gameid = action_.gameid = street_.gameid = v;
+				return true;
+			}
+			if (Is(key, n, "room"))
+				return ReadInt(hh_.room) && (start_.room = hh_.room, true);
+			if (Is(key, n, "is_zoom"))
+				return ReadInt(hh_.is_zoom) && (start_.is_zoom = hh_.is_zoom, true);
+			if (Is(key, n, "type"))
+				return ReadInt(action_.type) && (street_.type = action_.type, true);
+			if (Is(key, n, "pot"))
+				return ReadNumber(action_.pot) && (street_.pot = action_.pot, true);
+
+			if (Is(key, n, "format")) return ReadInt(hh_.format);
+			if (Is(key, n, "hh_formatted")) return ReadCString(hh_.hh_formatted);
+			if (Is(key, n, "hh_original")) return ReadCString(hh_.hh_original);
+
+			if (Is(key, n, "table_name")) return ReadCString(start_.table_name);
+			if (Is(key, n, "table_hwnd")) return ReadInt(start_.table_hwnd);
+			if (Is(key, n, "max_players")) return ReadInt(start_.max_players);
+			if (Is(key, n, "is_tourney")) return ReadInt(start_.is_tourney);
+			if (Is(key, n, "is_omaha")) return ReadInt(start_.is_omaha);
+			if (Is(key, n, "is_limit")) return ReadInt(start_.is_limit);
+			if (Is(key, n, "is_cap")) return ReadInt(start_.is_cap);
+			if (Is(key, n, "is_potlimit")) return ReadInt(start_.is_potlimit);
+			if (Is(key, n, "is_shortdeck")) return ReadInt(start_.is_shortdeck);
+			if (Is(key, n, "is_omahafive")) return ReadInt(start_.is_omahafive);
+			if (Is(key, n, "is_straightbeatstrips")) return ReadInt(start_.is_straightbeatstrips);
+			if (Is(key, n, "currency")) return ReadInt(start_.currency);
+			if (Is(key, n, "sb")) return ReadNumber(start_.sb);
+			if (Is(key, n, "bb")) return ReadNumber(start_.bb);
+			if (Is(key, n, "ante")) return ReadNumber(start_.ante);
+			if (Is(key, n, "straddle")) return ReadNumber(start_.straddle);
+			if (Is(key, n, "seats")) return ReadSeats();
+
+			if (Is(key, n, "seat_idx")) return ReadInt(action_.seat_idx);
+			if (Is(key, n, "amount")) return ReadNumber(action_.amount);
+			if (Is(key, n, "is_allin")) return ReadInt(action_.is_allin);
+
+			if (Is(key, n, "board")) return ReadCString(street_.board);
+
+			return SkipValue();
+		}
+
+		bool ReadSeats() {
+			if (!Consume('['))
+				return false;
+			if (Consume(']'))
+				return true;
+			do {
+				if (start_.seats_num >= H2N_MAX_SEATS)
+					return false;
+				h2n_seat_info& s = start_.seats[start_.seats_num++];
+				s.nickname = s.player_id = s.pocket_cards = "";
+				if (!Consume('{'))
+					return false;
+				if (Consume('}'))
+					continue;
+				do {
+					const char* key;
+					size_t n;
+					if (!ReadKey(key, n))
+						return false;
+					bool ok;
+					if (Is(key, n, "seat_idx")) ok = ReadInt(s.seat_idx);
+					else if (Is(key, n, "nickname")) ok = ReadCString(s.nickname);
+					else if (Is(key, n, "player_id")) ok = ReadCString(s.player_id);
+					else if (Is(key, n, "stack")) ok = ReadNumber(s.stack);
+					else if (Is(key, n, "pocket_cards")) ok = ReadCString(s.pocket_cards);
+					else if (Is(key, n, "is_dealer")) ok = ReadInt(s.is_dealer);
+					else if (Is(key, n, "is_posted_sb")) ok = ReadInt(s.is_posted_sb);
+					else if (Is(key, n, "is_posted_bb")) ok = ReadInt(s.is_posted_bb);
+					else if (Is(key, n, "is_posted_sb_outofqueue")) ok = ReadInt(s.is_posted_sb_outofqueue);
+					else if (Is(key, n, "is_posted_bb_outofqueue")) ok = ReadInt(s.is_posted_bb_outofqueue);
+					else if (Is(key, n, "is_posted_straddle")) ok = ReadInt(s.is_posted_straddle);
+					else if (Is(key, n, "is_hero")) ok = ReadInt(s.is_hero);
+					else if (Is(key, n, "is_sitting_out")) ok = ReadInt(s.is_sitting_out);
+					else ok = SkipValue();
+					if (!ok)
+						return false;
+				} while (Consume(','));
+				if (!Consume('}'))
+					return false;
+			} while (Consume(','));
+			return Consume(']');
+		}
+
+		void SkipSpaces() {
+			while (p_ != end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+				++p_;
+		}
+
+		bool Consume(char c) {
+			SkipSpaces();
+			if (p_ == end_ || *p_ != c)
+				return false;
+			++p_;
+			return true;
+		}
+
+		bool ReadKey(const char*& key, size_t& n) {
+			return ReadString(key, n) && Consume(':');
+		}
+
+		bool ReadCString(const char*& s) {
+			size_t n;
+			return ReadString(s, n);
+		}
+
+		// Unescapes the string into strings_ and zero terminates it.
+		bool ReadString(const char*& s, size_t& n) {
+			if (!Consume('"'))
+				return false;
+			char* start = out_;
+			for (;;) {
+#ifdef H2NAPI_SSE2
+				const __m128i quote = _mm_set1_epi8('"');
+				const __m128i backslash = _mm_set1_epi8('\\');
+				while (end_ - p_ >= 16) {
+					__m128i chunk = _mm_loadu_si128((const __m128i*)p_);
+					uint32_t mask = (uint32_t)_mm_movemask_epi8(
+						_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+					if (!mask) {
+						memcpy(out_, p_, 16);
+						out_ += 16;
+						p_ += 16;
+						continue;
+					}
+					unsigned k = detail::CountTrailingZeros(mask);
+					memcpy(out_, p_, k);
+					out_ += k;
+					p_ += k;
+					break;
+				}
+#endif
+				while (p_ != end_ && *p_ != '"' && *p_ != '\\')
+					*out_++ = *p_++;
+				if (p_ == end_)
+					return false;
+				if (*p_++ == '"')
+					break;
+				if (p_ == end_ || !Unescape())
+					return false;
+			}
+			*out_++ = 0;
+			s = start;
+			n = out_ - start - 1;
+			return true;
+		}
+
+		bool Unescape() {
+			char c = *p_++;
+			switch (c) {
+			case '"': case '\\': case '/': *out_++ = c; return true;
+			case 'b': *out_++ = '\b'; return true;
+			case 'f': *out_++ = '\f'; return true;
+			case 'n': *out_++ = '\n'; return true;
+			case 'r': *out_++ = '\r'; return true;
+			case 't': *out_++ = '\t'; return true;
+			case 'u': break;
+			default: return false;
+			}
+			uint32_t cp;
+			if (!ReadHex4(cp))
+				return false;
+			if (cp >= 0xD800 && cp < 0xDC00) {
+				uint32_t low;
+				if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+					return false;
+				p_ += 2;
+				if (!ReadHex4(low) || low < 0xDC00 || low > 0xDFFF)
+					return false;
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+			}
+			// utf8 of an escaped code point is at most as long as the escape sequence itself
+			if (cp < 0x80)
+				*out_++ = (char)cp;
+			else if (cp < 0x800) {
+				*out_++ = (char)(0xC0 | (cp >> 6));
+				*out_++ = (char)(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000) {
+				*out_++ = (char)(0xE0 | (cp >> 12));
+				*out_++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+				*out_++ = (char)(0x80 | (cp & 0x3F));
+			}
+			else {
+				*out_++ = (char)(0xF0 | (cp >> 18));
+				*out_++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+				*out_++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+				*out_++ = (char)(0x80 | (cp & 0x3F));
+			}
+			return true;
+		}
+
+		bool ReadHex4(uint32_t& v) {
+			if (end_ - p_ < 4)
+				return false;
+			v = 0;
+			for (int i = 0; i < 4; ++i) {
+				char c = *p_++;
+				v <<= 4;
+				if (c >= '0' && c <= '9') v |= c - '0';
+				else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+				else return false;
+			}
+			return true;
+		}
+
+		bool ReadInt(int& v) {
+			double d;
+			if (!ReadNumber(d))
+				return false;
+			v = std::isfinite(d) ? (int)d : 0;
+			return true;
+		}
+
+		// Numbers with up to 15 significant digits and no exponent (everything JsonWriter
+		// produces for money amounts) are converted exactly without strtod.
+		bool ReadNumber(double& v) {
+			static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+				1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			SkipSpaces();
+			// JsonWriter writes non finite amounts as null
+			if (end_ - p_ >= 4 && memcmp(p_, "null", 4) == 0) {
+				p_ += 4;
+				v = NAN;
+				return true;
+			}
+			const char* start = p_;
+			bool negative = p_ != end_ && *p_ == '-';
+			if (negative)
+				++p_;
+			uint64_t mantissa = 0;
+			int digits = 0, frac_digits = 0;
+			while (p_ != end_ && *p_ >= '0' && *p_ <= '9') {
+				mantissa = mantissa * 10 + (*p_++ - '0');
+				++digits;
+			}
+			if (p_ != end_ && *p_ == '.') {
+				++p_;
+				while (p_ != end_ && *p_ >= '0' && *p_ <= '9') {
+					mantissa = mantissa * 10 + (*p_++ - '0');
+					++frac_digits;
+				}
+			}
+			if (digits + frac_digits == 0)
+				return false;
+			bool exponent = p_ != end_ && (*p_ == 'e' || *p_ == 'E');
+			if (!exponent && digits + frac_digits <= 15) {
+				v = (double)mantissa / pow10[frac_digits];
+				if (negative)
+					v = -v;
+				return true;
+			}
+			if (exponent) {
+				++p_;
+				if (p_ != end_ && (*p_ == '+' || *p_ == '-'))
+					++p_;
+				while (p_ != end_ && *p_ >= '0' && *p_ <= '9')
+					++p_;
+			}
+			char tmp[64];
+			size_t n = p_ - start;
+			if (n >= sizeof(tmp))
+				return false;
+			memcpy(tmp, start, n);
+			tmp[n] = 0;
+			v = strtod(tmp, nullptr);
+			return true;
+		}
+
+		bool SkipValue() {
+			SkipSpaces();
+			if (p_ == end_)
+				return false;
+			switch (*p_) {
+			case '"': {
+				const char* s;
+				size_t n;
+				return ReadString(s, n);
+			}
+			case '{':
+			case '[': {
+				char close = *p_ == '{' ? '}' : ']';
+				++p_;
+				if (Consume(close))
+					return true;
+				do {
+					if (close == '}') {
+						const char* key;
+						size_t n;
+						if (!ReadKey(key, n))
+							return false;
+					}
+					if (!SkipValue())
+						return false;
+				} while (Consume(','));
+				return Consume(close);
+			}
+			case 't': return SkipLiteral("true");
+			case 'f': return SkipLiteral("false");
+			case 'n': return SkipLiteral("null");
+			default: {
+				double d;
+				return ReadNumber(d);
+			}
+			}
+		}
+
+		bool SkipLiteral(const char* lit) {
+			size_t n = strlen(lit);
+			if ((size_t)(end_ - p_) < n || memcmp(p_, lit, n) != 0)
+				return false;
+			p_ += n;
+			return true;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "catch.hpp"
+#include "h2napi.hpp"
+#include "h2napi_ring.hpp"
+
+#include <sys/wait.h>
+
+// the h2napi functions of h2napi_local.hpp, from the h2napi library or inline with H2NAPI_HEADER_ONLY,
+// the test is the consumer of their ring
+
+namespace {
+
+	// A ring name of the test case's own that H2NAPI_RING points the producers to, so that a
+	// test never touches the ring of a running consumer. The name is removed however the test ends.
+	struct TestRingName {
+		const std::string name;
+
+		explicit TestRingName(const char* test)
+			: name(std::string("/h2napi-test-") + test + "-" + std::to_string(getpid())) {
+			Hand2Note::SharedRing::Remove(name.c_str());
+			setenv("H2NAPI_RING", name.c_str(), 1);
+		}
+		~TestRingName() { Hand2Note::SharedRing::Remove(name.c_str()); }
+
+		const char* c_str() const { return name.c_str(); }
+	};
+}
+
+TEST_CASE("TestLocalTransport")
+{
+	const TestRingName name("local");
+
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123, 0x00F418FE);
+	start.TableName(Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, u8"大安上王33"));
+	Hand2Note::SeatInfo hero(u8"德州小丑王", 7, 53.82, true);
+	hero.PlayerId(2416948123);
+	hero.PoketCards("Ah9c");
+	start.Seats({ Hand2Note::SeatInfo(u8"无能为力", 0, 109.54), hero });
+	Hand2Note::HandActionMessage action(2416948123, 7, Hand2Note::Action::Raise, 1.5, true);
+
+	// Hand2Note's table name format
+	CHECK(start.TableName().compare(0, 4, "FSHP") == 0);
+	CHECK(start.TableName() == Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, u8"大安上王33"));
+	CHECK(start.TableName() != Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, u8"大安上王34"));
+
+	// nobody listens, nothing is sent
+	Hand2Note::ClientStatusChecker status;
+	CHECK_FALSE(status.IsRunning());
+	CHECK_FALSE(Hand2Note::Protocol::IsConsumerAttached());
+	CHECK(Hand2Note::Protocol::SendHandStart(start) == H2N_STATUS_CONSUMER_ABSENT);
+
+	Hand2Note::SharedRing ring;
+	REQUIRE(ring.Open(name.c_str(), Hand2Note::SharedRing::DefaultCapacity, true));
+	REQUIRE(ring.Attach());
+	// the producer looks for a missing ring again after 100 ms
+	for (int i = 0; i < 50 && !status.IsRunning(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(status.IsRunning());
+	CHECK(Hand2Note::Protocol::IsConsumerAttached());
+
+	CHECK(Hand2Note::Protocol::SendHandStart(start) == 0);
+	CHECK(Hand2Note::Protocol::SendHandActon(action) == 0);
+	CHECK(Hand2Note::Protocol::SendHandStreed(Hand2Note::HandStreetMessage(2416948123, Hand2Note::Street::Flop, "5h8s7s", 3.5)) == 0);
+	CHECK(Hand2Note::Protocol::SendHandHistory(Hand2Note::HandHistoryMessage(Hand2Note::Room::PokerMaster, 2416948123,
+		Hand2Note::HandHistoryFormat::PokerStars, "PokerStars Hand #2416948123")) == 0);
+	CHECK(Hand2Note::Protocol::SendJson("{}") == 0);
+	CHECK(Hand2Note::Protocol::SendCommand(0x00F418FE, Hand2Note::Room::PokerFish, Hand2Note::Command::CloseHud) == 0);
+
+	// every call is one record holding one frame
+	std::vector<std::string> records;
+	CHECK(ring.Poll([&](const uint8_t* data, size_t size) { records.push_back(std::string((const char*)data, size)); }) == 6);
+	REQUIRE(records.size() == 6);
+	Hand2Note::WireMessage expected[] = { Hand2Note::WireMessage::HandStart, Hand2Note::WireMessage::Action, Hand2Note::WireMessage::Street,
+		Hand2Note::WireMessage::HandHistory, Hand2Note::WireMessage::Json, Hand2Note::WireMessage::Command };
+	for (size_t i = 0; i < records.size(); ++i) {
+		Hand2Note::WireReader reader(records[i].data(), records[i].size());
+		REQUIRE(reader.Next());
+		CHECK(reader.Type() == expected[i]);
+		CHECK_FALSE(reader.Next());
+		CHECK_FALSE(reader.IsError());
+	}
+
+	// the frame of the C struct is the frame of the message class
+	Hand2Note::WireWriter writer;
+	writer.Write(start);
+	CHECK(records[0] == std::string((const char*)writer.data(), writer.size()));
+	writer.Write(action);
+	CHECK(records[1] == std::string((const char*)writer.data(), writer.size()));
+
+	Hand2Note::WireReader reader(records[0].data(), records[0].size());
+	Hand2Note::HandStartMessage decoded;
+	REQUIRE(reader.Next());
+	REQUIRE(reader.Read(decoded));
+	REQUIRE(decoded.Seats().size() == 2);
+	CHECK(decoded.Seats()[1].Nickname() == u8"德州小丑王");
+	CHECK(decoded.Seats()[1].PlayerId() == 2416948123);
+	CHECK(decoded.Seats()[1].PoketCards() == "Ah9c");
+
+	// bad input and messages the ring can't take are reported and not sent
+	h2n_start_hand_message bad = {};
+	bad.seats_num = H2N_MAX_SEATS + 1;
+	CHECK(h2n_send_hand_start(&bad) == H2N_STATUS_INVALID_MESSAGE);
+	CHECK(h2n_send_action(nullptr) == H2N_STATUS_INVALID_MESSAGE);
+	CHECK(h2n_send_json(nullptr) == H2N_STATUS_INVALID_MESSAGE);
+	Hand2Note::HandStartMessage crowded = start;
+	Hand2Note::HandStartMessage::SeatsList seats(H2N_MAX_SEATS + 1, hero);
+	crowded.Seats(seats);
+	CHECK(Hand2Note::Protocol::SendHandStart(crowded) == H2N_STATUS_INVALID_MESSAGE);
+	h2n_start_hand_message marshaled;
+	Hand2Note::Protocol::Marshal(crowded, &marshaled);
+	CHECK(marshaled.seats_num == H2N_MAX_SEATS);
+	CHECK(Hand2Note::Protocol::SendHandHistory(Hand2Note::HandHistoryMessage(Hand2Note::Room::PokerMaster, 2416948123,
+		Hand2Note::HandHistoryFormat::PokerStars, std::string(ring.MaxRecord(), 'x'))) == H2N_STATUS_TRUNCATED);
+	CHECK(ring.Poll([](const uint8_t*, size_t) {}) == 0);
+
+	ring.Detach();
+	CHECK_FALSE(status.IsRunning());
+	CHECK_FALSE(Hand2Note::Protocol::IsConsumerAttached());
+	CHECK(Hand2Note::Protocol::SendHandActon(action) == H2N_STATUS_CONSUMER_ABSENT);
+	CHECK(ring.Used() == 0);
+
+	// a consumer killed without Detach is noticed by the producers within 100 ms
+	const pid_t child = fork();
+	REQUIRE(child >= 0);
+	if (!child)
+		_exit(ring.Attach() ? 0 : 1);
+	int exit_status = -1;
+	REQUIRE(waitpid(child, &exit_status, 0) == child);
+	REQUIRE(exit_status == 0);
+	REQUIRE(ring.ConsumerAttached());
+	for (int i = 0; i < 50 && Hand2Note::Protocol::IsConsumerAttached(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK_FALSE(Hand2Note::Protocol::IsConsumerAttached());
+	CHECK_FALSE(ring.ConsumerAttached());
+	CHECK(Hand2Note::Protocol::SendHandActon(action) == H2N_STATUS_CONSUMER_ABSENT);
+	CHECK(ring.Used() == 0);
+
+	// a consumer that creates the ring anew is found under the same name
+	Hand2Note::SharedRing::Remove(name.c_str());
+	Hand2Note::SharedRing recreated;
+	REQUIRE(recreated.Open(name.c_str(), 1 << 16, true));
+	REQUIRE(recreated.Attach());
+	for (int i = 0; i < 50 && !Hand2Note::Protocol::IsConsumerAttached(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(Hand2Note::Protocol::IsConsumerAttached());
+	CHECK(Hand2Note::Protocol::SendHandActon(action) == H2N_STATUS_OK);
+	CHECK(recreated.Poll([](const uint8_t*, size_t) {}) == 1);
+	CHECK(ring.Used() == 0);
+	recreated.Detach();
+}
+
+TEST_CASE("TestFlowControl")
+{
+	const TestRingName name("flow");
+
+	std::atomic<int> highs(0), lows(0);
+	Hand2Note::FlowControl flow([&] { ++highs; }, [&] { ++lows; });
+	CHECK(Hand2Note::FlowControl::WaitWritable(100, std::chrono::milliseconds(0)) == H2N_STATUS_CONSUMER_ABSENT);
+
+	Hand2Note::SharedRing ring;
+	// producers open the ring at the capacity the consumer chose
+	REQUIRE(ring.Open(name.c_str(), 1 << 16, true));
+	REQUIRE(ring.Attach());
+	for (int i = 0; i < 50 && !Hand2Note::Protocol::IsConsumerAttached(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	REQUIRE(Hand2Note::Protocol::IsConsumerAttached());
+
+	unsigned int used = 1, capacity = 0;
+	CHECK(h2n_queue_usage(&used, &capacity) == H2N_STATUS_OK);
+	CHECK(used == 0);
+	CHECK(capacity == 1 << 16);
+	CHECK(Hand2Note::FlowControl::WaitWritable(capacity, std::chrono::milliseconds(0)) == H2N_STATUS_TRUNCATED);
+
+	// fill the queue to 81%, above the high watermark
+	const std::string text(capacity / 16, 'x');
+	Hand2Note::HandHistoryMessage hh(Hand2Note::Room::PokerMaster, 2416948123, Hand2Note::HandHistoryFormat::PokerStars, text);
+	for (int i = 0; i < 13; ++i)
+		REQUIRE(Hand2Note::Protocol::SendHandHistory(hh) == H2N_STATUS_OK);
+	for (int i = 0; i < 500 && !flow.IsThrottled(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	CHECK(flow.IsThrottled());
+	CHECK(highs == 1);
+	CHECK(flow.Level() > 0.75);
+	CHECK_FALSE(flow.WaitUntilLow(std::chrono::milliseconds(10)));
+
+	// a wait succeeds as long as the send after it does
+	int sent = 0;
+	while (Hand2Note::FlowControl::WaitWritable((unsigned int)text.size(), std::chrono::milliseconds(0)) == H2N_STATUS_OK) {
+		REQUIRE(Hand2Note::Protocol::SendHandHistory(hh) == H2N_STATUS_OK);
+		REQUIRE(++sent < 4);
+	}
+	CHECK(sent > 0);
+	CHECK(Hand2Note::FlowControl::WaitWritable((unsigned int)text.size(), std::chrono::milliseconds(20)) == H2N_STATUS_QUEUE_FULL);
+	CHECK(Hand2Note::Protocol::SendHandHistory(hh) == H2N_STATUS_QUEUE_FULL);
+
+	std::thread consumer([&ring] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		ring.Poll([](const uint8_t*, size_t) {});
+	});
+	CHECK(Hand2Note::FlowControl::WaitWritable((unsigned int)text.size(), std::chrono::milliseconds(5000)) == H2N_STATUS_OK);
+	CHECK(flow.WaitUntilLow(std::chrono::milliseconds(5000)));
+	consumer.join();
+	CHECK_FALSE(flow.IsThrottled());
+	// on_low runs after the waiters are released
+	for (int i = 0; i < 500 && lows == 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	CHECK(lows == 1);
+	CHECK(highs == 1);
+
+	ring.Detach();
+}
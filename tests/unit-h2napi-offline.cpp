@@ -0,0 +1,1549 @@
+﻿#include "catch.hpp"
+#include "h2napi.hpp"
+#include "h2napi_equity.hpp"
+#include "h2napi_ring.hpp"
+#include "h2napi_stats.hpp"
+#include "mock-consumer.hpp"
+
+#include <chrono>
+#include <random>
+#ifndef _WIN32
+	#include <csignal>
+	#include <sys/resource.h>
+	#include <sys/wait.h>
+#endif
+
+// test cases here don't need running Hand2Note or any window, messages are only built and encoded
+
+
+TEST_CASE("TestJsonWriter")
+{
+	Hand2Note::JsonWriter json;
+
+	Hand2Note::HandActionMessage action(2416948123, 2, Hand2Note::Action::Raise, 1);
+	action.Pot(3.5);
+	json.Write(action);
+	CHECK(json.str() == R"({"msg":"action","gameid":2416948123,"seat_idx":2,"type":2,"amount":1,"is_allin":0,"pot":3.5})");
+	CHECK(json.size() == strlen(json.c_str()));
+
+	// writer is reused, every Write starts a new message
+	Hand2Note::HandStreetMessage street(2416948123, Hand2Note::Street::Turn, "5h8s7sTs");
+	street.Pot(8.82);
+	json.Write(street);
+	CHECK(json.str() == R"({"msg":"street","gameid":2416948123,"type":4,"board":"5h8s7sTs","pot":8.82})");
+
+	// utf8 nicknames are copied as is, quotes, backslashes and control characters are escaped
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 1);
+	start.Seats({ Hand2Note::SeatInfo(u8"德州小丑王", 7, 53.82, true),
+		Hand2Note::SeatInfo(u8"a \"quoted\" \\ long nickname\twith tab 张琳", 2, 168.45) });
+	json.Write(start);
+	CHECK(json.str().find(u8R"("nickname":"德州小丑王","player_id":"0","stack":53.82)") != std::string::npos);
+	CHECK(json.str().find(u8R"("nickname":"a \"quoted\" \\ long nickname\twith tab 张琳")") != std::string::npos);
+
+	// doubles are written in the shortest form which is parsed back to the same value
+	double values[] = { 0, 0.1, 0.29, -0.5, 1e-7, 0.1 + 0.2, 1.0 / 3, 123456789012.25, 1e300, -2.5e-300 };
+	for (double v : values) {
+		json.Clear();
+		json.Double(v);
+		CHECK(strtod(json.c_str(), nullptr) == v);
+	}
+	json.Clear();
+	json.Double(0.1 + 0.2);
+	CHECK(json.str() == "0.30000000000000004");
+	json.Clear();
+	json.Double(1e300);
+	CHECK(json.str() == "1e+300");
+}
+
+TEST_CASE("TestJsonReader")
+{
+	Hand2Note::JsonWriter json;
+	Hand2Note::JsonReader reader;
+
+	// everything written by JsonWriter is decoded back into h2n_* structs
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123, 0x00F418FE);
+	start.TableName("FSHP123456");
+	start.MaxPlayers(9);
+	start.SmallBlind(0.25);
+	start.BigBlind(0.5);
+	start.Ante(0.25);
+	Hand2Note::SeatInfo hero(u8"德州小丑王", 7, 53.82, true);
+	hero.PoketCards("5h8s");
+	hero.SetPostedSmallBlind(true);
+	start.Seats({ Hand2Note::SeatInfo(u8"张琳 \"quoted\"\n", 2, 168.45), hero });
+	json.Write(start);
+
+	REQUIRE(Hand2Note::JsonReader::HandStart == reader.Parse(json.c_str(), json.size()));
+	const h2n_start_hand_message& m = reader.HandStartMessage();
+	CHECK(m.room == H2N_ROOM_POKERMASTER);
+	CHECK(m.gameid == 2416948123.0);
+	CHECK(std::string(m.table_name) == "FSHP123456");
+	CHECK(m.table_hwnd == 0x00F418FE);
+	CHECK(m.max_players == 9);
+	CHECK(m.sb == 0.25);
+	CHECK(m.bb == 0.5);
+	CHECK(m.ante == 0.25);
+	REQUIRE(m.seats_num == 2);
+	CHECK(std::string(m.seats[0].nickname) == u8"张琳 \"quoted\"\n");
+	CHECK(m.seats[0].stack == 168.45);
+	CHECK(std::string(m.seats[1].nickname) == u8"德州小丑王");
+	CHECK(std::string(m.seats[1].pocket_cards) == "5h8s");
+	CHECK(std::string(m.seats[1].player_id) == "0");
+	CHECK(m.seats[1].is_hero == 1);
+	CHECK(m.seats[1].is_posted_sb == 1);
+	CHECK(m.seats[1].seat_idx == 7);
+
+	Hand2Note::HandActionMessage action(2416948123, 2, Hand2Note::Action::Bet, 2.66);
+	action.Pot(3.5);
+	REQUIRE(Hand2Note::JsonReader::Action == reader.Parse(json.Write(action).c_str()));
+	CHECK(reader.ActionMessage().seat_idx == 2);
+	CHECK(reader.ActionMessage().type == H2N_ACTION_BET);
+	CHECK(reader.ActionMessage().amount == 2.66);
+	CHECK(reader.ActionMessage().pot == 3.5);
+
+	Hand2Note::HandStreetMessage street(2416948123, Hand2Note::Street::Flop, "5h8s7s");
+	REQUIRE(Hand2Note::JsonReader::Street == reader.Parse(json.Write(street).c_str()));
+	CHECK(reader.StreetMessage().type == H2N_STREET_FLOP);
+	CHECK(std::string(reader.StreetMessage().board) == "5h8s7s");
+
+	Hand2Note::HandHistoryMessage hh(Hand2Note::Room::PokerStars, 2416948123, Hand2Note::HandHistoryFormat::PokerStars, "PokerStars Hand #2416948123:\n");
+	REQUIRE(Hand2Note::JsonReader::HandHistory == reader.Parse(json.Write(hh).c_str()));
+	CHECK(reader.HandHistoryMessage().format == H2N_HHFMT_STARS);
+	CHECK(std::string(reader.HandHistoryMessage().hh_formatted) == "PokerStars Hand #2416948123:\n");
+
+	// field order doesn't matter, unknown fields are skipped, \u escapes are decoded
+	REQUIRE(Hand2Note::JsonReader::Street == reader.Parse(
+		R"( { "board" : "张Ts" , "extra":{"a":[1,true,null,"x"]}, "pot":1e1, "msg":"street" } )"));
+	CHECK(std::string(reader.StreetMessage().board) == u8"张Ts");
+	CHECK(reader.StreetMessage().pot == 10);
+
+	CHECK(Hand2Note::JsonReader::Invalid == reader.Parse(R"({"msg":"street","board":"5h8s7s")"));
+	CHECK(Hand2Note::JsonReader::Invalid == reader.Parse(R"({"msg":"unknown"})"));
+	CHECK(Hand2Note::JsonReader::Invalid == reader.Parse(R"({"board":"5h8s7s"})"));
+}
+
+TEST_CASE("BenchJsonReader", "[.][bench]")
+{
+	// compare json decoding with the binary struct path, i.e. plain copy of h2n_action_message
+	const int N = 1000000;
+	Hand2Note::JsonWriter json;
+	Hand2Note::JsonReader reader;
+	Hand2Note::HandActionMessage action(2416948123, 2, Hand2Note::Action::Raise, 1.25);
+	action.Pot(3.5);
+	json.Write(action);
+
+	double sum = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < N; ++i) {
+		reader.Parse(json.c_str(), json.size());
+		sum += reader.ActionMessage().amount;
+	}
+	auto t1 = std::chrono::steady_clock::now();
+
+	h2n_action_message src, dst;
+	memset(&src, 0, sizeof(src));
+	src.amount = 1.25;
+	volatile h2n_action_message* psrc = &src;
+	for (int i = 0; i < N; ++i) {
+		memcpy(&dst, (const void*)psrc, sizeof(dst));
+		sum += dst.amount;
+	}
+	auto t2 = std::chrono::steady_clock::now();
+
+	typedef std::chrono::duration<double, std::nano> ns;
+	WARN("json decode: " << ns(t1 - t0).count() / N << " ns/msg, struct copy: " << ns(t2 - t1).count() / N << " ns/msg");
+	CHECK(sum == 2.5 * N);
+}
+
+TEST_CASE("TestWireFormat")
+{
+	Hand2Note::WireWriter writer;
+
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123, 0x00F418FE);
+	start.TableName("FSHP123456");
+	start.MaxPlayers(6);
+	start.SetShortDeck(true);
+	start.SetStraightBeatsTrips(false);
+	start.SetCurrency(Hand2Note::Currency::Yuan);
+	start.Ante(1);
+	start.Straddle(0.1 + 0.2);
+	Hand2Note::SeatInfo hero(u8"德州小丑王", 7, 53.82, true);
+	hero.PlayerId(1234567);
+	hero.PoketCards("AhKh");
+	hero.SetDealer(true);
+	start.Seats({ Hand2Note::SeatInfo(std::string(300, 'x'), 2, 168.45), hero });
+
+	Hand2Note::HandActionMessage action(2416948123, 7, Hand2Note::Action::Raise, 2.5, true);
+	action.Pot(3.75);
+	Hand2Note::HandStreetMessage street(2416948123, Hand2Note::Street::River, "5h8s7sTs2d");
+	Hand2Note::HandHistoryMessage hh(Hand2Note::Room::Pacific, 2416948123, Hand2Note::HandHistoryFormat::Pacific, "hh");
+
+	writer.Append(start).Append(action).Append(street).Append(hh);
+
+	Hand2Note::WireReader reader(writer.data(), writer.size());
+
+	REQUIRE(reader.Next());
+	Hand2Note::HandStartMessage start2;
+	REQUIRE(reader.Read(start2));
+	CHECK(start2.room() == Hand2Note::Room::PokerMaster);
+	CHECK(start2.GameId() == 2416948123);
+	CHECK(start2.TableName() == "FSHP123456");
+	CHECK(start2.TableHwnd() == 0x00F418FE);
+	CHECK(start2.MaxPlayers() == 6);
+	CHECK(start2.IsShortDeck());
+	CHECK_FALSE(start2.IsStraightBeatsTrips());
+	CHECK_FALSE(start2.IsOmaha());
+	CHECK(start2.currency() == Hand2Note::Currency::Yuan);
+	CHECK(start2.SmallBlind() == 0);
+	CHECK(start2.Ante() == 1);
+	CHECK(start2.Straddle() == 0.1 + 0.2);
+	REQUIRE(start2.Seats().size() == 2);
+	CHECK(start2.Seats()[0].Nickname() == std::string(300, 'x'));
+	CHECK(start2.Seats()[0].Stack() == 168.45);
+	CHECK(start2.Seats()[1].Nickname() == u8"德州小丑王");
+	CHECK(start2.Seats()[1].PlayerId() == 1234567);
+	CHECK(start2.Seats()[1].PoketCards() == "AhKh");
+	CHECK(start2.Seats()[1].IsDealer());
+	CHECK(start2.Seats()[1].IsHero());
+	CHECK(start2.Seats()[1].SeatIndex() == 7);
+
+	REQUIRE(reader.Next());
+	Hand2Note::HandActionMessage action2;
+	CHECK_FALSE(reader.Read(start2));
+	REQUIRE(reader.Read(action2));
+	CHECK(action2.GameId() == 2416948123);
+	CHECK(action2.SeatIndex() == 7);
+	CHECK(action2.ActionType() == Hand2Note::Action::Raise);
+	CHECK(action2.Amount() == 2.5);
+	CHECK(action2.IsAllin());
+	CHECK(action2.Pot() == 3.75);
+	// only non default fields are written: frame header + gameid + 5 short fields
+	CHECK(reader.BodySize() < 20);
+
+	REQUIRE(reader.Next());
+	Hand2Note::HandStreetMessage street2;
+	REQUIRE(reader.Read(street2));
+	CHECK(street2.StreetType() == Hand2Note::Street::River);
+	CHECK(street2.Board() == "5h8s7sTs2d");
+
+	REQUIRE(reader.Next());
+	Hand2Note::HandHistoryMessage hh2;
+	REQUIRE(reader.Read(hh2));
+	CHECK(hh2.room() == Hand2Note::Room::Pacific);
+	CHECK(hh2.Format() == Hand2Note::HandHistoryFormat::Pacific);
+	CHECK(hh2.FormattedHandHistory() == "hh");
+
+	CHECK_FALSE(reader.Next());
+	CHECK_FALSE(reader.IsError());
+
+	// a newer producer added field 15 (varint) and field 16 (bytes) to the street message, old reader skips them
+	const uint8_t newer[] = { 1, 4, 13, 2 << 3, 5 << 1, 3 << 3 | 2, 3, '5', 'h', '8', 15 << 3, 42, 0x82, 0x01, 1, 'z' };
+	Hand2Note::WireReader newer_reader(newer, sizeof(newer));
+	REQUIRE(newer_reader.Next());
+	REQUIRE(newer_reader.Read(street2));
+	CHECK(street2.StreetType() == Hand2Note::Street::River);
+	CHECK(street2.Board() == "5h8");
+
+	// truncated frame
+	Hand2Note::WireReader truncated(writer.data(), writer.size() - 1);
+	while (truncated.Next());
+	CHECK(truncated.IsError());
+
+	// encoded in place into MaxSize bytes, a buffer too small moves the frame to the writer
+	std::vector<uint8_t> slot(Hand2Note::WireWriter::MaxSize(start));
+	Hand2Note::WireWriter fixed(slot.data(), slot.size());
+	fixed.Append(start);
+	CHECK(fixed.data() == slot.data());
+	writer.Write(start);
+	CHECK(std::string((const char*)fixed.data(), fixed.size()) == std::string((const char*)writer.data(), writer.size()));
+	CHECK(Hand2Note::WireWriter::MaxSize(action) >= writer.Write(action).size());
+	CHECK(Hand2Note::WireWriter::MaxSize(street) >= writer.Write(street).size());
+	CHECK(Hand2Note::WireWriter::MaxSize(hh) >= writer.Write(hh).size());
+	uint8_t short_slot[16];
+	Hand2Note::WireWriter small(short_slot, sizeof(short_slot));
+	small.Append(start);
+	CHECK(small.data() != short_slot);
+	CHECK(std::string((const char*)small.data(), small.size()) == std::string((const char*)fixed.data(), fixed.size()));
+
+	// h2n_seat_info player ids are any strings, only the decimal form of a number is sent as one
+	const char* ids[] = { "2416948123", "pl-ayer#7", "007", "-5", "18446744073709551616", "" };
+	const int id_count = sizeof(ids) / sizeof(ids[0]);
+	h2n_start_hand_message cstart = {};
+	cstart.room = H2N_ROOM_POKERMASTER;
+	cstart.seats_num = id_count;
+	for (int i = 0; i < id_count; ++i) {
+		cstart.seats[i].seat_idx = i;
+		cstart.seats[i].player_id = ids[i];
+	}
+	writer.Write(cstart);
+	CHECK(Hand2Note::WireWriter::MaxSize(cstart) >= writer.size());
+	Hand2Note::WireReader seats_reader(writer.data(), writer.size());
+	REQUIRE(seats_reader.Next());
+	REQUIRE(seats_reader.Read(start2));
+	REQUIRE(start2.Seats().size() == id_count);
+	CHECK(start2.Seats()[0].PlayerId() == 2416948123);
+	for (int i = 0; i < id_count - 1; ++i)
+		CHECK(start2.Seats()[i].PlayerIdString() == ids[i]);
+	CHECK(start2.Seats()[1].PlayerId() == 0);
+	CHECK(start2.Seats()[2].PlayerId() == 0);
+
+	// and back from the message class
+	writer.Write(start2);
+	CHECK(Hand2Note::WireWriter::MaxSize(start2) >= writer.size());
+	Hand2Note::WireReader class_reader(writer.data(), writer.size());
+	REQUIRE(class_reader.Next());
+	Hand2Note::HandStartMessage start3;
+	REQUIRE(class_reader.Read(start3));
+	REQUIRE(start3.Seats().size() == id_count);
+	for (int i = 0; i < id_count - 1; ++i)
+		CHECK(start3.Seats()[i].PlayerIdString() == ids[i]);
+}
+
+TEST_CASE("TestCallRecorder")
+{
+	const char* path = "test_calls.h2ncalls";
+	Hand2Note::CallRecorder recorder;
+	REQUIRE(recorder.Open(path));
+
+	// h2napi calls made through Protocol are recorded while the recorder is set
+	Hand2Note::Protocol::SetRecorder(&recorder);
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123, 0x00F418FE);
+	start.Seats({ Hand2Note::SeatInfo(u8"德州小丑王", 7, 53.82, true) });
+	Hand2Note::Protocol::SendHandStart(start);
+	Hand2Note::Protocol::SendHandActon(Hand2Note::HandActionMessage(2416948123, 7, Hand2Note::Action::Call, 0.75));
+	Hand2Note::Protocol::SendHandStreed(Hand2Note::HandStreetMessage(2416948123, Hand2Note::Street::Flop, "5h8s7s"));
+	Hand2Note::Protocol::SendJson("{}");
+	Hand2Note::Protocol::SendCommand(0x00F418FE, Hand2Note::Room::PokerFish, Hand2Note::Command::CloseHud);
+	Hand2Note::Protocol::SetRecorder(nullptr);
+	Hand2Note::Protocol::SendHandActon(Hand2Note::HandActionMessage(2416948123, 7, Hand2Note::Action::Fold, 0));
+	recorder.Close();
+
+	Hand2Note::CallLogReader log;
+	REQUIRE(log.Open(path));
+
+	Hand2Note::WireMessage expected[] = { Hand2Note::WireMessage::HandStart, Hand2Note::WireMessage::Action,
+		Hand2Note::WireMessage::Street, Hand2Note::WireMessage::Json, Hand2Note::WireMessage::Command };
+	uint64_t prev_ns = 0;
+	for (Hand2Note::WireMessage type : expected) {
+		REQUIRE(log.Next());
+		CHECK(log.Call().Type() == type);
+		CHECK(log.TimeNs() >= prev_ns);
+		prev_ns = log.TimeNs();
+	}
+	CHECK_FALSE(log.Next());
+
+	// the last call is the command
+	int table_hwnd, room, cmd;
+	REQUIRE(log.Call().ReadCommand(table_hwnd, room, cmd));
+	CHECK(table_hwnd == 0x00F418FE);
+	CHECK(room == H2N_ROOM_FISHPOKERS);
+	CHECK(cmd == H2N_COMMAND_CLOSEHUD);
+
+	remove(path);
+}
+
+TEST_CASE("TestHandTracker")
+{
+	// the hand from TestSendDynamicHandHistory: 6 players, $0.25 ante, $0.25/$0.50 blinds
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123);
+	start.SmallBlind(0.25);
+	start.BigBlind(0.5);
+	start.Ante(0.25);
+	Hand2Note::SeatInfo bb(u8"无能为力", 0, 109.54), sb(u8"德州小丑王", 7, 53.82, true);
+	bb.SetPostedBigBlind(true);
+	sb.SetPostedSmallBlind(true);
+	start.Seats({ bb, Hand2Note::SeatInfo(u8"张琳", 2, 168.45), Hand2Note::SeatInfo(u8"天天大水上", 3, 59.26),
+		Hand2Note::SeatInfo(u8"安排！", 4, 48.14), Hand2Note::SeatInfo(u8"木樽", 6, 247.19), sb });
+
+	Hand2Note::HandTracker tracker;
+	REQUIRE(Hand2Note::TrackResult::Ok == tracker.Start(start));
+	CHECK(tracker.ActiveCount() == 6);
+	CHECK(tracker.Pot() == Approx(2.25));
+	CHECK(tracker.State().stack[7] == Approx(53.32));
+
+	const uint64_t id = start.GameId();
+	typedef Hand2Note::HandActionMessage A;
+	using Hand2Note::Action;
+	using Hand2Note::TrackResult;
+
+	// check facing the big blind and bet preflop are illegal
+	CHECK(TrackResult::IllegalAction == tracker.Apply(A(id, 2, Action::Check, 0)));
+	CHECK(TrackResult::IllegalAction == tracker.Apply(A(id, 2, Action::Bet, 1)));
+	// raise below the minimal raise
+	CHECK(TrackResult::InvalidAmount == tracker.Apply(A(id, 2, Action::Raise, 0.75)));
+	CHECK(TrackResult::InvalidSeat == tracker.Apply(A(id, 5, Action::Fold, 0)));
+	CHECK(TrackResult::UnknownHand == tracker.Apply(A(id + 1, 2, Action::Fold, 0)));
+
+	A raise(id, 2, Action::Raise, 1);
+	REQUIRE(TrackResult::Ok == tracker.Apply(raise));
+	CHECK(raise.Pot() == Approx(3.25));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 3, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 4, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 6, Action::Fold, 0)));
+	// call amount is what is added to the small blind
+	CHECK(TrackResult::InvalidAmount == tracker.Apply(A(id, 7, Action::Call, 1)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 7, Action::Call, 0.75)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 0, Action::Fold, 0)));
+	CHECK(TrackResult::InactiveSeat == tracker.Apply(A(id, 0, Action::Check, 0)));
+	CHECK(tracker.ActiveCount() == 2);
+
+	Hand2Note::HandStreetMessage flop(id, Hand2Note::Street::Flop, "5h8s7s");
+	REQUIRE(TrackResult::Ok == tracker.Apply(flop));
+	CHECK(flop.Pot() == Approx(4));
+	CHECK(TrackResult::InvalidStreet == tracker.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Flop, "5h8s7s")));
+
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 7, Action::Check, 0)));
+	CHECK(TrackResult::IllegalAction == tracker.Apply(A(id, 2, Action::Raise, 2.66)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 2, Action::Bet, 2.66)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 7, Action::Call, 2.66)));
+
+	Hand2Note::HandStreetMessage turn(id, Hand2Note::Street::Turn, "5h8s7sTs");
+	CHECK(TrackResult::InvalidStreet == tracker.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Turn, "5h8s7s")));
+	REQUIRE(TrackResult::Ok == tracker.Apply(turn));
+	CHECK(turn.Pot() == Approx(9.32));
+
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 7, Action::Check, 0)));
+	CHECK(TrackResult::Ok == tracker.Apply(A(id, 2, Action::Bet, 6.21)));
+	// all-in for more than the stack
+	CHECK(TrackResult::InvalidAmount == tracker.Apply(A(id, 7, Action::Raise, 100, true)));
+	// all-in raise for the whole stack: 53.82 - 0.25 ante - 1 preflop - 2.66 flop
+	A allin(id, 7, Action::Raise, 49.91, true);
+	CHECK(TrackResult::Ok == tracker.Apply(allin));
+	CHECK(allin.Pot() == Approx(9.32 + 6.21 + 49.91));
+	CHECK(tracker.State().allin_mask == 1u << 7);
+	CHECK(tracker.State().stack[7] == Approx(0));
+	CHECK(TrackResult::InactiveSeat == tracker.Apply(A(id, 7, Action::Fold, 0)));
+}
+
+TEST_CASE("TestHandHistoryComposer")
+{
+	// the hand from TestSendCompletedHandHistory, the small blind folds the turn
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123);
+	start.TableName(u8"大安上王33");
+	start.MaxPlayers(9);
+	start.SetCurrency(Hand2Note::Currency::Dollar);
+	start.SmallBlind(0.25);
+	start.BigBlind(0.5);
+	start.Ante(0.25);
+	Hand2Note::SeatInfo bb(u8"无能为力", 0, 109.54), sb(u8"德州小丑王", 7, 53.82, true), button(u8"木樽", 6, 247.19);
+	bb.SetPostedBigBlind(true);
+	sb.SetPostedSmallBlind(true);
+	sb.PoketCards("Ah9c");
+	button.SetDealer(true);
+	start.Seats({ bb, Hand2Note::SeatInfo(u8"张琳", 2, 168.45), Hand2Note::SeatInfo(u8"天天大水上", 3, 59.26),
+		Hand2Note::SeatInfo(u8"安排！", 4, 48.14), button, sb });
+
+	const uint64_t id = start.GameId();
+	typedef Hand2Note::HandActionMessage A;
+	using Hand2Note::Action;
+	using Hand2Note::TrackResult;
+
+	Hand2Note::HandHistoryComposer composer;
+	REQUIRE(TrackResult::Ok == composer.Start(start));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 2, Action::Raise, 1)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 3, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 4, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 6, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Call, 0.75)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Fold, 0)));
+	// illegal messages are not rendered
+	CHECK(TrackResult::InactiveSeat == composer.Apply(A(id, 0, Action::Check, 0)));
+	CHECK(TrackResult::Ok == composer.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Flop, "5h8s7s")));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Check, 0)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 2, Action::Bet, 2.66)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Call, 2.66)));
+	CHECK(TrackResult::Ok == composer.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Turn, "5h8s7sTs")));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Check, 0)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 2, Action::Bet, 6.21)));
+	CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Fold, 0)));
+
+	const std::string expected = u8R"(PokerStars Hand #2416948123: Hold'em No Limit ($0.25/$0.50 USD) - 2019/01/21 13:44:57 UTC
+Table '大安上王33' 9-max Seat #7 is the button
+Seat 1: 无能为力 ($109.54 in chips)
+Seat 3: 张琳 ($168.45 in chips)
+Seat 4: 天天大水上 ($59.26 in chips)
+Seat 5: 安排！ ($48.14 in chips)
+Seat 7: 木樽 ($247.19 in chips)
+Seat 8: 德州小丑王 ($53.82 in chips)
+无能为力: posts the ante $0.25
+张琳: posts the ante $0.25
+天天大水上: posts the ante $0.25
+安排！: posts the ante $0.25
+木樽: posts the ante $0.25
+德州小丑王: posts the ante $0.25
+无能为力: posts big blind $0.50
+德州小丑王: posts small blind $0.25
+*** HOLE CARDS ***
+Dealt to 德州小丑王 [Ah 9c]
+张琳: raises $0.50 to $1
+天天大水上: folds
+安排！: folds
+木樽: folds
+德州小丑王: calls $0.75
+无能为力: folds
+*** FLOP *** [5h 8s 7s]
+德州小丑王: checks
+张琳: bets $2.66
+德州小丑王: calls $2.66
+*** TURN *** [5h 8s 7s] [Ts]
+德州小丑王: checks
+张琳: bets $6.21
+德州小丑王: folds
+Uncalled bet ($6.21) returned to 张琳
+张琳 collected $9.32 from pot
+*** SUMMARY ***
+Total pot $9.32 | Rake $0
+Board [5h 8s 7s Ts]
+Seat 1: 无能为力 (big blind) folded before Flop
+Seat 3: 张琳 collected ($9.32)
+Seat 4: 天天大水上 folded before Flop (didn't bet)
+Seat 5: 安排！ folded before Flop (didn't bet)
+Seat 7: 木樽 (button) folded before Flop (didn't bet)
+Seat 8: 德州小丑王 (small blind) folded on the Turn
+)";
+	const std::time_t time = 1548078297; // 2019/01/21 13:44:57 UTC
+	CHECK(composer.Render(time) == expected);
+	// rendering again only updates the time
+	CHECK(composer.Render(time + 60).find("13:45:57 UTC") != std::string::npos);
+
+	Hand2Note::HandHistoryMessage hh;
+	composer.Finish(hh, time);
+	CHECK(hh.GameId() == id);
+	CHECK(hh.room() == Hand2Note::Room::PokerMaster);
+	CHECK(hh.Format() == Hand2Note::HandHistoryFormat::PokerStars);
+	CHECK(hh.FormattedHandHistory() == expected);
+
+	SECTION("showdown") {
+		REQUIRE(TrackResult::Ok == composer.Start(start));
+		for (int seat : { 2, 3, 4, 6 })
+			CHECK(TrackResult::Ok == composer.Apply(A(id, seat, Action::Fold, 0)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Call, 0.25)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Check, 0)));
+		CHECK(TrackResult::Ok == composer.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Flop, "5h8s7s")));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Check, 0)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Check, 0)));
+		composer.Win(7, 2.5);
+		const std::string& text = composer.Render(time);
+		CHECK(text.find("*** SHOW DOWN ***\n德州小丑王: shows [Ah 9c]\n德州小丑王 collected $2.50 from pot\n") != std::string::npos);
+		CHECK(text.find("Seat 1: 无能为力 (big blind) mucked\n") != std::string::npos);
+		CHECK(text.find("Seat 8: 德州小丑王 (small blind) showed [Ah 9c] and won ($2.50)\n") != std::string::npos);
+		CHECK(text.find("Uncalled bet") == std::string::npos);
+	}
+
+	SECTION("showdown winner from the cards") {
+		bb.PoketCards("KcKd");
+		start.Seats({ bb, sb });
+		REQUIRE(TrackResult::Ok == composer.Start(start));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Call, 0.25)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Check, 0)));
+		for (const char* board : { "5h8s7s", "5h8s7sTs", "5h8s7sTs2d" }) {
+			CHECK(TrackResult::Ok == composer.Apply(Hand2Note::HandStreetMessage(id, (Hand2Note::Street)(strlen(board) / 2), board)));
+			CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Check, 0)));
+			CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Check, 0)));
+		}
+		const std::string& text = composer.Render(time);
+		CHECK(text.find("无能为力 collected $1.50 from pot\n") != std::string::npos);
+		CHECK(text.find("Seat 1: 无能为力 (big blind) showed [Kc Kd] and won ($1.50)\n") != std::string::npos);
+		CHECK(text.find("Seat 8: 德州小丑王 (small blind) showed [Ah 9c] and lost\n") != std::string::npos);
+	}
+
+	SECTION("side pot") {
+		// the short stack with the best hand wins only the main pot it paid into
+		bb.PoketCards("KcKd");
+		Hand2Note::SeatInfo short_stack(u8"张琳", 2, 10);
+		short_stack.PoketCards("AsAd");
+		start.Seats({ bb, short_stack, sb });
+		REQUIRE(TrackResult::Ok == composer.Start(start));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 2, Action::Raise, 9.75, true)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Call, 9.5)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Call, 9.25)));
+		CHECK(TrackResult::Ok == composer.Apply(Hand2Note::HandStreetMessage(id, Hand2Note::Street::Flop, "5h8s7s")));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Bet, 20)));
+		CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Call, 20)));
+		for (const char* board : { "5h8s7sTs", "5h8s7sTs2d" }) {
+			CHECK(TrackResult::Ok == composer.Apply(Hand2Note::HandStreetMessage(id, (Hand2Note::Street)(strlen(board) / 2), board)));
+			CHECK(TrackResult::Ok == composer.Apply(A(id, 7, Action::Check, 0)));
+			CHECK(TrackResult::Ok == composer.Apply(A(id, 0, Action::Check, 0)));
+		}
+		const std::string& text = composer.Render(time);
+		CHECK(text.find("无能为力 collected $40 from pot\n张琳 collected $30 from pot\n") != std::string::npos);
+		CHECK(text.find("Total pot $70 |") != std::string::npos);
+		CHECK(text.find("Seat 8: 德州小丑王 (small blind) showed [Ah 9c] and lost\n") != std::string::npos);
+	}
+}
+
+TEST_CASE("TestHandMap")
+{
+	Hand2Note::HandMap<Hand2Note::HandTracker> hands(100);
+	REQUIRE(hands.Capacity() >= 100);
+	CHECK(hands.Find(1) == nullptr);
+
+	Hand2Note::HandTracker* tracker = hands.Insert(2416948123, 0x00F418FE);
+	REQUIRE(tracker != nullptr);
+	CHECK(hands.Find(2416948123) == tracker);
+	CHECK(hands.Insert(2416948123, 0x00F418FE) == tracker);
+	CHECK(hands.Size() == 1);
+
+	// the next hand on the table evicts the previous one, other tables keep theirs
+	CHECK(hands.Insert(2416948200, 0x00F41900) != nullptr);
+	CHECK(hands.Insert(2416948124, 0x00F418FE) != nullptr);
+	CHECK(hands.Find(2416948123) == nullptr);
+	CHECK(hands.Find(2416948124) != nullptr);
+	CHECK(hands.Find(2416948200) != nullptr);
+	CHECK(hands.Size() == 2);
+	CHECK(hands.Evicted() == 1);
+
+	CHECK(hands.Erase(2416948200));
+	CHECK_FALSE(hands.Erase(2416948200));
+	CHECK(hands.Size() == 1);
+
+	hands.Clear();
+	for (size_t i = 0; i < hands.Capacity(); ++i)
+		REQUIRE(hands.Insert(1000 + i, i) != nullptr);
+	CHECK(hands.Insert(1, 1000000) == nullptr);
+	// a full table still takes the next hand of one of its tables
+	CHECK(hands.Insert(1, 0) != nullptr);
+
+	SECTION("churn") {
+		// many hands coming and going must not wear the index out with deleted slots
+		Hand2Note::HandMap<uint64_t> map(64);
+		std::vector<uint64_t> live(40);
+		uint64_t game_id = 1;
+		for (int round = 0; round < 100000; ++round) {
+			size_t table = (size_t)(round * 7919) % live.size();
+			uint64_t* v = map.Insert(++game_id, table);
+			REQUIRE(v != nullptr);
+			*v = game_id;
+			if (live[table])
+				REQUIRE(map.Find(live[table]) == nullptr);
+			live[table] = game_id;
+		}
+		CHECK(map.Size() == live.size());
+		for (uint64_t id : live)
+			CHECK((map.Find(id) && *map.Find(id) == id));
+	}
+}
+
+TEST_CASE("TestCards")
+{
+	using Hand2Note::Cards;
+	using Hand2Note::CardMask;
+	using Hand2Note::CardsResult;
+
+	static_assert(Cards::Index('2', 'c') == 0 && Cards::Index('A', 's') == 51, "card index");
+	static_assert(Cards::Card('T', 'h') == (CardMask)1 << 34, "card mask");
+	static_assert(Cards::Index('1', 's') == -1 && Cards::Index('A', 'x') == -1, "invalid card");
+
+	CardMask board;
+	REQUIRE(CardsResult::Ok == Cards::Parse("5h8s7sTs", board));
+	CHECK(Cards::Size(board) == 4);
+	CHECK(board == (Cards::Card('5', 'h') | Cards::Card('8', 's') | Cards::Card('7', 's') | Cards::Card('T', 's')));
+	// formatted in mask order: suits c, d, h, s, ranks ascending
+	CHECK(Cards::ToString(board) == "5h7s8sTs");
+	CHECK(Cards::ToString(0) == "");
+
+	CardMask mask;
+	CHECK(CardsResult::InvalidCard == Cards::Parse("5h8", mask));
+	CHECK(CardsResult::InvalidCard == Cards::Parse("5h8S", mask));
+	CHECK(CardsResult::InvalidCard == Cards::Parse("10h", mask));
+	CHECK(CardsResult::DuplicateCard == Cards::Parse("5h8s5h", mask));
+	// hole cards against the board
+	CHECK(CardsResult::DuplicateCard == Cards::Parse("6sKc7s", mask, board));
+	CHECK(CardsResult::Ok == Cards::Parse("6sKcTdAh", mask, board));
+
+	// short deck: 6..A, 9 ranks per suit
+	CHECK(CardsResult::InvalidCard == Cards::Parse("5h8s7s", mask, 0, true));
+	REQUIRE(CardsResult::Ok == Cards::Parse("6cAs", mask, 0, true));
+	CHECK(Cards::ToShortDeck(mask) == (1ull | 1ull << 35));
+	CHECK(Cards::FromShortDeck(Cards::ToShortDeck(mask)) == mask);
+	CHECK(Cards::FromShortDeck((1ull << Cards::ShortDeckCount) - 1) == (((1ull << Cards::Count) - 1) & ~Cards::LowRanks));
+
+	CardMask all = 0;
+	for (const char* r = "23456789TJQKA"; *r; ++r)
+		for (const char* s = "cdhs"; *s; ++s)
+			all |= Cards::Card(*r, *s);
+	CHECK(all == (1ull << Cards::Count) - 1);
+	CHECK(CardsResult::Ok == Cards::Parse(Cards::ToString(all), mask));
+	CHECK(mask == all);
+
+	Hand2Note::HandStreetMessage turn(2416948123, Hand2Note::Street::Turn, "5h8s7sTs");
+	CHECK(CardsResult::Ok == Cards::Validate(turn, mask));
+	turn.StreetType(Hand2Note::Street::River);
+	CHECK(CardsResult::InvalidCount == Cards::Validate(turn, mask));
+
+	Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 2416948123);
+	Hand2Note::SeatInfo hero(u8"德州小丑王", 7, 53.82, true), villain(u8"张琳", 2, 168.45);
+	hero.PoketCards("5h8s");
+	start.Seats({ hero, villain });
+	CHECK(CardsResult::Ok == Cards::Validate(start, mask));
+	CHECK(mask == (Cards::Card('5', 'h') | Cards::Card('8', 's')));
+	start.SetOmaha(true);
+	CHECK(CardsResult::InvalidCount == Cards::Validate(start, mask));
+	hero.PoketCards("5h8s7s6s");
+	villain.PoketCards("AsKsQs8s");
+	start.Seats({ hero, villain });
+	CHECK(CardsResult::DuplicateCard == Cards::Validate(start, mask));
+
+	// the tracker rejects boards with the hero's cards and boards not extending the previous street
+	start.SetOmaha(false);
+	hero.PoketCards("5h8s");
+	villain.PoketCards("");
+	start.Seats({ hero, villain });
+	Hand2Note::HandTracker tracker;
+	REQUIRE(Hand2Note::TrackResult::Ok == tracker.Start(start));
+	CHECK(Hand2Note::TrackResult::InvalidCards == tracker.Apply(Hand2Note::HandStreetMessage(start.GameId(), Hand2Note::Street::Flop, "5h2s7s")));
+	CHECK(Hand2Note::TrackResult::Ok == tracker.Apply(Hand2Note::HandStreetMessage(start.GameId(), Hand2Note::Street::Flop, "3h2s7s")));
+	CHECK(Hand2Note::TrackResult::InvalidCards == tracker.Apply(Hand2Note::HandStreetMessage(start.GameId(), Hand2Note::Street::Turn, "3h2s6sTs")));
+	CHECK(Hand2Note::TrackResult::Ok == tracker.Apply(Hand2Note::HandStreetMessage(start.GameId(), Hand2Note::Street::Turn, "3h2s7sTs")));
+	CHECK(tracker.State().board == (mask = 0, Cards::Parse("3h2s7sTs", mask), mask));
+}
+
+namespace {
+	// Straightforward five card evaluation for the evaluator self-test, same HandValue layout
+	Hand2Note::HandValue NaiveEval5(const int* cards, bool short_deck, bool straight_beats_trips) {
+		using Hand2Note::HandCategory;
+		int count[13] = {};
+		bool flush = true;
+		for (int i = 0; i < 5; ++i) {
+			++count[cards[i] % 13];
+			flush &= cards[i] / 13 == cards[0] / 13;
+		}
+		// ranks ordered by count, then by rank
+		int order[5], n = 0;
+		for (int c = 4; c >= 1; --c)
+			for (int r = 12; r >= 0; --r)
+				if (count[r] == c)
+					order[n++] = r;
+		int top = -1;
+		if (n == 5) {
+			if (order[0] - order[4] == 4)
+				top = order[0];
+			else if (!short_deck && order[0] == 12 && order[1] == 3)
+				top = 3;
+			else if (short_deck && order[0] == 12 && order[1] == 7 && order[4] == 4)
+				top = 7;
+		}
+		HandCategory cat;
+		if (top >= 0 && flush) cat = HandCategory::StraightFlush;
+		else if (count[order[0]] == 4) cat = HandCategory::Quads;
+		else if (count[order[0]] == 3 && count[order[1]] == 2) cat = HandCategory::FullHouse;
+		else if (flush) cat = HandCategory::Flush;
+		else if (top >= 0) cat = HandCategory::Straight;
+		else if (count[order[0]] == 3) cat = HandCategory::Trips;
+		else if (count[order[1]] == 2) cat = HandCategory::TwoPair;
+		else if (count[order[0]] == 2) cat = HandCategory::Pair;
+		else cat = HandCategory::HighCard;
+
+		uint32_t ranks = 0;
+		if (cat == HandCategory::Straight || cat == HandCategory::StraightFlush)
+			ranks = (uint32_t)top << 16;
+		else
+			for (int i = 0; i < n; ++i)
+				ranks |= (uint32_t)order[i] << (16 - 4 * i);
+
+		static const int regular[9] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+		static const int six_plus[9] = { 0, 1, 2, 3, 4, 6, 5, 7, 8 };
+		static const int six_plus_trips[9] = { 0, 1, 2, 4, 3, 6, 5, 7, 8 };
+		const int* rank = !short_deck ? regular : straight_beats_trips ? six_plus : six_plus_trips;
+		return (uint32_t)rank[(int)cat] << 24 | (uint32_t)cat << 20 | ranks;
+	}
+
+	// best of all five card subsets
+	Hand2Note::HandValue NaiveEval(const int* cards, int n, bool short_deck = false, bool straight_beats_trips = true) {
+		Hand2Note::HandValue best = 0;
+		int five[5];
+		for (int a = 0; a < n; ++a)
+			for (int b = a + 1; b < n; ++b)
+				for (int c = b + 1; c < n; ++c)
+					for (int d = c + 1; d < n; ++d)
+						for (int e = d + 1; e < n; ++e) {
+							five[0] = cards[a]; five[1] = cards[b]; five[2] = cards[c]; five[3] = cards[d]; five[4] = cards[e];
+							Hand2Note::HandValue v = NaiveEval5(five, short_deck, straight_beats_trips);
+							best = v > best ? v : best;
+						}
+		return best;
+	}
+
+	Hand2Note::CardMask Mask(const int* cards, int n) {
+		Hand2Note::CardMask m = 0;
+		for (int i = 0; i < n; ++i)
+			m |= (Hand2Note::CardMask)1 << cards[i];
+		return m;
+	}
+
+	// n distinct cards out of the deck (36 card short deck: ranks 6..A)
+	void Deal(std::mt19937& rnd, int* cards, int n, bool short_deck = false) {
+		Hand2Note::CardMask used = 0;
+		for (int i = 0; i < n; ) {
+			int c = (int)(rnd() % 52);
+			if ((used >> c & 1) || (short_deck && c % 13 < 4))
+				continue;
+			used |= (Hand2Note::CardMask)1 << c;
+			cards[i++] = c;
+		}
+	}
+}
+
+TEST_CASE("TestEvaluator")
+{
+	using Hand2Note::Evaluator;
+	using Hand2Note::HandCategory;
+	using Hand2Note::Cards;
+	using Hand2Note::CardMask;
+
+	auto eval = [](const char* cards) { CardMask m; Cards::Parse(cards, m); return Evaluator::Eval(m); };
+	CHECK(Evaluator::Category(eval("5h8s7sTs2d6c9d")) == HandCategory::Straight);
+	CHECK(Evaluator::Category(eval("Ah2s3d4c5h")) == HandCategory::Straight);
+	CHECK(eval("Ah2s3d4c5h") < eval("2s3d4c5h6h"));
+	CHECK(Evaluator::Category(eval("AhKhQhJhTh9h8h")) == HandCategory::StraightFlush);
+	CHECK(Evaluator::Category(eval("7h7s7d7c2h2s3d")) == HandCategory::Quads);
+	CHECK(Evaluator::Category(eval("7h7s7d2c2h3s3d")) == HandCategory::FullHouse);
+	// two trips make a full house of the higher one
+	CHECK(eval("7h7s7d2c2h2sAd") == eval("7h7s7d2c2hKsAd"));
+	// best two of three pairs
+	CHECK(eval("AhAs7d7c2h2sKd") == eval("AhAs7d7c3h4sKd"));
+	CHECK(eval("AhAsKdKc") > eval("AhAsKdQc"));
+
+	SECTION("all five card hands") {
+		// category counts of the 2,598,960 hands
+		const int expected[9] = { 1302540, 1098240, 123552, 54912, 10200, 5108, 3744, 624, 40 };
+		int counts[9] = {};
+		int cards[5];
+		int mismatches = 0;
+		for (cards[0] = 0; cards[0] < 52; ++cards[0])
+			for (cards[1] = cards[0] + 1; cards[1] < 52; ++cards[1])
+				for (cards[2] = cards[1] + 1; cards[2] < 52; ++cards[2])
+					for (cards[3] = cards[2] + 1; cards[3] < 52; ++cards[3])
+						for (cards[4] = cards[3] + 1; cards[4] < 52; ++cards[4]) {
+							Hand2Note::HandValue v = Evaluator::Eval(Mask(cards, 5));
+							++counts[(int)Evaluator::Category(v)];
+							mismatches += v != NaiveEval5(cards, false, true);
+						}
+		CHECK(mismatches == 0);
+		for (int i = 0; i < 9; ++i)
+			CHECK(counts[i] == expected[i]);
+	}
+
+	SECTION("seven cards against brute force") {
+		std::mt19937 rnd(2416948123);
+		int cards[7], mismatches = 0;
+		for (int i = 0; i < 200000; ++i) {
+			Deal(rnd, cards, 7);
+			mismatches += Evaluator::Eval(Mask(cards, 7)) != NaiveEval(cards, 7);
+		}
+		CHECK(mismatches == 0);
+	}
+
+	SECTION("short deck") {
+		CardMask m;
+		Cards::Parse("Ah6s7d8c9h", m);
+		CHECK(Evaluator::Category(Evaluator::EvalShortDeck(m)) == HandCategory::Straight);
+		CardMask flush, full_house, trips, straight;
+		Cards::Parse("AhJh9h7h6hKsKd", flush);
+		Cards::Parse("KhKsKd7h7sAhJd", full_house);
+		Cards::Parse("KhKsKd7h6sAhJd", trips);
+		Cards::Parse("Th9s8d7h6sAhJd", straight);
+		CHECK(Evaluator::EvalShortDeck(flush) > Evaluator::EvalShortDeck(full_house));
+		CHECK(Evaluator::EvalShortDeck(straight, true) > Evaluator::EvalShortDeck(trips, true));
+		CHECK(Evaluator::EvalShortDeck(straight, false) < Evaluator::EvalShortDeck(trips, false));
+		// trips over a straight on the same board
+		CardMask both;
+		Cards::Parse("9h9s9d8h7s6hTd", both);
+		CHECK(Evaluator::Category(Evaluator::EvalShortDeck(both, true)) == HandCategory::Straight);
+		CHECK(Evaluator::Category(Evaluator::EvalShortDeck(both, false)) == HandCategory::Trips);
+
+		std::mt19937 rnd(7);
+		int cards[7], mismatches = 0;
+		for (int i = 0; i < 100000; ++i) {
+			Deal(rnd, cards, 7, true);
+			bool sbt = i & 1;
+			mismatches += Evaluator::EvalShortDeck(Mask(cards, 7), sbt) != NaiveEval(cards, 7, true, sbt);
+		}
+		CHECK(mismatches == 0);
+	}
+
+	SECTION("omaha") {
+		CardMask pocket, board;
+		// four spades on board and one in hand is no flush
+		Cards::Parse("KsJd8c6c", pocket);
+		Cards::Parse("Qh5s7s9s2s", board);
+		CHECK(Evaluator::Category(Evaluator::EvalOmaha(pocket, board)) == HandCategory::Straight);
+
+		std::mt19937 rnd(5);
+		int cards[10], mismatches = 0;
+		for (int i = 0; i < 20000; ++i) {
+			int n = 4 + (i & 1);
+			Deal(rnd, cards, n + 5);
+			Hand2Note::HandValue best = 0;
+			int five[5];
+			for (int a = 0; a < n; ++a)
+				for (int b = a + 1; b < n; ++b)
+					for (int c = n; c < n + 5; ++c)
+						for (int d = c + 1; d < n + 5; ++d)
+							for (int e = d + 1; e < n + 5; ++e) {
+								five[0] = cards[a]; five[1] = cards[b]; five[2] = cards[c]; five[3] = cards[d]; five[4] = cards[e];
+								Hand2Note::HandValue v = NaiveEval5(five, false, true);
+								best = v > best ? v : best;
+							}
+			mismatches += Evaluator::EvalOmaha(Mask(cards, n), Mask(cards + n, 5)) != best;
+		}
+		CHECK(mismatches == 0);
+	}
+}
+
+TEST_CASE("TestEquity")
+{
+	using Hand2Note::Cards;
+	using Hand2Note::CardMask;
+	using Hand2Note::EquityResult;
+
+	auto parse = [](const char* cards) { CardMask m = 0; Cards::Parse(cards, m); return m; };
+	Hand2Note::EquityCalculator holdem;
+
+	SECTION("river") {
+		CardMask pockets[] = { parse("AhAs"), parse("KdKc") };
+		EquityResult r = holdem.Calculate(pockets, 2, parse("5h8s7sTs2d"));
+		CHECK(r.exhaustive);
+		CHECK(r.boards == 1);
+		CHECK(r.equity[0] == 1);
+		CHECK(r.equity[1] == 0);
+		// both play the board
+		CardMask chop[] = { parse("2c3c"), parse("2h4d") };
+		r = holdem.Calculate(chop, 2, parse("AhKsQdJcTh"));
+		CHECK(r.equity[0] == 0.5);
+		CHECK(r.tie[1] == 1);
+	}
+
+	SECTION("turn and flop are enumerated") {
+		// kings need one of the two kings left in 44 rivers
+		CardMask pockets[] = { parse("AhAs"), parse("KdKc") };
+		EquityResult r = holdem.Calculate(pockets, 2, parse("5h8s7s2d"));
+		CHECK(r.exhaustive);
+		CHECK(r.boards == 44);
+		CHECK(r.equity[1] == Approx(2.0 / 44));
+
+		Hand2Note::EquityOptions opt;
+		opt.threads = 3;
+		r = holdem.Calculate(pockets, 2, parse("5h8s7s"), 0, opt);
+		CHECK(r.exhaustive);
+		CHECK(r.boards == 990);
+		EquityResult single = holdem.Calculate(pockets, 2, parse("5h8s7s"), 0, [] { Hand2Note::EquityOptions o; o.threads = 1; return o; }());
+		CHECK(r.equity[0] == Approx(single.equity[0]));
+		CHECK(r.equity[0] + r.equity[1] == Approx(1));
+	}
+
+	SECTION("preflop is sampled") {
+		CardMask pockets[] = { parse("AhAs"), parse("KdKc") };
+		EquityResult r = holdem.Calculate(pockets, 2, 0);
+		CHECK_FALSE(r.exhaustive);
+		CHECK(r.boards == Hand2Note::EquityOptions().samples);
+		// exact 81.95%
+		CHECK(r.equity[0] == Approx(0.8195).epsilon(0.01));
+
+		// dead cards are out of the deck: AA vs KK with the other two kings gone
+		r = holdem.Calculate(pockets, 2, 0, parse("KhKs"));
+		CHECK(r.equity[0] > 0.85);
+	}
+
+	SECTION("omaha and short deck") {
+		Hand2Note::EquityCalculator omaha(true, false);
+		CardMask plo[] = { parse("AhAsKdKc"), parse("8s9sTdJd") };
+		EquityResult r = omaha.Calculate(plo, 2, parse("2h5c7dQs"));
+		CHECK(r.exhaustive);
+		CHECK(r.boards == 40);
+		CHECK(r.equity[0] + r.equity[1] == Approx(1));
+		CHECK(r.equity[0] > r.equity[1]);
+
+		// the wheel straight A6789 of short deck
+		Hand2Note::EquityCalculator six_plus(false, true);
+		CardMask pockets[] = { parse("AhKs"), parse("QdQc") };
+		r = six_plus.Calculate(pockets, 2, parse("6s7h8d9c"));
+		CHECK(r.boards == 36 - 8);
+		// A6789 is made already, aces and tens give the queens a straight as good
+		CHECK(r.equity[0] == Approx((21 + 7 * 0.5) / 28));
+		// ranks 2..5 are not in the deck
+		CHECK(six_plus.Calculate(pockets, 2, parse("6s7h8d9c5c")).boards == 0);
+	}
+
+	SECTION("invalid input") {
+		// cards held twice
+		CardMask shared[] = { parse("AhAs"), parse("AhKc") };
+		CHECK(holdem.Calculate(shared, 2, parse("5h8s7s")).boards == 0);
+		CardMask pockets[] = { parse("AhAs"), parse("KdKc") };
+		CHECK(holdem.Calculate(pockets, 2, parse("5h8s7sAs")).boards == 0);
+		CHECK(holdem.Calculate(pockets, 2, parse("5h8s7s"), parse("7s")).boards == 0);
+		// pockets of the wrong size for the game
+		CardMask short_pocket[] = { parse("AhAs"), parse("Kd") };
+		CHECK(holdem.Calculate(short_pocket, 2, parse("5h8s7s")).boards == 0);
+		Hand2Note::EquityCalculator omaha(true, false);
+		CHECK(omaha.Calculate(pockets, 2, parse("5h8s7s")).boards == 0);
+		CardMask mixed[] = { parse("AhAsKdKc"), parse("8s9sTdJd2c") };
+		CHECK(omaha.Calculate(mixed, 2, parse("5h8c7s")).boards == 0);
+		Hand2Note::HandStartMessage game;
+		game.SetOmahaFive(true);
+		CardMask five[] = { parse("AhAsKdKcQh"), parse("8s9sTdJd2c") };
+		CHECK(Hand2Note::EquityCalculator(game).Calculate(five, 2, parse("5h8c7s2d")).boards == 40 - 2);
+		CardMask four[] = { parse("AhAsKdKc"), parse("8s9sTdJd") };
+		CHECK(Hand2Note::EquityCalculator(game).Calculate(four, 2, parse("5h8c7s2d")).boards == 0);
+		CHECK(omaha.Calculate(four, 2, parse("5h8c7s2d")).boards == 40);
+	}
+}
+
+TEST_CASE("TestStatsAggregator")
+{
+	using Hand2Note::Action;
+	using Hand2Note::Stat;
+	using Hand2Note::TrackResult;
+	typedef Hand2Note::HandActionMessage A;
+	const Hand2Note::Room room = Hand2Note::Room::PokerMaster;
+
+	// ids for three players, the fourth one is known only by the nickname
+	auto start = [room](uint64_t id, int hwnd) {
+		Hand2Note::HandStartMessage msg(room, id, hwnd);
+		msg.SmallBlind(0.25);
+		msg.BigBlind(0.5);
+		Hand2Note::SeatInfo btn(11, 0, 50), sb(12, 1, 50), bb(13, 2, 50), co(u8"张琳", 3, 50);
+		sb.SetPostedSmallBlind(true);
+		bb.SetPostedBigBlind(true);
+		msg.Seats({ btn, sb, bb, co });
+		return msg;
+	};
+
+	Hand2Note::StatsAggregator stats;
+	REQUIRE(TrackResult::Ok == stats.Start(start(1, 100)));
+	REQUIRE(stats.Size() == 4);
+	const int btn = stats.Find(room, 11), sb = stats.Find(room, 12), bb = stats.Find(room, 13), co = stats.Find(room, u8"张琳");
+	CHECK(stats.Find(Hand2Note::Room::PokerStars, 11) == -1);
+	CHECK(stats.Find(room, "nobody") == -1);
+	REQUIRE(co == 3);
+
+	// co raises, btn 3bets, sb folds, bb calls the 3bet, co calls; btn c-bets the flop after two checks
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 3, Action::Raise, 1.5)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 0, Action::Raise, 4.5)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 1, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 2, Action::Call, 4)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 3, Action::Call, 3)));
+	CHECK(TrackResult::Ok == stats.Apply(Hand2Note::HandStreetMessage(1, Hand2Note::Street::Flop, "5h8s7s")));
+	CHECK(TrackResult::InvalidStreet == stats.Apply(Hand2Note::HandStreetMessage(1, Hand2Note::Street::Flop, "5h8s7s")));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 2, Action::Check, 0)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 3, Action::Check, 0)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 0, Action::Bet, 6)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 2, Action::Raise, 18)));
+	CHECK(TrackResult::Ok == stats.Apply(A(1, 0, Action::Raise, 50)));
+	CHECK(TrackResult::InvalidSeat == stats.Apply(A(1, 5, Action::Fold, 0)));
+	CHECK(TrackResult::UnknownHand == stats.Apply(A(2, 0, Action::Fold, 0)));
+
+	CHECK(stats.Get(btn, Stat::Vpip) == 1);
+	CHECK(stats.Get(btn, Stat::Pfr) == 1);
+	CHECK(stats.Get(btn, Stat::ThreeBetOpportunity) == 1);
+	CHECK(stats.Get(btn, Stat::ThreeBet) == 1);
+	CHECK(stats.Get(btn, Stat::CbetOpportunity) == 1);
+	CHECK(stats.Get(btn, Stat::Cbet) == 1);
+	// sb folded facing two raises: no 3bet opportunity
+	CHECK(stats.Get(sb, Stat::ThreeBetOpportunity) == 0);
+	CHECK(stats.Get(sb, Stat::Vpip) == 0);
+	// bb faced two raises, no 3bet opportunity; raising the flop is not counted
+	CHECK(stats.Get(bb, Stat::Vpip) == 1);
+	CHECK(stats.Get(bb, Stat::ThreeBetOpportunity) == 0);
+	CHECK(stats.Get(bb, Stat::Pfr) == 0);
+	CHECK(stats.Get(co, Stat::Vpip) == 1);
+	CHECK(stats.Get(co, Stat::Pfr) == 1);
+	CHECK(stats.Get(co, Stat::CbetOpportunity) == 0);
+
+	// second hand on another table: co folds, btn limps, sb completes, bb raises,
+	// btn calls and sb folds facing the single raise
+	REQUIRE(TrackResult::Ok == stats.Start(start(2, 200)));
+	CHECK(stats.Size() == 4);
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 3, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 0, Action::Call, 0.5)));
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 1, Action::Call, 0.25)));
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 2, Action::Raise, 2)));
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 0, Action::Call, 1.5)));
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 1, Action::Fold, 0)));
+	CHECK(TrackResult::Ok == stats.Apply(Hand2Note::HandStreetMessage(2, Hand2Note::Street::Flop, "2c3d4h")));
+	// a donk bet takes the c-bet opportunity away
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 0, Action::Bet, 2)));
+	CHECK(TrackResult::Ok == stats.Apply(A(2, 2, Action::Call, 2)));
+
+	CHECK(stats.Get(btn, Stat::Hands) == 2);
+	CHECK(stats.Get(btn, Stat::Vpip) == 2);
+	CHECK(stats.Get(btn, Stat::ThreeBetOpportunity) == 2);
+	CHECK(stats.Get(btn, Stat::ThreeBet) == 1);
+	CHECK(stats.Get(sb, Stat::ThreeBetOpportunity) == 1);
+	CHECK(stats.Get(bb, Stat::Pfr) == 1);
+	CHECK(stats.Get(bb, Stat::CbetOpportunity) == 0);
+	CHECK(stats.Get(co, Stat::Vpip) == 1);
+	CHECK(stats.Ratio(co, Stat::Vpip) == Approx(0.5));
+	CHECK(stats.Ratio(btn, Stat::ThreeBet) == Approx(0.5));
+	CHECK(stats.Ratio(btn, Stat::Cbet) == Approx(1));
+
+	CHECK(stats.Sum(Stat::Hands) == 8);
+	CHECK(stats.Sum(Stat::Vpip) == 6);
+	std::vector<uint32_t> rows;
+	CHECK(stats.Select(Stat::Vpip, 0.9, 1, 2, rows) == 2);
+	CHECK(rows == std::vector<uint32_t>({ (uint32_t)btn, (uint32_t)bb }));
+	rows.clear();
+	CHECK(stats.Select(Stat::ThreeBet, 0, 0, 1, rows) == 1);
+	CHECK(rows == std::vector<uint32_t>({ (uint32_t)sb }));
+
+	SECTION("tables without hwnd") {
+		// converters that leave table_hwnd 0 tell the tables apart by name
+		Hand2Note::HandStartMessage first = start(3, 0), second = start(4, 0);
+		first.TableName("PS1001");
+		second.TableName("PS1002");
+		REQUIRE(TrackResult::Ok == stats.Start(first));
+		REQUIRE(TrackResult::Ok == stats.Start(second));
+		CHECK(TrackResult::Ok == stats.Apply(A(3, 3, Action::Raise, 1.5)));
+		CHECK(TrackResult::Ok == stats.Apply(A(4, 3, Action::Call, 0.5)));
+		CHECK(TrackResult::Ok == stats.Apply(A(3, 0, Action::Fold, 0)));
+		CHECK(TrackResult::Ok == stats.Apply(A(4, 0, Action::Raise, 2)));
+		CHECK(stats.Get(co, Stat::Hands) == 4);
+		CHECK(stats.Get(co, Stat::Vpip) == 3);
+		CHECK(stats.Get(co, Stat::Pfr) == 2);
+		CHECK(stats.Get(btn, Stat::Pfr) == 2);
+
+		// the next hand at a table ends the previous one there only
+		Hand2Note::HandStartMessage third = start(5, 0);
+		third.TableName("PS1001");
+		REQUIRE(TrackResult::Ok == stats.Start(third));
+		CHECK(TrackResult::UnknownHand == stats.Apply(A(3, 1, Action::Fold, 0)));
+		CHECK(TrackResult::Ok == stats.Apply(A(4, 1, Action::Fold, 0)));
+		CHECK(TrackResult::Ok == stats.Apply(A(5, 1, Action::Fold, 0)));
+	}
+
+	SECTION("scan over many players") {
+		// 9 players of 1000 at 64 tables
+		std::mt19937 rnd(5);
+		Hand2Note::StatsAggregator many;
+		for (uint64_t hand = 1; hand <= 2000; ++hand) {
+			Hand2Note::HandStartMessage msg(room, hand, (int)(hand % 64));
+			Hand2Note::HandStartMessage::SeatsList seats;
+			for (int i = 0; i < 9; ++i)
+				seats.push_back(Hand2Note::SeatInfo(1 + rnd() % 1000, i, 100));
+			msg.Seats(seats);
+			many.Start(msg);
+			for (int i = 0; i < 9; ++i)
+				many.Apply(A(hand, i, rnd() % 3 ? Action::Fold : Action::Call, 1));
+		}
+		std::vector<uint32_t> selected;
+		many.Select(Stat::Vpip, 0.3, 0.5, 10, selected);
+		size_t expected = 0;
+		uint64_t hands = 0;
+		for (size_t row = 0; row < many.Size(); ++row) {
+			double den = many.Get(row, Stat::Hands), num = many.Get(row, Stat::Vpip);
+			expected += den >= 10 && num >= den * 0.3 && num <= den * 0.5;
+			hands += many.Get(row, Stat::Hands);
+		}
+		CHECK(selected.size() == expected);
+		CHECK(expected > 0);
+		CHECK(many.Sum(Stat::Hands) == hands);
+		CHECK(hands == 2000 * 9);
+	}
+}
+
+TEST_CASE("TestStatsStore")
+{
+	using Hand2Note::Action;
+	using Hand2Note::Stat;
+	typedef Hand2Note::HandActionMessage A;
+	const Hand2Note::Room room = Hand2Note::Room::PokerMaster;
+	const std::string path = "test_stats.h2nstats", copy = "test_stats_copy.h2nstats";
+	auto cleanup = [&] {
+		for (const std::string& base : { path, copy }) {
+			remove(base.c_str());
+			remove((base + ".log").c_str());
+			remove((base + ".tmp").c_str());
+		}
+	};
+	// the files a crash at this moment would leave behind
+	auto crash = [&] {
+		for (const char* ext : { "", ".log" }) {
+			std::string from = path + ext, to = copy + ext;
+			FILE* in = fopen(from.c_str(), "rb");
+			FILE* out = fopen(to.c_str(), "wb");
+			REQUIRE(in);
+			REQUIRE(out);
+			char block[4096];
+			size_t n;
+			while ((n = fread(block, 1, sizeof(block), in)) != 0)
+				fwrite(block, 1, n, out);
+			fclose(in);
+			fclose(out);
+		}
+	};
+	auto play = [&](Hand2Note::StatsAggregator& stats, uint64_t id) {
+		Hand2Note::HandStartMessage start(room, id, 100);
+		start.Seats({ Hand2Note::SeatInfo(11, 0, 50), Hand2Note::SeatInfo(12, 1, 50), Hand2Note::SeatInfo(u8"张琳", 2, 50) });
+		stats.Start(start);
+		stats.Apply(A(id, 0, Action::Raise, 1));
+		stats.Apply(A(id, 1, Action::Call, 1));
+		stats.Apply(A(id, 2, id % 2 ? Action::Raise : Action::Fold, 3));
+	};
+	auto same = [](const Hand2Note::StatsAggregator& a, const Hand2Note::StatsAggregator& b) {
+		REQUIRE(a.Size() == b.Size());
+		for (size_t row = 0; row < a.Size(); ++row) {
+			CHECK(a.PlayerRoom(row) == b.PlayerRoom(row));
+			CHECK(a.PlayerId(row) == b.PlayerId(row));
+			CHECK(a.Nickname(row) == b.Nickname(row));
+			for (int stat = 0; stat < (int)Stat::Count; ++stat)
+				CHECK(a.Get(row, (Stat)stat) == b.Get(row, (Stat)stat));
+		}
+	};
+	cleanup();
+
+	Hand2Note::StatsAggregator stats;
+	Hand2Note::StatsStore store(stats);
+	REQUIRE(store.Open(path));
+	CHECK(store.Generation() == 1);
+	CHECK(stats.Size() == 0);
+	play(stats, 1);
+	play(stats, 2);
+	REQUIRE(store.Flush());
+	CHECK(store.LogBytes() > 0);
+	// an unflushed hand is lost in the crash
+	Hand2Note::StatsAggregator flushed;
+	play(flushed, 1);
+	play(flushed, 2);
+	play(stats, 3);
+	crash();
+
+	{
+		Hand2Note::StatsAggregator restored;
+		Hand2Note::StatsStore reopened(restored);
+		REQUIRE(reopened.Open(copy));
+		CHECK(reopened.Replayed() == 1);
+		CHECK(reopened.Generation() == 2);
+		same(restored, flushed);
+		CHECK(restored.Find(room, u8"张琳") == 2);
+		CHECK(restored.Get(restored.Find(room, 11), Stat::ThreeBetOpportunity) == 0);
+		CHECK(restored.Get(restored.Find(room, 12), Stat::ThreeBetOpportunity) == 2);
+	}
+
+	SECTION("torn log tail") {
+		REQUIRE(store.Flush());
+		crash();
+		FILE* log = fopen((copy + ".log").c_str(), "ab");
+		REQUIRE(log);
+		uint32_t torn[3] = { 100, 0, 7 };
+		fwrite(torn, sizeof(torn), 1, log);
+		fclose(log);
+		Hand2Note::StatsAggregator restored;
+		Hand2Note::StatsStore reopened(restored);
+		REQUIRE(reopened.Open(copy));
+		CHECK(reopened.Replayed() == 2);
+		same(restored, stats);
+	}
+
+#ifndef _WIN32
+	SECTION("failed append") {
+		// the file size limit cuts the batch short, the log ends with part of it
+		REQUIRE(store.Flush());
+		play(stats, 4);
+		play(stats, 5);
+		rlimit saved;
+		REQUIRE(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+		rlimit limit = saved;
+		limit.rlim_cur = (rlim_t)(16 + store.LogBytes() + 12);
+		void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+		REQUIRE(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+		const bool flushed = store.Flush();
+		setrlimit(RLIMIT_FSIZE, &saved);
+		signal(SIGXFSZ, handler);
+		CHECK_FALSE(flushed);
+		CHECK(store.Generation() == 1);
+
+		// the next flush writes the kept changes to a snapshot instead of appending after the torn batch
+		play(stats, 6);
+		REQUIRE(store.Flush());
+		CHECK(store.Generation() == 2);
+		CHECK(store.LogBytes() == 0);
+		play(stats, 7);
+		REQUIRE(store.Flush());
+		crash();
+		Hand2Note::StatsAggregator restored;
+		Hand2Note::StatsStore reopened(restored);
+		REQUIRE(reopened.Open(copy));
+		CHECK(reopened.Replayed() == 1);
+		same(restored, stats);
+	}
+#endif
+
+	SECTION("snapshot") {
+		REQUIRE(store.Snapshot());
+		CHECK(store.Generation() == 2);
+		CHECK(store.LogBytes() == 0);
+		play(stats, 4);
+		REQUIRE(store.Flush(true));
+		crash();
+		Hand2Note::StatsAggregator restored;
+		Hand2Note::StatsStore reopened(restored);
+		REQUIRE(reopened.Open(copy));
+		CHECK(reopened.Replayed() == 1);
+		same(restored, stats);
+
+		// a crash between the snapshot rename and the new log keeps the old log, it is not replayed again
+		REQUIRE(reopened.Snapshot());
+		reopened.Close();
+		FILE* log = fopen((copy + ".log").c_str(), "wb");
+		FILE* old = fopen((path + ".log").c_str(), "rb");
+		REQUIRE(log);
+		REQUIRE(old);
+		char block[4096];
+		size_t n;
+		while ((n = fread(block, 1, sizeof(block), old)) != 0)
+			fwrite(block, 1, n, log);
+		fclose(old);
+		fclose(log);
+		Hand2Note::StatsAggregator again;
+		Hand2Note::StatsStore store_again(again);
+		REQUIRE(store_again.Open(copy));
+		CHECK(store_again.Replayed() == 0);
+		same(again, stats);
+	}
+
+	SECTION("damaged snapshot") {
+		store.Close();
+		crash();
+		FILE* f = fopen(copy.c_str(), "r+b");
+		REQUIRE(f);
+		fseek(f, 60, SEEK_SET);
+		fputc(0x55, f);
+		fclose(f);
+		Hand2Note::StatsAggregator restored;
+		Hand2Note::StatsStore reopened(restored);
+		CHECK_FALSE(reopened.Open(copy));
+	}
+
+	store.Close();
+	cleanup();
+}
+
+TEST_CASE("TestStringInterner")
+{
+	using Hand2Note::StringId;
+	using Hand2Note::StringInterner;
+	StringInterner interner;
+	const StringId a = interner.Intern(u8"无能为力"), b = interner.Intern(std::string(u8"张琳"));
+	CHECK(a == 0);
+	CHECK(b == 1);
+	CHECK(interner.Intern(std::string(u8"无能为力")) == a);
+	CHECK(interner.Find(u8"张琳") == b);
+	CHECK(interner.Find("nobody") == StringInterner::None);
+	CHECK(interner.Resolve(a) == u8"无能为力");
+	const StringId pid = interner.Intern(uint64_t(2416948123));
+	CHECK(interner.Find("2416948123") == pid);
+	// the empty string is a string like any other
+	CHECK(interner.Intern("", 0) == 3);
+	CHECK(interner.Size() == 4);
+
+	SECTION("limit") {
+		// a full interner finds the strings it has and takes no new ones
+		StringInterner small(5);
+		for (int i = 0; i < 5; ++i)
+			REQUIRE(small.Intern("player" + std::to_string(i)) == (StringId)i);
+		CHECK(small.Intern("player5") == StringInterner::None);
+		CHECK(small.Intern("player3") == 3);
+		CHECK(small.Find("player5") == StringInterner::None);
+		CHECK(small.Size() == 5);
+		CHECK(StringInterner(StringInterner::MaxSize() + 1).Intern("x") == 0);
+	}
+
+	SECTION("dense ids across table growth and chunks") {
+		for (int i = 0; i < 20000; ++i)
+			REQUIRE(interner.Intern("player" + std::to_string(i)) == (StringId)(4 + i));
+		for (int i = 0; i < 20000; i += 7) {
+			CHECK(interner.Find("player" + std::to_string(i)) == (StringId)(4 + i));
+			CHECK(interner.Resolve(4 + i) == "player" + std::to_string(i));
+		}
+		CHECK(interner.Resolve(a) == u8"无能为力");
+	}
+
+	SECTION("readers while interning") {
+		std::atomic<bool> done(false);
+		std::atomic<int> wrong(0);
+		std::thread reader([&] {
+			while (!done) {
+				size_t size = interner.Size();
+				for (size_t id = 4; id < size; id += 97) {
+					StringId found = interner.Find(interner.Resolve((StringId)id));
+					if (found != id)
+						++wrong;
+				}
+			}
+		});
+		for (int i = 0; i < 50000; ++i)
+			interner.Intern("reader" + std::to_string(i));
+		done = true;
+		reader.join();
+		CHECK(wrong == 0);
+	}
+
+	SECTION("seats carry the ids") {
+		// seats of the global interner are resolved when the message is marshaled
+		Hand2Note::SeatInfo seat(0, 7, 53.82, true);
+		seat.InternedNickname(StringInterner::Global().Intern(u8"德州小丑王"));
+		seat.InternedPlayerId(2416948123);
+		CHECK(seat.Nickname() == u8"德州小丑王");
+		CHECK(seat.PlayerId() == 2416948123);
+		Hand2Note::HandStartMessage start(Hand2Note::Room::PokerMaster, 1);
+		start.Seats({ seat, Hand2Note::SeatInfo(u8"张琳", 2, 168.45) });
+		h2n_start_hand_message m;
+		Hand2Note::Protocol::Marshal(start, &m);
+		CHECK(std::string(m.seats[0].nickname) == u8"德州小丑王");
+		CHECK(std::string(m.seats[0].player_id) == "2416948123");
+		CHECK(std::string(m.seats[1].nickname) == u8"张琳");
+		CHECK(std::string(m.seats[1].player_id) == "0");
+
+		// a plain nickname or player id replaces the interned one
+		seat.Nickname("plain");
+		seat.PlayerId(5);
+		CHECK(seat.InternedNickname() == StringInterner::None);
+		start.Seats({ seat });
+		Hand2Note::Protocol::Marshal(start, &m);
+		CHECK(std::string(m.seats[0].nickname) == "plain");
+		CHECK(std::string(m.seats[0].player_id) == "5");
+
+		// an id the full interner didn't give leaves the plain nickname
+		seat.InternedNickname(StringInterner::None);
+		CHECK(seat.Nickname() == "plain");
+		seat.InternedNickname(StringInterner::Global().Intern(u8"德州小丑王"));
+		seat.InternedNickname(StringInterner::None);
+		CHECK(seat.Nickname().empty());
+	}
+}
+
+TEST_CASE("TestSharedRing")
+{
+	const std::string name = "/h2napi-test-ring-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	Hand2Note::SharedRing consumer, producer;
+	CHECK_FALSE(producer.Open(name.c_str()));
+	REQUIRE(consumer.Open(name.c_str(), 4096, true));
+	// an existing ring is opened with its own capacity only
+	CHECK_FALSE(producer.Open(name.c_str(), 8192));
+	CHECK_FALSE(producer.Open(name.c_str(), Hand2Note::SharedRing::AnyCapacity, true));
+	REQUIRE(producer.Open(name.c_str(), Hand2Note::SharedRing::AnyCapacity));
+	CHECK(producer.Capacity() == 4096);
+	REQUIRE(producer.Open(name.c_str(), 4096));
+	Hand2Note::SharedRing::Remove(name.c_str());
+
+	CHECK_FALSE(producer.ConsumerAttached());
+	REQUIRE(consumer.Attach());
+	CHECK(producer.ConsumerAttached());
+	CHECK(producer.ConsumerAlive());
+
+	std::vector<std::string> received;
+	auto poll = [&] {
+		return consumer.Poll([&](const uint8_t* data, size_t size) { received.push_back(std::string((const char*)data, size)); });
+	};
+
+	SECTION("records in order") {
+		CHECK(producer.Write("first", 5) == Hand2Note::RingResult::Ok);
+		CHECK(producer.Write("", 0) == Hand2Note::RingResult::Ok);
+		CHECK(producer.Write("third record", 12) == Hand2Note::RingResult::Ok);
+		CHECK(producer.Used() == 16 + 8 + 24);
+		CHECK(poll() == 3);
+		REQUIRE(received.size() == 3);
+		CHECK(received[0] == "first");
+		CHECK(received[1] == "");
+		CHECK(received[2] == "third record");
+		CHECK(producer.Used() == 0);
+		CHECK(poll() == 0);
+	}
+
+	SECTION("commit less than reserved") {
+		uint8_t* data;
+		REQUIRE(producer.Reserve(100, data) == Hand2Note::RingResult::Ok);
+		memcpy(data, "in place", 8);
+		producer.Commit(data, 8, 100);
+		REQUIRE(producer.Reserve(50, data) == Hand2Note::RingResult::Ok);
+		producer.Cancel(data, 50);
+		CHECK(producer.Write("last", 4) == Hand2Note::RingResult::Ok);
+		CHECK(poll() == 2);
+		REQUIRE(received.size() == 2);
+		CHECK(received[0] == "in place");
+		CHECK(received[1] == "last");
+		CHECK(producer.Used() == 0);
+	}
+
+	SECTION("full and wrap around") {
+		std::string record(1000, 'x');
+		int written = 0;
+		while (producer.Write(record.data(), record.size()) == Hand2Note::RingResult::Ok)
+			++written;
+		CHECK(written == 4);
+		CHECK(producer.Write(record.data(), record.size()) == Hand2Note::RingResult::Full);
+		CHECK(producer.Write(std::string(producer.MaxRecord() + 1, 'x').data(), producer.MaxRecord() + 1) == Hand2Note::RingResult::TooLarge);
+
+		// records never straddle the end, the rest of the ring is skipped
+		poll();
+		received.clear();
+		std::vector<std::string> sent;
+		for (int i = 0; i < 50; ++i) {
+			std::string next(300 + i * 97 % 1200, (char)('a' + i % 26));
+			while (producer.Write(next.data(), next.size()) == Hand2Note::RingResult::Full)
+				REQUIRE(consumer.Poll([&](const uint8_t* data, size_t size) { received.push_back(std::string((const char*)data, size)); }, 1) == 1);
+			sent.push_back(next);
+		}
+		poll();
+		CHECK(received == sent);
+		CHECK(producer.Used() == 0);
+	}
+
+	SECTION("concurrent producers") {
+		const int threads = 4, per_thread = 20000;
+		std::vector<std::thread> pool;
+		for (int t = 0; t < threads; ++t) {
+			pool.emplace_back([&producer, t] {
+				for (int i = 0; i < per_thread; ++i) {
+					uint64_t v[2] = { (uint64_t)t, (uint64_t)i };
+					while (producer.Write(v, (i % 2 + 1) * 8) != Hand2Note::RingResult::Ok)
+						std::this_thread::yield();
+				}
+			});
+		}
+		std::vector<uint64_t> next(threads, 0);
+		int bad = 0, total = 0;
+		while (total < threads * per_thread) {
+			total += (int)consumer.Poll([&](const uint8_t* data, size_t size) {
+				uint64_t v[2] = { 0, 0 };
+				memcpy(v, data, size);
+				if (v[0] >= (uint64_t)threads) {
+					++bad;
+					return;
+				}
+				// the second word is only written for odd numbers
+				uint64_t i = size == 16 ? v[1] : next[v[0]];
+				if (i != next[v[0]] || size != (i % 2 + 1) * 8)
+					++bad;
+				else
+					++next[v[0]];
+			});
+		}
+		for (auto& th : pool)
+			th.join();
+		CHECK(bad == 0);
+		CHECK(producer.Used() == 0);
+	}
+
+	consumer.Detach();
+	CHECK_FALSE(producer.ConsumerAttached());
+	CHECK_FALSE(producer.CheckConsumer());
+
+#ifndef _WIN32
+	// a consumer that exits without Detach stays attached until a process check
+	const pid_t child = fork();
+	REQUIRE(child >= 0);
+	if (!child)
+		_exit(consumer.Attach() ? 0 : 1);
+	int exit_status = -1;
+	REQUIRE(waitpid(child, &exit_status, 0) == child);
+	REQUIRE(exit_status == 0);
+	CHECK(producer.ConsumerAttached());
+	CHECK_FALSE(producer.ConsumerAlive());
+	CHECK_FALSE(producer.CheckConsumer());
+	CHECK_FALSE(producer.ConsumerAttached());
+	REQUIRE(consumer.Attach());
+	CHECK(producer.CheckConsumer());
+	consumer.Detach();
+#endif
+}
@@ -1,55 +1,107 @@
 ﻿#include "catch.hpp"
 #include "h2napi.hpp"
 
-#include <windows.h>
+#include <climits>
 #include <regex>
 #include <random>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include "h2napi_ring.hpp"
+	#include <unistd.h>
+#endif
+
+// With h2napi.dll the messages go to the running Hand2Note and the windows are real ones.
+// Elsewhere the local transport sends them to a ring the test consumes in place of Hand2Note,
+// and any table window handle is taken.
+namespace {
+
+	bool IsHand2NoteWindowOpen() {
+#ifdef _WIN32
+		return FindWindowW(NULL, L"Hand2Note 2") != 0;
+#else
+		const char* env = getenv("H2NAPI_RING");
+		Hand2Note::SharedRing ring;
+		return ring.Open(env && *env ? env : Hand2Note::SharedRing::DefaultName(), Hand2Note::SharedRing::AnyCapacity) && ring.ConsumerAlive();
+#endif
+	}
+
+	bool IsTableWindow(int hwnd) {
+#ifdef _WIN32
+		return IsWindow((HWND)(intptr_t)hwnd) != 0;
+#else
+		return hwnd != 0;
+#endif
+	}
+
+	void SleepMs(unsigned ms) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	}
+
+	// Hand2Note for the duration of a test case: nothing with h2napi.dll, a consumer attached
+	// to a ring of the test's own otherwise. The messages are left in the ring.
+	class TestHand2Note {
+	public:
+#ifdef _WIN32
+		explicit TestHand2Note(const char*) {}
+#else
+		explicit TestHand2Note(const char* test) : name_(std::string("/h2napi-test-") + test + "-" + std::to_string(getpid())) {
+			Hand2Note::SharedRing::Remove(name_.c_str());
+			setenv("H2NAPI_RING", name_.c_str(), 1);
+			REQUIRE(ring_.Open(name_.c_str(), Hand2Note::SharedRing::DefaultCapacity, true));
+			REQUIRE(ring_.Attach());
+			// the producer looks at the ring name again after 100 ms
+			for (int i = 0; i < 50 && !Hand2Note::Protocol::IsConsumerAttached(); ++i)
+				SleepMs(10);
+			REQUIRE(Hand2Note::Protocol::IsConsumerAttached());
+		}
+		~TestHand2Note() {
+			ring_.Detach();
+			Hand2Note::SharedRing::Remove(name_.c_str());
+		}
 
+	private:
+		const std::string name_;
+		Hand2Note::SharedRing ring_;
+#endif
+	};
+}
 
 TEST_CASE("TestActivityMonitor")
 {
 
-	// IsHand2NoteRunning static method
-	CHECK((FindWindowW(NULL, L"Hand2Note 2") != 0) == Hand2Note::ActivityMonitor::IsHand2NoteRunning());
+	// IsRunning method
+	Hand2Note::ClientStatusChecker status;
+	CHECK(IsHand2NoteWindowOpen() == status.IsRunning());
 
 
 	// override events class
-	class MyActivityMonitor : public Hand2Note::ActivityMonitor {
+	class MyActivityMonitor : public Hand2Note::ClientControl {
 	public:
-		using ActivityMonitor::ActivityMonitor;
-
-		void Hand2NoteStarted() override {
+		void OnStart() override {
 			INFO("Hand2NoteStarted Fired");
 			IsHand2NoteStartedFired = true;
 		}
 
-		void Hand2NoteClosed() override {
+		void OnClose() override {
 			INFO("Hand2NoteClosed Fired");
 		}
 
 		std::atomic_bool IsHand2NoteStartedFired{ false };
 	};
 
-	
-	bool IsSendOnStarImmediate = true; // or false
-
-	MyActivityMonitor monitor(IsSendOnStarImmediate);
-
-	// you can change poll delay for ActivityMonitor (time interval between IsHand2NoteRunning checks) 
-	CHECK(300 == monitor.PollDelay());
-	monitor.PollDelay(100);
+	MyActivityMonitor monitor;
 
-
-	if (MyActivityMonitor::IsHand2NoteRunning())
+	if (monitor.IsRunning())
 	{
-		// if h2n is running and  IsSendOnStarImmediate is set to true we expect OnHand2NoteStart to be fired almost immediately
+		// if h2n is running we expect OnStart to be fired almost immediately
 		for(int i = 0; i < 5 && !monitor.IsHand2NoteStartedFired; ++i)
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			SleepMs(100);
 
-		CHECK( IsSendOnStarImmediate == monitor.IsHand2NoteStartedFired );
+		CHECK( monitor.IsHand2NoteStartedFired );
 
-		// close h2n manually and wait some time for ActivityMonitor::OnHand2NoteStop 
-		// std::this_thread::sleep_for(std::chrono::milliseconds(10000));
+		// close h2n manually and wait some time for ClientControl::OnClose
+		// SleepMs(10000);
 	}
 
 }
@@ -58,20 +110,20 @@ TEST_CASE("TestActivityMonitor")
 TEST_CASE("TestH2NTableName")
 {
 	// hand2note only accept handhistories and dynamic data with XXXXnnnnnnn table name format, where XXXX is room prefix, nnnnnnn - some hash from original table name
-	// to convert original table name to format supported by h2n use [Hand2Note::GetRoomDefiningTableName]
+	// to convert original table name to format supported by h2n use [Hand2Note::Utils::MakeTableName]
 
-	auto s1 = Hand2Note::GetRoomDefiningTableName(Hand2Note::Rooms::FishPokers, "some table name");
+	auto s1 = Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, "some table name");
 	CHECK( std::regex_match(s1, std::regex("^FSHP[0-9]+$")) );
 
-	auto s2 = Hand2Note::GetRoomDefiningTableName(Hand2Note::Rooms::FishPokers, "some table name");
+	auto s2 = Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, "some table name");
 	//// same original table name - same output
 	CHECK(s1 == s2);
 
-	auto s3 = Hand2Note::GetRoomDefiningTableName(Hand2Note::Rooms::FishPokers, "table name");
+	auto s3 = Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, "table name");
 	CHECK(s1 != s3);
 
 
-	auto s4 = Hand2Note::GetRoomDefiningTableName(Hand2Note::Rooms::PokerStars, "table name");
+	auto s4 = Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerStars, "table name");
 	// same original table name but different prefix
 	CHECK(s3 != s4);
 
@@ -93,6 +145,8 @@ template<class T> T my_rand(T _min0, T _max0) {
 
 TEST_CASE("TestSendCompletedHandHistory")
 {
+	TestHand2Note h2n("completed");
+
 	// Hand2Note api requires UTF8 strings
         static const std::string PokerFishFormattedHandHistory = u8R"(PokerStars Hand #2416948123: Hold'em No Limit ($0.25/$0.50 USD) - 2019/01/21 13:44:57 ET
 Table '大安上王33' 9-max Seat #7 is the button
@@ -155,7 +209,7 @@ Seat 8: 德州小丑王 (small blind) folded on the Turn
 		CHECK(realName == tableName);
 
 		// make table name required by h2n
-		auto h2nTableName = Hand2Note::GetRoomDefiningTableName(Hand2Note::Rooms::FishPokers, tableName);
+		auto h2nTableName = Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, tableName);
 		REQUIRE(std::regex_match(h2nTableName, std::regex("^FSHP[0-9]+$")));
 
 		// replace
@@ -167,25 +221,25 @@ Seat 8: 德州小丑王 (small blind) folded on the Turn
 		Hand2Note::HandHistoryMessage msg;
 
 		// hand history format is pokerstars
-		msg.Format ( Hand2Note::HandHistoryFormats::Stars );
+		msg.Format ( Hand2Note::HandHistoryFormat::PokerStars );
 
 		// next params required by h2n for quick search / reject dups w/o parsing handhistory
 		// room is pokerfishS
-		msg.Room ( Hand2Note::Rooms::FishPokers );
+		msg.room ( Hand2Note::Room::PokerFish );
 		// game id / hand id
 		REQUIRE(std::regex_search(HandHistory, match, std::regex("Hand #([0-9]+):")));
-		msg.GameNumber ( atoll(match[1].str().c_str()) );
-		CHECK(msg.GameNumber() == 2416948123);
+		msg.GameId( atoll(match[1].str().c_str()) );
+		CHECK(msg.GameId() == 2416948123);
 		// lets randomize it for testing
 		auto newGameId = my_rand(INT_MAX / 2, INT_MAX);
 		HandHistory = std::regex_replace(HandHistory, std::regex(match[1].str()), std::to_string(newGameId));
-		msg.GameNumber ( newGameId );
+		msg.GameId( newGameId );
 
 		// IsZoom == false by default
 		CHECK_FALSE(msg.IsZoom());
 
 		// handhistory in msg.Format (pokerstars)
-		msg.HandHistory ( HandHistory );
+		msg.FormattedHandHistory ( HandHistory );
 
 		// original handhistory is internal room format, for example xml for connective
 		// for pokerfish there is no original format
@@ -194,13 +248,15 @@ Seat 8: 德州小丑王 (small blind) folded on the Turn
 
 		// send message, check h2n smart inspect (.sil) log for
 		// 'Integrated Hh #XXXX = "PokerStars Hand #XXXX ...' message
-		CHECK( Hand2Note::Send(msg) == 0 );
+		CHECK( Hand2Note::Protocol::SendHandHistory(msg) == 0 );
 
 
 }
 
 TEST_CASE("TestSendDynamicHandHistory")
 {
+	TestHand2Note h2n("dynamic");
+
 	// Dynamic hand template
 	// ----------------------------------------------------------------------------------------------------
 	//PokerStars Hand #2416948123: Hold'em No Limit ($0.25/$0.50 USD) - 2019/01/21 13:44:57 ET
@@ -241,14 +297,14 @@ TEST_CASE("TestSendDynamicHandHistory")
 	msg.Ante ( 0.25 );
 	msg.SmallBlind ( 0.25 );
 	msg.BigBlind ( 0.5 );
-	msg.Currency (Hand2Note::Currencies::Yuan );
+	msg.SetCurrency (Hand2Note::Currency::Yuan );
 	// real gameId is 2416948123, but we'll use random for testing
-	msg.GameNumber ( my_rand(INT_MAX / 2, INT_MAX) );
-	msg.Room (Hand2Note::Rooms::FishPokers );
-	msg.TableSize ( 9 );
+	msg.GameId( my_rand(INT_MAX / 2, INT_MAX) );
+	msg.room (Hand2Note::Room::PokerFish );
+	msg.MaxPlayers ( 9 );
 	// need table name in h2n format, XXXXnnnn
 	auto realName = u8"大安上王33";
-	msg.TableName ( Hand2Note::GetRoomDefiningTableName(Hand2Note::Rooms::FishPokers, realName) );
+	msg.TableName ( Hand2Note::Utils::MakeTableName(Hand2Note::Room::PokerFish, realName) );
 	CHECK(std::regex_match(msg.TableName(), std::regex("^FSHP[0-9]+$")));
 
 	// check default values...
@@ -263,259 +319,264 @@ TEST_CASE("TestSendDynamicHandHistory")
 
 	static const auto HASHF = std::hash<std::string>();
 
+	Hand2Note::HandStartMessage::SeatsList seats;
+
 	// there are 6 seats in template
 	// -- seat 1 -------------------------------------------------------
-	Hand2Note::PlayerSeatInfo s1;
+	Hand2Note::SeatInfo s1;
 	s1.Nickname ( u8"无能为力" );
 	// player id used in china rooms, fill it with hash if you cant get real playerId
-	s1.PlayerShowId ( std::to_string(HASHF(s1.Nickname()) & 0xFFFFFFFF) );
+	s1.PlayerId ( std::to_string(HASHF(s1.Nickname()) & 0xFFFFFFFF) );
 	// h2n seat indexes are in [0..MaxPlayers-1]
 	s1.SeatIndex ( 0 ); // 1
-	s1.InitialStackSize( 109.54 );
+	s1.Stack( 109.54 );
 	// seat 1 posted big blind
-	s1.SetPostedBigBlind();
+	s1.SetPostedBigBlind(true);
 	// everything else is false by default
 	CHECK_FALSE( (s1.IsDealer() || s1.IsHero() || s1.IsPostedSmallBlind() ||
-		s1.IsPostedStraddle() || s1.IsPostedSmallBlindOutOfQueue() || s1.IsPostedBigBlindOutOfQueue() || s1.IsSittingOut()) );
+		s1.IsPostedStaddle() || s1.IsPostedSmallBlindOutOfQueue() || s1.IsPostedBigBlindOutOfQueue() || s1.IsSittingOut()) );
 	// no poket cards
 	CHECK(s1.PoketCards().empty());
-	msg.Seats().emplace_back(s1);
+	seats.emplace_back(s1);
 
 	// -- seat 3 -------------------------------------------------------
-	Hand2Note::PlayerSeatInfo s3;
+	Hand2Note::SeatInfo s3;
 	s3.Nickname ( u8"张琳" );
-	s3.PlayerShowId(std::to_string(HASHF(s3.Nickname()) & 0xFFFFFFFF));
+	s3.PlayerId(std::to_string(HASHF(s3.Nickname()) & 0xFFFFFFFF));
 	s3.SeatIndex(2); // 3
-	s3.InitialStackSize(168.45);
+	s3.Stack(168.45);
 	CHECK_FALSE( (s3.IsDealer() || s3.IsHero() || s3.IsPostedSmallBlind() || s3.IsPostedBigBlind() ||
-		s3.IsPostedStraddle() || s3.IsPostedSmallBlindOutOfQueue() || s3.IsPostedBigBlindOutOfQueue() ||
+		s3.IsPostedStaddle() || s3.IsPostedSmallBlindOutOfQueue() || s3.IsPostedBigBlindOutOfQueue() ||
 		s3.IsSittingOut() ));
 	CHECK(s3.PoketCards().empty());
-	msg.Seats().emplace_back(s3);
+	seats.emplace_back(s3);
 
 	// -- seat 4 -------------------------------------------------------
-	Hand2Note::PlayerSeatInfo s4;
+	Hand2Note::SeatInfo s4;
 	s4.Nickname ( u8"天天大水上" );
-	s4.PlayerShowId(std::to_string(HASHF(s4.Nickname()) & 0xFFFFFFFF));
+	s4.PlayerId(std::to_string(HASHF(s4.Nickname()) & 0xFFFFFFFF));
 	s4.SeatIndex( 3); // 4
-	s4.InitialStackSize (59.26);
+	s4.Stack (59.26);
 	CHECK_FALSE( (s4.IsDealer() || s4.IsHero() || s4.IsPostedSmallBlind() || s4.IsPostedBigBlind() ||
-		s4.IsPostedStraddle() || s4.IsPostedSmallBlindOutOfQueue() || s4.IsPostedBigBlindOutOfQueue() ||
+		s4.IsPostedStaddle() || s4.IsPostedSmallBlindOutOfQueue() || s4.IsPostedBigBlindOutOfQueue() ||
 		s4.IsSittingOut()));
 	CHECK(s4.PoketCards().empty());
-	msg.Seats().emplace_back(s4);
+	seats.emplace_back(s4);
 
 
 	// -- seat 5 -------------------------------------------------------
-	Hand2Note::PlayerSeatInfo s5;
+	Hand2Note::SeatInfo s5;
 	s5.Nickname(u8"安排！");
-	s5.PlayerShowId(std::to_string(HASHF(s5.Nickname()) & 0xFFFFFFFF));
+	s5.PlayerId(std::to_string(HASHF(s5.Nickname()) & 0xFFFFFFFF));
 	s5.SeatIndex(4); // 5
-	s5.InitialStackSize (48.14);
+	s5.Stack (48.14);
 	CHECK_FALSE( (s5.IsDealer() || s5.IsHero() || s5.IsPostedSmallBlind() || s5.IsPostedBigBlind() ||
-		s5.IsPostedStraddle() || s5.IsPostedSmallBlindOutOfQueue() || s5.IsPostedBigBlindOutOfQueue() ||
+		s5.IsPostedStaddle() || s5.IsPostedSmallBlindOutOfQueue() || s5.IsPostedBigBlindOutOfQueue() ||
 		s5.IsSittingOut()));
 	CHECK(s5.PoketCards().empty());
-	msg.Seats().emplace_back(s5);
+	seats.emplace_back(s5);
 
 	// -- seat 7 -------------------------------------------------------
-	Hand2Note::PlayerSeatInfo s7;
+	Hand2Note::SeatInfo s7;
 	s7.Nickname ( u8"木樽" );
-	s7.PlayerShowId(std::to_string(HASHF(s7.Nickname()) & 0xFFFFFFFF));
+	s7.PlayerId(std::to_string(HASHF(s7.Nickname()) & 0xFFFFFFFF));
 	s7.SeatIndex (6); // 7
-	s7.InitialStackSize (247.19);
+	s7.Stack (247.19);
 	// seat 7 is dealer
-	s7.SetDealer();
+	s7.SetDealer(true);
 	CHECK_FALSE((s7.IsHero() || s7.IsPostedSmallBlind() || s7.IsPostedBigBlind() ||
-		s7.IsPostedStraddle() || s7.IsPostedSmallBlindOutOfQueue() || s7.IsPostedBigBlindOutOfQueue() ||
+		s7.IsPostedStaddle() || s7.IsPostedSmallBlindOutOfQueue() || s7.IsPostedBigBlindOutOfQueue() ||
 		s7.IsSittingOut()));
 	CHECK(s7.PoketCards().empty());
-	msg.Seats().emplace_back(s7);
+	seats.emplace_back(s7);
 
 	// -- seat 8 -------------------------------------------------------
-	Hand2Note::PlayerSeatInfo s8;
+	Hand2Note::SeatInfo s8;
 	s8.Nickname ( u8"德州小丑王" );
-	s8.PlayerShowId(std::to_string(HASHF(s8.Nickname()) & 0xFFFFFFFF));
+	s8.PlayerId(std::to_string(HASHF(s8.Nickname()) & 0xFFFFFFFF));
 	s8.SeatIndex ( 7); // 8
-	s8.InitialStackSize ( 53.82);
+	s8.Stack ( 53.82);
 	// seat 8 posted small blind
-	s8.SetPostedSmallBlind();
+	s8.SetPostedSmallBlind(true);
 	// lets say its hero
-	s8.SetHero();
+	s8.SetHero(true);
 	CHECK_FALSE( (s8.IsDealer() || s8.IsPostedBigBlind() ||
-		s8.IsPostedStraddle() || s8.IsPostedSmallBlindOutOfQueue() || s8.IsPostedBigBlindOutOfQueue() ||
+		s8.IsPostedStaddle() || s8.IsPostedSmallBlindOutOfQueue() || s8.IsPostedBigBlindOutOfQueue() ||
 		s8.IsSittingOut()));
 	// is hero flag can be used with or without poket cards, h2n uses IsHero to arrange huds
 	CHECK(s8.PoketCards().empty());
-	msg.Seats().emplace_back(s8);
+	seats.emplace_back(s8);
 
+	msg.Seats(seats);
 	CHECK(6 == msg.Seats().size());
 
 	// -------------------------------------------------------------------
 	// ok we need to assign 'hand start' message to some window via HWND
-	// open notepad, find notepad window handle with spy++ and setup msg.TableWindowHwnd
-	msg.TableWindowHwnd ( 0x00F418FE );
-	if (!IsWindow((HWND)msg.TableWindowHwnd()))
+	// open notepad, find notepad window handle with spy++ and setup msg.TableHwnd
+	msg.TableHwnd ( 0x00F418FE );
+	if (!IsTableWindow(msg.TableHwnd()))
 	{
 		INFO("HandStart Message requires valid window handle");
 	}
-	REQUIRE(IsWindow((HWND)msg.TableWindowHwnd()));
+	REQUIRE(IsTableWindow(msg.TableHwnd()));
 
 	// send message, h2n huds should appear on notepad window
-	CHECK( 0 == Hand2Note::Send(msg) );
+	CHECK( 0 == Hand2Note::Protocol::SendHandStart(msg) );
 
 	auto DELAY = 500u;
 
 	// 张琳: raises $0.50 to $1
 	Hand2Note::HandActionMessage a1_msg;
-	a1_msg.GameNumber ( msg.GameNumber() );
-	a1_msg.ActionType (Hand2Note::Actions::Raise);
+	a1_msg.GameId( msg.GameId() );
+	a1_msg.ActionType (Hand2Note::Action::Raise);
 	a1_msg.Amount ( 0.5 );
 	a1_msg.SeatIndex ( 2 );
-	Hand2Note::Send(a1_msg);
+	Hand2Note::Protocol::SendHandActon(a1_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	// 天天大水上: folds
 	Hand2Note::HandActionMessage a2_msg;
-	a2_msg.GameNumber ( msg.GameNumber() );
-	a2_msg.ActionType (Hand2Note::Actions::Fold);
+	a2_msg.GameId( msg.GameId() );
+	a2_msg.ActionType (Hand2Note::Action::Fold);
 	CHECK(0 == a2_msg.Amount() );
 	a2_msg.SeatIndex ( 3 );
-	Hand2Note::Send(a2_msg);
+	Hand2Note::Protocol::SendHandActon(a2_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//安排！: folds
 	Hand2Note::HandActionMessage a3_msg;
-	a3_msg.GameNumber ( msg.GameNumber() );
-	a3_msg.ActionType (Hand2Note::Actions::Fold );
+	a3_msg.GameId( msg.GameId() );
+	a3_msg.ActionType (Hand2Note::Action::Fold );
 	CHECK( 0 == a3_msg.Amount() );
 	a3_msg.SeatIndex ( 4 );
-	Hand2Note::Send(a3_msg);
+	Hand2Note::Protocol::SendHandActon(a3_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//木樽: folds
 	Hand2Note::HandActionMessage a4_msg;
-	a4_msg.GameNumber ( msg.GameNumber() );
-	a4_msg.ActionType (Hand2Note::Actions::Fold );
+	a4_msg.GameId( msg.GameId() );
+	a4_msg.ActionType (Hand2Note::Action::Fold );
 	CHECK(0 == a4_msg.Amount());
 	a4_msg.SeatIndex ( 6 );
-	Hand2Note::Send(a4_msg);
+	Hand2Note::Protocol::SendHandActon(a4_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//德州小丑王: calls $0.75
 	Hand2Note::HandActionMessage a5_msg;
-	a5_msg.GameNumber ( msg.GameNumber() );
-	a5_msg.ActionType (Hand2Note::Actions::Call);
+	a5_msg.GameId( msg.GameId() );
+	a5_msg.ActionType (Hand2Note::Action::Call);
 	a5_msg.Amount ( 0.75 );
 	a5_msg.SeatIndex ( 7 );
-	Hand2Note::Send(a5_msg);
+	Hand2Note::Protocol::SendHandActon(a5_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//无能为力: folds
 	Hand2Note::HandActionMessage a6_msg;
-	a6_msg.GameNumber ( msg.GameNumber() );
-	a6_msg.ActionType (Hand2Note::Actions::Fold );
+	a6_msg.GameId( msg.GameId() );
+	a6_msg.ActionType (Hand2Note::Action::Fold );
 	CHECK(0 == a6_msg.Amount());
 	a6_msg.SeatIndex ( 0 );
-	Hand2Note::Send(a6_msg);
+	Hand2Note::Protocol::SendHandActon(a6_msg);
 
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	// POT = 3.50
 	//*** FLOP *** [5h 8s 7s]
-	Hand2Note::HandDealMessage flop_msg;
-	flop_msg.GameNumber ( msg.GameNumber() );
+	Hand2Note::HandStreetMessage flop_msg;
+	flop_msg.GameId( msg.GameId() );
 	flop_msg.Board ( "5h8s7s" );
-	flop_msg.Street (Hand2Note::Streets::Flop);
+	flop_msg.StreetType (Hand2Note::Street::Flop);
 	flop_msg.Pot ( 3.50 );
-	Hand2Note::Send(flop_msg);
+	Hand2Note::Protocol::SendHandStreed(flop_msg);
 
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//德州小丑王: checks
 	Hand2Note::HandActionMessage a7_msg;
-	a7_msg.GameNumber ( msg.GameNumber() );
-	a7_msg.ActionType (Hand2Note::Actions::Check );
+	a7_msg.GameId( msg.GameId() );
+	a7_msg.ActionType (Hand2Note::Action::Check );
 	CHECK(0 == a7_msg.Amount());
 	a7_msg.SeatIndex ( 7 );
-	Hand2Note::Send(a7_msg);
+	Hand2Note::Protocol::SendHandActon(a7_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//张琳: bets $2.66
 	Hand2Note::HandActionMessage a8_msg;
-	a8_msg.GameNumber ( msg.GameNumber() );
-	a8_msg.ActionType (Hand2Note::Actions::Bet);
+	a8_msg.GameId( msg.GameId() );
+	a8_msg.ActionType (Hand2Note::Action::Bet);
 	a8_msg.Amount ( 2.66 );
 	a8_msg.SeatIndex ( 2 );
-	Hand2Note::Send(a8_msg);
+	Hand2Note::Protocol::SendHandActon(a8_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//德州小丑王: calls $2.66
 	Hand2Note::HandActionMessage a9_msg;
-	a9_msg.GameNumber( msg.GameNumber() );
-	a9_msg.ActionType(Hand2Note::Actions::Call);
+	a9_msg.GameId( msg.GameId() );
+	a9_msg.ActionType(Hand2Note::Action::Call);
 	a9_msg.Amount ( 2.66 );
 	a9_msg.SeatIndex ( 7 );
-	Hand2Note::Send(a9_msg);
+	Hand2Note::Protocol::SendHandActon(a9_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	// POT = 8.82
 	//*** TURN *** [5h 8s 7s] [Ts]
-	Hand2Note::HandDealMessage turn_msg;
-	turn_msg.GameNumber ( msg.GameNumber() );
+	Hand2Note::HandStreetMessage turn_msg;
+	turn_msg.GameId( msg.GameId() );
 	turn_msg.Board ( "5h8s7sTs" );
-	turn_msg.Street (Hand2Note::Streets::Turn);
+	turn_msg.StreetType (Hand2Note::Street::Turn);
 	turn_msg.Pot ( 8.82 );
-	Hand2Note::Send(turn_msg);
+	Hand2Note::Protocol::SendHandStreed(turn_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	//德州小丑王: checks
 	Hand2Note::HandActionMessage a10_msg;
-	a10_msg.GameNumber ( msg.GameNumber() );
-	a10_msg.ActionType (Hand2Note::Actions::Check );
+	a10_msg.GameId( msg.GameId() );
+	a10_msg.ActionType (Hand2Note::Action::Check );
 	CHECK( 0 == a10_msg.Amount());
 	a10_msg.SeatIndex ( 7 );
-	Hand2Note::Send(a10_msg);
+	Hand2Note::Protocol::SendHandActon(a10_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	// 张琳: bets $6.21
 	Hand2Note::HandActionMessage a11_msg;
-	a11_msg.GameNumber ( msg.GameNumber() );
-	a11_msg.ActionType (Hand2Note::Actions::Bet );
+	a11_msg.GameId( msg.GameId() );
+	a11_msg.ActionType (Hand2Note::Action::Bet );
 	a11_msg.Amount ( 6.21 );
 	a11_msg.SeatIndex ( 2 );
-	Hand2Note::Send(a11_msg);
+	Hand2Note::Protocol::SendHandActon(a11_msg);
 
-	Sleep(DELAY);
+	SleepMs(DELAY);
 
 	// 德州小丑王: folds
 	Hand2Note::HandActionMessage a12_msg;
-	a12_msg.GameNumber ( msg.GameNumber() );
-	a12_msg.ActionType (Hand2Note::Actions::Fold );
+	a12_msg.GameId( msg.GameId() );
+	a12_msg.ActionType (Hand2Note::Action::Fold );
 	CHECK(0 == a12_msg.Amount());
 	a12_msg.SeatIndex ( 7 );
-	Hand2Note::Send(a12_msg);
+	Hand2Note::Protocol::SendHandActon(a12_msg);
 
 }
 
 TEST_CASE("TestSendCloseHudCommand")
 {
-	Hand2Note::Send(0x00F418FE, Hand2Note::Rooms::FishPokers, Hand2Note::Commands::CloseHud);
+	TestHand2Note h2n("closehud");
+	CHECK( 0 == Hand2Note::Protocol::SendCommand(0x00F418FE, Hand2Note::Room::PokerFish, Hand2Note::Command::CloseHud) );
 }
 
 TEST_CASE("TestSendTableNeedReopenCommand")
 {
-	Hand2Note::Send(0x00F418FE, Hand2Note::Rooms::FishPokers, Hand2Note::Commands::ReopenTable);
+	TestHand2Note h2n("reopen");
+	CHECK( 0 == Hand2Note::Protocol::SendCommand(0x00F418FE, Hand2Note::Room::PokerFish, Hand2Note::Command::ReopenTable) );
 }
\ No newline at end of file
@@ -0,0 +1,365 @@
+// Synthetic multi-table load for the h2napi send functions.
+//
+//   h2n_loadgen [--tables N] [--seats N] [--game nlhe|plo|plo5|shortdeck] [--rate N]
+//               [--duration S] [--nicknames latin|cjk|mixed] [--room N]
+//
+// Every table runs in its own thread and plays random hands: HandStartMessage,
+// then HandActionMessage / HandStreetMessage until one player is left or the river
+// is played out. --rate limits the actions per second per table (0 is unlimited).
+// Achieved throughput and latency percentiles of the send calls are printed at the end.
+
+#include "h2napi.hpp"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+namespace {
+
+	enum class Game { NLHE, PLO, PLO5, ShortDeck };
+	enum class Script { Latin, CJK, Mixed };
+
+	struct Options {
+		int tables = 4;
+		int seats = 6;
+		Game game = Game::NLHE;
+		double rate = 0;
+		double duration = 5;
+		Script nicknames = Script::Mixed;
+		Hand2Note::Room room = Hand2Note::Room::PokerMaster;
+	};
+
+	// Send latencies in log buckets, 8 per power of two: percentiles within 12.5% in a fixed
+	// few KB per table however long the run
+	struct LatencyHistogram {
+		static const int SubBits = 3;
+		static const int Buckets = (32 - SubBits + 1) << SubBits;
+		uint64_t counts[Buckets] = {};
+		uint64_t total = 0;
+		uint32_t max = 0;
+
+		void Add(uint32_t ns) {
+			++counts[Bucket(ns)];
+			++total;
+			max = std::max(max, ns);
+		}
+
+		void Merge(const LatencyHistogram& other) {
+			for (int b = 0; b < Buckets; ++b)
+				counts[b] += other.counts[b];
+			total += other.total;
+			max = std::max(max, other.max);
+		}
+
+		// the highest value of the bucket holding the p-th percentile
+		uint32_t Percentile(double p) const {
+			if (!total)
+				return 0;
+			uint64_t rank = std::min(total - 1, (uint64_t)(p / 100 * total));
+			uint64_t seen = 0;
+			for (int b = 0; b < Buckets; ++b) {
+				seen += counts[b];
+				if (seen > rank)
+					return std::min(max, Upper(b));
+			}
+			return max;
+		}
+
+		static int Bucket(uint32_t ns) {
+			if (ns < (1u << SubBits))
+				return (int)ns;
+			int e = SubBits;
+			while (e < 31 && ns >> (e + 1))
+				++e;
+			return ((e - SubBits + 1) << SubBits) | (int)((ns >> (e - SubBits)) & ((1u << SubBits) - 1));
+		}
+
+		static uint32_t Upper(int b) {
+			if (b < (1 << SubBits))
+				return (uint32_t)b;
+			int shift = (b >> SubBits) - 1;
+			uint64_t lower = (uint64_t)((1 << SubBits) | (b & ((1 << SubBits) - 1))) << shift;
+			return (uint32_t)(lower + (1ull << shift) - 1);
+		}
+	};
+
+	struct TableStats {
+		size_t hands = 0;
+		size_t messages = 0;
+		size_t failed = 0;
+		size_t queue_full = 0;
+		size_t consumer_absent = 0;
+		LatencyHistogram latency_ns;
+	};
+
+	const char* const LatinNames[] = { "dealer_bob", "nit_king", "xXfishXx", "river_rat", "GTO_wizard", "tilted", "shortstack", "lagtastic", "callstation", "reg_2019" };
+	const char* const CJKNames[] = { u8"无能为力", u8"张琳", u8"天天大水上", u8"安排！", u8"木樽", u8"德州小丑王", u8"大安上王", u8"小鱼儿", u8"王者归来", u8"一路发" };
+
+	std::string Nickname(Script script, std::mt19937& rnd, int seat) {
+		bool cjk = script == Script::CJK || (script == Script::Mixed && rnd() % 2);
+		const char* base = cjk ? CJKNames[rnd() % 10] : LatinNames[rnd() % 10];
+		return std::string(base) + std::to_string(seat);
+	}
+
+	class Table {
+	public:
+		Table(const Options& opt, int index, TableStats& stats) :
+			opt_(opt), stats_(stats), rnd_(std::random_device()() + index),
+			hwnd_(0x10000 + index), game_id_((uint64_t)(index + 1) << 40)
+		{
+			table_name_ = Hand2Note::Utils::MakeTableName(opt.room, "loadgen table " + std::to_string(index));
+		}
+
+		void Run(std::chrono::steady_clock::time_point until) {
+			next_ = std::chrono::steady_clock::now();
+			while (std::chrono::steady_clock::now() < until) {
+				PlayHand();
+				++stats_.hands;
+			}
+		}
+
+	private:
+		const Options& opt_;
+		TableStats& stats_;
+		std::mt19937 rnd_;
+		int hwnd_;
+		uint64_t game_id_;
+		std::string table_name_;
+		std::chrono::steady_clock::time_point next_;
+
+		std::vector<std::string> deck_;
+		double committed_[H2N_MAX_SEATS];
+		double stack_[H2N_MAX_SEATS];
+		bool active_[H2N_MAX_SEATS];
+
+		template<class Fn>
+		void Timed(Fn send) {
+			if (opt_.rate > 0) {
+				next_ += std::chrono::nanoseconds((long long)(1e9 / opt_.rate));
+				std::this_thread::sleep_until(next_);
+			}
+			auto t0 = std::chrono::steady_clock::now();
+			int ret = send();
+			auto t1 = std::chrono::steady_clock::now();
+			stats_.latency_ns.Add((uint32_t)std::min<long long>(UINT32_MAX, std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+			++stats_.messages;
+			if (ret != H2N_STATUS_OK)
+				++stats_.failed;
+			if (ret == H2N_STATUS_QUEUE_FULL)
+				++stats_.queue_full;
+			else if (ret == H2N_STATUS_CONSUMER_ABSENT)
+				++stats_.consumer_absent;
+		}
+
+		void ShuffleDeck() {
+			static const char ranks[] = "23456789TJQKA";
+			static const char suits[] = "cdhs";
+			deck_.clear();
+			for (int r = opt_.game == Game::ShortDeck ? 4 : 0; r < 13; ++r)
+				for (int s = 0; s < 4; ++s)
+					deck_.push_back(std::string(1, ranks[r]) + suits[s]);
+			std::shuffle(deck_.begin(), deck_.end(), rnd_);
+		}
+
+		std::string Deal(int n) {
+			std::string cards;
+			for (int i = 0; i < n; ++i) {
+				cards += deck_.back();
+				deck_.pop_back();
+			}
+			return cards;
+		}
+
+		int PocketCardsNum() const {
+			switch (opt_.game) {
+			case Game::PLO: return 4;
+			case Game::PLO5: return 5;
+			default: return 2;
+			}
+		}
+
+		void PlayHand() {
+			const int seats = opt_.seats;
+			const double sb = 0.25, bb = 0.5;
+			++game_id_;
+			ShuffleDeck();
+
+			Hand2Note::HandStartMessage start(opt_.room, game_id_, hwnd_);
+			start.TableName(table_name_);
+			start.MaxPlayers(seats);
+			start.SetCurrency(Hand2Note::Currency::Yuan);
+			start.SetOmaha(opt_.game == Game::PLO || opt_.game == Game::PLO5);
+			start.SetOmahaFive(opt_.game == Game::PLO5);
+			start.SetPotLimit(start.IsOmaha());
+			start.SetShortDeck(opt_.game == Game::ShortDeck);
+			start.SmallBlind(opt_.game == Game::ShortDeck ? 0 : sb);
+			start.BigBlind(opt_.game == Game::ShortDeck ? 0 : bb);
+			start.Ante(opt_.game == Game::ShortDeck ? bb : 0);
+
+			Hand2Note::HandStartMessage::SeatsList list;
+			int hero = rnd_() % seats;
+			int button = (int)(game_id_ % seats);
+			double pot = 0;
+			for (int i = 0; i < seats; ++i) {
+				Hand2Note::SeatInfo s(Nickname(opt_.nicknames, rnd_, i), i, 20 + rnd_() % 20000 / 100.0, i == hero);
+				s.PlayerId(rnd_());
+				s.SetDealer(i == button);
+				if (i == hero)
+					s.PoketCards(Deal(PocketCardsNum()));
+				stack_[i] = s.Stack();
+				committed_[i] = 0;
+				active_[i] = true;
+				if (opt_.game == Game::ShortDeck) {
+					stack_[i] -= bb;
+					pot += bb;
+				}
+				else if (i == (button + 1) % seats) {
+					s.SetPostedSmallBlind(true);
+					committed_[i] = sb;
+				}
+				else if (i == (button + 2) % seats) {
+					s.SetPostedBigBlind(true);
+					committed_[i] = bb;
+				}
+				list.push_back(s);
+			}
+			start.Seats(list);
+			Timed([&] { return Hand2Note::Protocol::SendHandStart(start); });
+
+			int alive = seats;
+			double to_call = opt_.game == Game::ShortDeck ? 0 : bb;
+			int first = (button + 3) % seats;
+			const Hand2Note::Street streets[] = { Hand2Note::Street::Flop, Hand2Note::Street::Turn, Hand2Note::Street::River };
+			std::string board;
+			for (int street = 0; street < 4 && alive > 1; ++street) {
+				if (street > 0) {
+					for (int i = 0; i < seats; ++i) {
+						pot += committed_[i];
+						stack_[i] -= committed_[i];
+						committed_[i] = 0;
+					}
+					to_call = 0;
+					first = (button + 1) % seats;
+					board += Deal(street == 1 ? 3 : 1);
+					Hand2Note::HandStreetMessage msg(game_id_, streets[street - 1], board);
+					msg.Pot(pot);
+					Timed([&] { return Hand2Note::Protocol::SendHandStreed(msg); });
+				}
+				// the street goes round until every player still in has acted since the last bet or raise,
+				// matching it or all-in
+				bool to_act[H2N_MAX_SEATS];
+				int pending = 0;
+				for (int i = 0; i < seats; ++i)
+					pending += to_act[i] = active_[i] && committed_[i] < stack_[i];
+				for (int i = first; pending > 0 && alive > 1; i = (i + 1) % seats) {
+					if (!to_act[i])
+						continue;
+					to_act[i] = false;
+					--pending;
+					Hand2Note::HandActionMessage msg(game_id_, i, Hand2Note::Action::Fold, 0);
+					unsigned dice = rnd_() % 100;
+					double owe = to_call - committed_[i];
+					double target = std::min(to_call > 0 ? to_call * 3 : bb * 2 + pot / 2, stack_[i]);
+					if (dice < 35 && owe > 0) {
+						active_[i] = false;
+						--alive;
+					}
+					else if (dice < 85 || target <= to_call) {
+						msg.ActionType(owe > 0 ? Hand2Note::Action::Call : Hand2Note::Action::Check);
+						msg.Amount(std::min(owe, stack_[i] - committed_[i]));
+						msg.SetAllin(msg.Amount() > 0 && committed_[i] + msg.Amount() >= stack_[i]);
+						committed_[i] += msg.Amount();
+					}
+					else {
+						msg.ActionType(to_call > 0 ? Hand2Note::Action::Raise : Hand2Note::Action::Bet);
+						msg.Amount(target >= stack_[i] ? stack_[i] : std::floor(target * 100) / 100);
+						msg.SetAllin(target >= stack_[i]);
+						committed_[i] = msg.Amount();
+						to_call = std::max(to_call, committed_[i]);
+						// everyone else who can still act answers the bet
+						pending = 0;
+						for (int j = 0; j < seats; ++j)
+							pending += to_act[j] = j != i && active_[j] && committed_[j] < stack_[j];
+					}
+					double total = pot;
+					for (int j = 0; j < seats; ++j)
+						total += committed_[j];
+					msg.Pot(total);
+					Timed([&] { return Hand2Note::Protocol::SendHandActon(msg); });
+				}
+			}
+		}
+	};
+
+	bool ParseArgs(int argc, char* argv[], Options& opt) {
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (i + 1 >= argc)
+				return false;
+			std::string val = argv[++i];
+			if (arg == "--tables") opt.tables = atoi(val.c_str());
+			else if (arg == "--seats") opt.seats = atoi(val.c_str());
+			else if (arg == "--rate") opt.rate = atof(val.c_str());
+			else if (arg == "--duration") opt.duration = atof(val.c_str());
+			else if (arg == "--room") opt.room = (Hand2Note::Room)atoi(val.c_str());
+			else if (arg == "--game") {
+				if (val == "nlhe") opt.game = Game::NLHE;
+				else if (val == "plo") opt.game = Game::PLO;
+				else if (val == "plo5") opt.game = Game::PLO5;
+				else if (val == "shortdeck") opt.game = Game::ShortDeck;
+				else return false;
+			}
+			else if (arg == "--nicknames") {
+				if (val == "latin") opt.nicknames = Script::Latin;
+				else if (val == "cjk") opt.nicknames = Script::CJK;
+				else if (val == "mixed") opt.nicknames = Script::Mixed;
+				else return false;
+			}
+			else
+				return false;
+		}
+		return opt.tables > 0 && opt.seats >= 2 && opt.seats <= H2N_MAX_SEATS && opt.rate >= 0 && opt.duration > 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!ParseArgs(argc, argv, opt)) {
+		fprintf(stderr, "usage: h2n_loadgen [--tables N] [--seats 2..%d] [--game nlhe|plo|plo5|shortdeck] [--rate N]\n"
+			"                   [--duration S] [--nicknames latin|cjk|mixed] [--room N]\n", H2N_MAX_SEATS);
+		return 1;
+	}
+
+	std::vector<TableStats> stats(opt.tables);
+	std::vector<std::thread> threads;
+	auto begin = std::chrono::steady_clock::now();
+	auto until = begin + std::chrono::nanoseconds((long long)(opt.duration * 1e9));
+	for (int i = 0; i < opt.tables; ++i) {
+		threads.emplace_back([&opt, &stats, i, until] {
+			Table table(opt, i, stats[i]);
+			table.Run(until);
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	TableStats total;
+	for (auto& s : stats) {
+		total.hands += s.hands;
+		total.messages += s.messages;
+		total.failed += s.failed;
+		total.queue_full += s.queue_full;
+		total.consumer_absent += s.consumer_absent;
+		total.latency_ns.Merge(s.latency_ns);
+	}
+	const LatencyHistogram& lat = total.latency_ns;
+
+	printf("tables %d, seats %d, %.2f s\n", opt.tables, opt.seats, seconds);
+	printf("hands %zu (%.0f/s), messages %zu (%.0f/s), failed %zu (queue full %zu, consumer absent %zu)\n",
+		total.hands, total.hands / seconds, total.messages, total.messages / seconds, total.failed, total.queue_full, total.consumer_absent);
+	printf("send latency ns: p50 %u, p90 %u, p99 %u, p99.9 %u, max %u\n",
+		lat.Percentile(50), lat.Percentile(90), lat.Percentile(99), lat.Percentile(99.9), lat.max);
+	return total.failed ? 2 : 0;
+}
@@ -0,0 +1,133 @@
+// Stand-in for Hand2Note on the local transport: creates the SharedRing, attaches as its consumer
+// and decodes every frame sent through the h2napi functions.
+//
+//   h2n_mock_consumer [--ring NAME] [--capacity BYTES] [--duration S] [--verbose]
+//
+// The ring name defaults to H2NAPI_RING or "/h2napi", the one the producers open.
+// Messages per type and malformed records are printed every second and at the end, also
+// when stopped by Ctrl-C or SIGTERM.
+
+#include "h2napi.hpp"
+#include "h2napi_ring.hpp"
+
+#include <csignal>
+
+namespace {
+
+	// set by SIGINT / SIGTERM, the consumer detaches before exiting so producers see it gone
+	volatile std::sig_atomic_t stop = 0;
+
+	void Stop(int) { stop = 1; }
+
+	const char* const TypeNames[] = { "", "handhistory", "handstart", "action", "street", "json", "command" };
+	const int TypeCount = sizeof(TypeNames) / sizeof(TypeNames[0]);
+
+	struct Counters {
+		uint64_t messages[TypeCount] = {};
+		uint64_t bytes = 0;
+		uint64_t malformed = 0;
+
+		void Print(const char* title, double seconds) const {
+			printf("%s %.1f s:", title, seconds);
+			for (int i = 1; i < TypeCount; ++i)
+				printf(" %s %llu", TypeNames[i], (unsigned long long)messages[i]);
+			printf(", %llu bytes, malformed %llu\n", (unsigned long long)bytes, (unsigned long long)malformed);
+			fflush(stdout);
+		}
+	};
+
+	void Decode(const uint8_t* data, size_t size, bool verbose, Counters& counters) {
+		counters.bytes += size;
+		Hand2Note::WireReader reader(data, size);
+		while (reader.Next()) {
+			int type = (int)reader.Type();
+			if (type <= 0 || type >= TypeCount) {
+				++counters.malformed;
+				continue;
+			}
+			++counters.messages[type];
+			if (!verbose)
+				continue;
+			Hand2Note::HandStartMessage start;
+			Hand2Note::HandActionMessage action;
+			Hand2Note::HandStreetMessage street;
+			switch (reader.Type()) {
+			case Hand2Note::WireMessage::HandStart:
+				if (reader.Read(start))
+					printf("handstart %llu %s, %zu seats\n", (unsigned long long)start.GameId(), start.TableName().c_str(), start.Seats().size());
+				break;
+			case Hand2Note::WireMessage::Action:
+				if (reader.Read(action))
+					printf("action %llu seat %d type %d %.2f\n", (unsigned long long)action.GameId(), action.SeatIndex(), (int)action.ActionType(), action.Amount());
+				break;
+			case Hand2Note::WireMessage::Street:
+				if (reader.Read(street))
+					printf("street %llu %s\n", (unsigned long long)street.GameId(), street.Board().c_str());
+				break;
+			default:
+				printf("%s\n", TypeNames[type]);
+				break;
+			}
+		}
+		if (reader.IsError())
+			++counters.malformed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* env = getenv("H2NAPI_RING");
+	std::string name = env && *env ? env : Hand2Note::SharedRing::DefaultName();
+	size_t capacity = Hand2Note::SharedRing::DefaultCapacity;
+	double duration = 0;
+	bool verbose = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--verbose")
+			verbose = true;
+		else if (i + 1 < argc && arg == "--ring")
+			name = argv[++i];
+		else if (i + 1 < argc && arg == "--capacity")
+			capacity = (size_t)strtoull(argv[++i], nullptr, 10);
+		else if (i + 1 < argc && arg == "--duration")
+			duration = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: h2n_mock_consumer [--ring NAME] [--capacity BYTES] [--duration S] [--verbose]\n");
+			return 1;
+		}
+	}
+
+	Hand2Note::SharedRing ring;
+	if (!ring.Open(name.c_str(), capacity, true)) {
+		fprintf(stderr, "can't open ring %s of %zu bytes\n", name.c_str(), capacity);
+		return 1;
+	}
+	if (!ring.Attach()) {
+		fprintf(stderr, "another consumer is attached to %s\n", name.c_str());
+		return 1;
+	}
+
+	std::signal(SIGINT, Stop);
+	std::signal(SIGTERM, Stop);
+
+	Counters total;
+	auto begin = std::chrono::steady_clock::now();
+	auto report = begin + std::chrono::seconds(1);
+	while (!stop) {
+		size_t n = ring.Poll([&](const uint8_t* data, size_t size) { Decode(data, size, verbose, total); });
+		auto now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(now - begin).count();
+		if (duration > 0 && seconds >= duration)
+			break;
+		if (now >= report) {
+			total.Print("received", seconds);
+			report += std::chrono::seconds(1);
+		}
+		// spin while messages arrive, back off when idle
+		if (!n)
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	ring.Detach();
+	total.Print("total", std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+	return 0;
+}
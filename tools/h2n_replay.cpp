@@ -0,0 +1,83 @@
+// Re-issues the calls recorded by Hand2Note::CallRecorder.
+//
+//   h2n_replay <log> [speed]
+//
+// speed is a multiplier of the recorded pace: 1 (default) replays in real time,
+// 10 ten times faster, 0 or "max" sends everything without waiting.
+
+#include "h2napi.hpp"
+
+#include <thread>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: h2n_replay <log> [speed|max]\n");
+		return 1;
+	}
+	double speed = 1;
+	if (argc > 2)
+		speed = strcmp(argv[2], "max") == 0 ? 0 : atof(argv[2]);
+	if (speed < 0) {
+		fprintf(stderr, "invalid speed %s\n", argv[2]);
+		return 1;
+	}
+
+	Hand2Note::CallLogReader log;
+	if (!log.Open(argv[1])) {
+		fprintf(stderr, "can't read call log %s\n", argv[1]);
+		return 1;
+	}
+
+	Hand2Note::HandHistoryMessage hh;
+	Hand2Note::HandStartMessage start;
+	Hand2Note::HandActionMessage action;
+	Hand2Note::HandStreetMessage street;
+	std::string json;
+	int table_hwnd, room, cmd;
+
+	size_t calls = 0, failed = 0, skipped = 0;
+	auto begin = std::chrono::steady_clock::now();
+	while (log.Next()) {
+		if (speed > 0) {
+			auto due = begin + std::chrono::nanoseconds((long long)(log.TimeNs() / speed));
+			std::this_thread::sleep_until(due);
+		}
+
+		const Hand2Note::WireReader& call = log.Call();
+		int ret = 0;
+		switch (call.Type()) {
+		case Hand2Note::WireMessage::HandHistory:
+			ret = call.Read(hh) ? Hand2Note::Protocol::SendHandHistory(hh) : -1;
+			break;
+		case Hand2Note::WireMessage::HandStart:
+			ret = call.Read(start) ? Hand2Note::Protocol::SendHandStart(start) : -1;
+			break;
+		case Hand2Note::WireMessage::Action:
+			ret = call.Read(action) ? Hand2Note::Protocol::SendHandActon(action) : -1;
+			break;
+		case Hand2Note::WireMessage::Street:
+			ret = call.Read(street) ? Hand2Note::Protocol::SendHandStreed(street) : -1;
+			break;
+		case Hand2Note::WireMessage::Json:
+			ret = call.ReadJson(json) ? Hand2Note::Protocol::SendJson(json.c_str()) : -1;
+			break;
+		case Hand2Note::WireMessage::Command:
+			ret = call.ReadCommand(table_hwnd, room, cmd) ?
+				Hand2Note::Protocol::SendCommand(table_hwnd, (Hand2Note::Room)room, (Hand2Note::Command)cmd) : -1;
+			break;
+		default:
+			// written by a newer recorder
+			++skipped;
+			continue;
+		}
+		++calls;
+		if (ret != 0)
+			++failed;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	printf("replayed %zu calls in %.3f s (recorded %.3f s), %zu failed, %zu skipped\n",
+		calls, seconds, log.TimeNs() / 1e9, failed, skipped);
+	return failed ? 2 : 0;
+}